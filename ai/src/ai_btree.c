@@ -1214,6 +1214,9 @@ ai_btree_defrag_list(as_sindex_metadata *imd, as_sindex_pmetadata *pimd, cf_ll *
 				SET_TIME_FOR_SINDEX_GC_HIST(deletion_time_ns);
 				before += pimd->ibtr->msize + pimd->ibtr->nsize;
 				if (reduced_iRem(pimd->ibtr, acol, &apk) == AS_SINDEX_OK) {
+					if (C_IS_L(imd->btype)) {
+						as_sindex_covering_delete(imd->si, &(dt->acol_digs[i].dig), (int64_t)acol->l);
+					}
 					success++;
 				}
 				after += pimd->ibtr->msize + pimd->ibtr->nsize;
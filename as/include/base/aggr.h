@@ -38,6 +38,17 @@ struct as_namespace_s;
 struct as_partition_reservation_s;
 struct udf_record_s;
 
+// Stream UDF module name reserved for the native aggregation operators. Each
+// emits one partial result per query batch or scan partition, which the client
+// merges with its own reduce:
+//   count()           - integer, merge by adding
+//   sum(bin)          - integer, merge by adding
+//   min(bin)/max(bin) - integer, merge by min/max
+//   group_count(bin)  - map of bin value to count, merge by adding per key
+//   top_k(bin, k)     - list of the k largest values, descending
+//   distinct(bin)     - bytes of 1024 HyperLogLog registers, merge by max
+#define AS_AGGR_NATIVE_MODULE "as_native"
+
 typedef struct {
 	as_stream_status                    (* ostream_write) (void *, as_val *);
 	void                                (* set_error)     (void *, int);
@@ -37,6 +37,7 @@
 #include "aerospike/mod_lua_config.h"
 #include "citrusleaf/cf_atomic.h"
 
+#include "hardware.h"
 #include "socket.h"
 #include "util.h"
 
@@ -88,6 +89,9 @@ typedef struct as_config_s {
 	uint32_t		paxos_single_replica_limit; // cluster size at which, and below, the cluster will run with replication factor 1
 	char*			pidfile;
 	int				n_service_threads;
+	PAD_BOOL		service_reuse_port; // every service thread listens (SO_REUSEPORT) and keeps the connections it accepts
+	PAD_BOOL		service_pin_threads; // pin service threads to CPUs
+	cf_topo_auto_pin auto_pin; // numa - run on (and allocate from) the NUMA node selected by --instance
 	uint32_t		n_transaction_queues;
 	uint32_t		n_transaction_threads_per_queue;
 	int				n_proto_fd_max;
@@ -122,6 +126,8 @@ typedef struct as_config_s {
 	paxos_protocol_enum paxos_protocol;
 	paxos_recovery_policy_enum paxos_recovery_policy;
 	uint32_t		paxos_retransmit_period;
+	PAD_BOOL		proto_coalesce_replies; // hold replies while pipelined requests are waiting, send them together
+	uint32_t		proto_compress_threshold; // compress replies at least this big to clients that compress - 0 means never
 	int				proto_fd_idle_ms; // after this many milliseconds, connections are aborted unless transaction is in progress
 	int				proto_slow_netio_sleep_ms; // dynamic only
 	uint32_t		query_bsize;
@@ -141,6 +147,7 @@ typedef struct as_config_s {
 	uint32_t		query_threshold;
 	uint64_t		query_untracked_time_ms;
 	uint32_t		query_worker_threads;
+	uint32_t		profile_sample_rate; // 0 means profiler off, else 1 in N transactions
 	PAD_BOOL		respond_client_on_master_completion;
 	PAD_BOOL		run_as_daemon;
 	uint32_t		scan_max_active; // maximum number of active scans allowed
@@ -150,6 +157,7 @@ typedef struct as_config_s {
 	uint32_t		sindex_builder_threads; // secondary index builder thread pool size
 	PAD_BOOL		sindex_gc_enable_histogram; // dynamic only
 	uint32_t		ticker_interval;
+	PAD_BOOL		transaction_combine_increments;
 	uint64_t		transaction_max_ns;
 	uint32_t		transaction_pending_limit; // 0 means no limit
 	PAD_BOOL		transaction_repeatable_read;
@@ -163,6 +171,7 @@ typedef struct as_config_s {
 	PAD_BOOL		fabric_dump_msgs; // whether to log information about existing "msg" objects and queues
 	int64_t			max_msgs_per_type; // maximum number of "msg" objects permitted per type
 	PAD_BOOL		memory_accounting; // whether memory accounting is enabled
+	uint32_t		memory_accounting_sample_rate; // account for (and attribute) 1 in N allocations under lock, 1 for all
 	uint32_t		prole_extra_ttl; // seconds beyond expiry time after which we garbage collect, 0 for no garbage collection
 	PAD_BOOL		non_master_sets_delete;	// dynamic only - locally delete non-master records in sets that are being emptied
 
@@ -45,6 +45,7 @@
 #include "hist_track.h"
 #include "linear_hist.h"
 #include "msg.h"
+#include "slab.h"
 #include "util.h"
 #include "vmapx.h"
 
@@ -246,6 +247,7 @@ extern int32_t as_bin_particle_stack_from_pickled(as_bin *b, uint8_t* stack, uin
 extern int as_bin_particle_compare_from_pickled(const as_bin *b, uint8_t **p_pickled);
 extern uint32_t as_bin_particle_client_value_size(const as_bin *b);
 extern uint32_t as_bin_particle_to_client(const as_bin *b, as_msg_op *op);
+extern uint32_t as_bin_particle_client_value_ptr(const as_bin *b, const uint8_t **p_value);
 extern uint32_t as_bin_particle_pickled_size(const as_bin *b);
 extern uint32_t as_bin_particle_to_pickled(const as_bin *b, uint8_t *pickled);
 
@@ -521,15 +523,15 @@ extern void as_record_reinitialize(as_index_ref *r_ref, as_namespace *ns);
 
 extern void as_record_clean_bins_from(as_storage_rd *rd, uint16_t from);
 extern void as_record_clean_bins(as_storage_rd *rd);
-extern void as_record_free_bin_space(as_record *r);
+extern void as_record_free_bin_space(as_record *r, as_namespace *ns);
 
 extern void as_record_destroy(as_record *r, as_namespace *ns);
 extern void as_record_done(as_index_ref *r_ref, as_namespace *ns);
 
 void as_record_drop_stats(as_record* r, as_namespace* ns);
 
-extern void as_record_allocate_key(as_record* r, const uint8_t* key, uint32_t key_size);
-extern void as_record_remove_key(as_record* r);
+extern void as_record_allocate_key(as_record* r, const uint8_t* key, uint32_t key_size, as_namespace* ns);
+extern void as_record_remove_key(as_record* r, as_namespace* ns);
 extern int as_record_resolve_conflict(conflict_resolution_pol policy, uint16_t left_gen, uint64_t left_lut, uint32_t left_vt, uint16_t right_gen, uint64_t right_lut, uint32_t right_vt);
 extern int as_record_pickle(as_record *r, as_storage_rd *rd, uint8_t **buf_r, size_t *len_r);
 extern int as_record_unpickle_replace(as_record *r, as_storage_rd *rd, uint8_t *buf, size_t bufsz, uint8_t **stack_particles, bool has_sindex);
@@ -608,6 +610,8 @@ extern int as_record_flatten(as_partition_reservation *rsv, cf_digest *keyd,
 // a simpler call that gives seconds in the right epoch
 #define as_record_void_time_get() cf_clepoch_seconds()
 bool as_record_is_expired(as_record *r); // TODO - eventually inline
+bool as_record_is_truncated(as_record *r, as_namespace *ns);
+bool as_record_is_doomed(as_record *r, as_namespace *ns);
 
 #define AS_SINDEX_MAX		256
 
@@ -724,8 +728,13 @@ typedef struct as_index_tree_shared_s {
 	uint32_t		locks_shift;
 	uint32_t		sprigs_shift;
 
-	// Offset into as_index_tree struct's variable-sized data.
+	// Offsets into as_index_tree struct's variable-sized data.
 	uint32_t		sprigs_offset;
+	uint32_t		runs_offset; // used only if run_size isn't 0
+
+	// Elements each sprig allocates contiguously, to keep a sprig's elements
+	// on few pages when the index is on device - 0 to allocate singly.
+	uint32_t		run_size;
 } as_index_tree_shared;
 
 
@@ -751,6 +760,9 @@ struct as_namespace_s {
 	// Pointer to arena structure (not stages) in persistent memory base block.
 	cf_arenax*		arena;
 
+	// Data-in-memory bin space and stored keys come from here, if enabled.
+	cf_slab*		bin_slab;
+
 	// Pointer to bin name vmap in persistent memory base block.
 	cf_vmapx*		p_bin_name_vmap;
 
@@ -761,6 +773,10 @@ struct as_namespace_s {
 	as_set*			sets_cfg_array;
 	uint32_t		sets_cfg_count;
 
+	// Records last updated at or before this (clepoch ms) are truncated - 0 if
+	// never truncated. Sets also have their own cutoff.
+	cf_atomic64		truncate_lut;
+
 	// Configuration flags relevant for warm restart.
 	uint32_t		xmem_flags;
 
@@ -780,6 +796,9 @@ struct as_namespace_s {
 	cf_atomic32		cold_start_threshold_void_time;
 	uint32_t		cold_start_max_void_time;
 
+	// If true, cold-start populated secondary indexes from the devices.
+	bool			cold_start_sindex_loaded;
+
 	//--------------------------------------------
 	// Memory management.
 	//
@@ -852,11 +871,14 @@ struct as_namespace_s {
 	PAD_BOOL		udf_benchmarks_enabled;
 	PAD_BOOL		udf_sub_benchmarks_enabled;
 	PAD_BOOL		write_benchmarks_enabled;
+	PAD_BOOL		bin_slab_enabled; // data-in-memory multi-bin only
 	PAD_BOOL		proxy_hist_enabled;
 	uint32_t		evict_hist_buckets;
 	uint32_t		evict_tenths_pct;
 	float			hwm_disk;
 	float			hwm_memory;
+	char*			index_file; // path prefix of files backing the index - allows warm restart (with storage-engine device)
+	PAD_BOOL		index_on_device; // index-file stages live on the device, not in memory - needs index-file
 	PAD_BOOL		ldt_enabled;
 	uint32_t		ldt_gc_sleep_us;
 	uint32_t		ldt_page_size;
@@ -932,6 +954,7 @@ struct as_namespace_s {
 	cf_atomic64		n_expired_objects;
 	cf_atomic64		n_evicted_objects;
 	cf_atomic64		n_deleted_set_objects;
+	cf_atomic64		n_truncated_objects;
 
 	cf_atomic64		evict_ttl;
 
@@ -1106,6 +1129,7 @@ struct as_namespace_s {
 	// Special non-error counters:
 
 	cf_atomic64		n_deleted_last_bin;
+	cf_atomic64		n_hot_key_combined;
 
 	// LDT stats.
 
@@ -1194,6 +1218,8 @@ struct as_namespace_s {
 
 #define INVALID_SET_ID 0
 
+#define TRUNCATE_MODULE "truncate_module" // SMD module of truncate cutoffs
+
 #define IS_SET_DELETED(p_set)	(cf_atomic32_get(p_set->deleted) == 1)
 #define SET_DELETED_ON(p_set)	(cf_atomic32_set(&p_set->deleted, 1))
 #define SET_DELETED_OFF(p_set)	(cf_atomic32_set(&p_set->deleted, 0))
@@ -1214,7 +1240,7 @@ struct as_set_s {
 	cf_atomic64		n_tombstones;		// relevant only for enterprise edition
 	cf_atomic64		n_bytes_memory;		// for data-in-memory only - sets's total record data size
 	cf_atomic64		stop_writes_count;	// restrict number of records in a set
-	cf_atomic64		delete_time;		// TODO - implement
+	cf_atomic64		truncate_lut;		// records last updated at or before this (clepoch ms) are truncated
 	cf_atomic32		deleted;			// empty a set (triggered via info command only)
 	cf_atomic32		disable_eviction;	// don't evict anything in this set (note - expiration still works)
 	cf_atomic32		enable_xdr;			// white-list (AS_SET_ENABLE_XDR_TRUE) or black-list (AS_SET_ENABLE_XDR_FALSE) a set for XDR replication
@@ -1279,12 +1305,16 @@ extern const char *as_namespace_get_set_name(as_namespace *ns, uint16_t set_id);
 extern uint16_t as_namespace_get_set_id(as_namespace *ns, const char *set_name);
 extern uint16_t as_namespace_get_create_set_id(as_namespace *ns, const char *set_name);
 extern void as_namespace_get_set_info(as_namespace *ns, const char *set_name, cf_dyn_buf *db);
+extern int as_namespace_truncate(as_namespace *ns, const char *set_name, uint64_t lut);
 extern void as_namespace_adjust_set_memory(as_namespace *ns, uint16_t set_id, int64_t delta_bytes);
 extern void as_namespace_release_set_id(as_namespace *ns, uint16_t set_id);
 extern void as_namespace_get_bins_info(as_namespace *ns, cf_dyn_buf *db, bool show_ns);
 extern void as_namespace_get_hist_info(as_namespace *ns, char *set_name, char *hist_name,
 		cf_dyn_buf *db, bool show_ns);
 extern int as_namespace_check_set_limits(as_set * p_set, as_namespace * ns);
+extern void *as_namespace_dim_malloc(as_namespace *ns, size_t size);
+extern void *as_namespace_dim_realloc(as_namespace *ns, void *p, size_t old_size, size_t size);
+extern void as_namespace_dim_free(as_namespace *ns, void *p, size_t size);
 
 // Persistent Memory Management
 
@@ -313,6 +313,17 @@ typedef struct as_sprig_s {
 	uint32_t			n_elements;
 } as_sprig;
 
+// Unused part of a sprig's current allocation run. Only trees with the index
+// on device have these, after the sprigs.
+typedef struct as_sprig_run_s {
+	cf_arenax_handle	run_h;
+	uint32_t			run_left;
+} as_sprig_run;
+
+// Sprigs allocate elements in runs of this size when the index is on device,
+// so a sprig's elements share device pages.
+#define INDEX_RUN_BYTES 4096
+
 static inline as_lock_pair *
 tree_locks(as_index_tree *tree)
 {
@@ -325,6 +336,13 @@ tree_sprigs(as_index_tree *tree)
 	return (as_sprig*)(tree->data + tree->shared->sprigs_offset);
 }
 
+static inline as_sprig_run *
+tree_runs(as_index_tree *tree)
+{
+	return tree->shared->run_size == 0 ?
+			NULL : (as_sprig_run*)(tree->data + tree->shared->runs_offset);
+}
+
 
 //------------------------------------------------
 // as_index_tree public API.
@@ -373,11 +391,25 @@ typedef struct as_index_sprig_s {
 
 	as_lock_pair	*pair;
 	as_sprig		*sprig;
+
+	as_sprig_run	*run; // NULL unless the index is on device
+	uint32_t		run_size;
 } as_index_sprig;
 
 #define SENTINEL_H 0
 
 #define RESOLVE_H(__h) ((as_index*)cf_arenax_resolve(isprig->arena, __h))
 
+// Return the unused part of a sprig's allocation run to the arena - when the
+// sprig's tree is destroyed or saved for warm restart.
+static inline void
+as_sprig_release_run(cf_arenax *arena, as_sprig_run *run)
+{
+	cf_arenax_free_run(arena, run->run_h, run->run_left);
+
+	run->run_h = 0;
+	run->run_left = 0;
+}
+
 // Flag to indicate full index reduce.
 #define AS_REDUCE_ALL (-1)
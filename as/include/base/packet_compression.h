@@ -22,7 +22,9 @@
 
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
+#include <sys/uio.h>
 
 typedef enum compression_type_e {
 	COMPRESSION_ZLIB = 1
@@ -79,3 +81,13 @@ as_compress(int argc, uint8_t *argv[]);
  */
 int
 as_packet_compression(uint8_t *buf, size_t buf_sz, uint8_t **compressed_packet, size_t *compressed_packet_sz);
+
+/*
+ * Function to compress an outgoing proto message, header included, into a
+ * PROTO_TYPE_AS_MSG_COMPRESSED packet. The message may be scattered over
+ * several iovec segments.
+ * Returns the packet (cf_malloc'd) and sets out_sz, or returns NULL if the
+ * message didn't compress - send it as is.
+ */
+uint8_t *
+as_proto_compress_iov(const struct iovec *iov, int n_iov, size_t *out_sz);
@@ -0,0 +1,67 @@
+/*
+ * profile.h
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+#pragma once
+
+//==========================================================
+// Includes.
+//
+
+#include <stdint.h>
+
+#include "dynbuf.h"
+
+#include "base/transaction.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+// Points along the transaction hot path. For a sampled transaction, each point
+// reached records the time elapsed since the transaction started.
+typedef enum {
+	AS_PROFILE_DEMARSHAL,
+	AS_PROFILE_QUEUE_WAIT,
+	AS_PROFILE_INDEX,
+	AS_PROFILE_STORAGE_READ,
+	AS_PROFILE_REPLICATION,
+	AS_PROFILE_RESPONSE,
+
+	AS_PROFILE_N_PHASES
+} as_profile_phase;
+
+#define AS_PROFILE_MARK(trw, phase) \
+{ \
+	if ((trw->from_flags & FROM_FLAG_PROFILE) != 0) { \
+		as_profile_mark(phase, trw->start_time); \
+	} \
+}
+
+
+//==========================================================
+// Public API.
+//
+
+void as_profile_sample(as_transaction* tr);
+void as_profile_mark(as_profile_phase phase, uint64_t start_ns);
+void as_profile_get_info(cf_dyn_buf* db);
@@ -509,6 +509,13 @@ extern int as_msg_send_reply(struct as_file_handle_s *fd_h, uint32_t result_code
 		struct as_bin_s **bins, uint16_t bin_count, struct as_namespace_s *ns,
 		uint64_t trid, const char *setname);
 extern int as_msg_send_ops_reply(struct as_file_handle_s *fd_h, cf_dyn_buf *db);
+extern void as_msg_flush_replies(struct as_file_handle_s *fd_h);
+extern void as_msg_reply_riders(struct as_file_handle_s *fd_h,
+		uint32_t result_code, uint32_t generation, uint32_t void_time);
+extern void as_msg_reply_riders_from_msg(struct as_file_handle_s *fd_h,
+		const uint8_t *buf, size_t sz);
+extern uint8_t *as_proto_compress_reply(const struct as_file_handle_s *fd_h,
+		const struct iovec *iov, int n_iov, size_t *out_sz);
 
 extern cl_msg *as_msg_make_response_msg(uint32_t result_code, uint32_t generation,
 		uint32_t void_time, as_msg_op **ops, struct as_bin_s **bins,
@@ -548,12 +555,11 @@ typedef struct as_netio_s {
 	cf_buf_builder           * bb_r;
 	uint32_t                   offset;
 	uint32_t                   seq;
-	bool                       slow;
 	uint64_t                   start_time;
 } as_netio;
 
 void as_netio_init();
-int as_netio_send(as_netio *io, void *q, bool);
+int as_netio_send(as_netio *io, bool blocking);
 
 #define AS_NETIO_OK        0
 #define AS_NETIO_CONTINUE  1
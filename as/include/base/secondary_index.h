@@ -58,6 +58,7 @@
 #define SINDEX_MODULE              "sindex_module"
 #define AS_SINDEX_MAX_PATH_LENGTH  256
 #define AS_SINDEX_MAX_DEPTH        10
+#define AS_SINDEX_COVERING_HASH_SZ 4096 // default buckets of a covering map
 #define AS_SINDEX_TYPE_STR_SIZE    20 // LIST / MAPKEYS / MAPVALUES / DEFAULT(NONE)
 #define AS_SINDEXDATA_STR_SIZE     AS_SINDEX_MAX_PATH_LENGTH + 1 + 8 // binpath + separator (,) + keytype (string/numeric)
 #define AS_INDEX_KEYS_ARRAY_QUEUE_HIGHWATER  512
@@ -227,6 +228,7 @@ typedef struct as_sindex_stat_s {
 	cf_atomic64        lookup_response_size;
 	cf_atomic64        lookup_num_records;
 	cf_atomic64        lookup_errs;
+	cf_atomic64        lookup_covered;        // records answered from the covering map
 
 	histogram *       _query_rcnt_hist;       // Histogram to track record counts from queries
 	histogram *       _query_diff_hist;       // Histogram to track the false positives found by queries
@@ -238,6 +240,8 @@ typedef struct as_sindex_config_var_s {
 	uint32_t    defrag_max_units;
 	bool        enable_histogram; // default false;
 	uint16_t    ignore_not_sync_flag;
+	bool        covering; // default false;
+	uint32_t    covering_hash_sz;
 	bool 		conf_valid_flag;
 }as_sindex_config_var;
 
@@ -321,8 +325,23 @@ typedef struct as_sindex_s {
 	bool                         enable_histogram; // default false;
 	as_sindex_stat               stats;
 	as_sindex_config             config;
+
+	// Digest to as_sindex_covering_entry, NULL unless index is configured
+	// as covering.
+	shash                       *covering_hash;
 } as_sindex;
 
+/*
+ * Value of the indexed bin as last put in the sindex, stamped with the
+ * record's last-update-time and generation at the time. Lets a query answer
+ * a projection of the indexed bin without reading the record from device.
+ */
+typedef struct as_sindex_covering_entry_s {
+	uint64_t                     last_update_time;
+	int64_t                      value;
+	uint16_t                     generation;
+} __attribute__ ((__packed__)) as_sindex_covering_entry;
+
 // **************************************************************************************************
 /*
  * SBINS STRUCTURES
@@ -506,6 +525,9 @@ extern int  as_sindex_create(as_namespace *ns, as_sindex_metadata *imd, bool use
 extern int  as_sindex_destroy(as_namespace *ns, as_sindex_metadata *imd);
 extern int  as_sindex_update(as_sindex_metadata *imd);
 extern void as_sindex_destroy_pmetadata(as_sindex *si);
+extern bool as_sindex_covering_get(as_sindex *si, cf_digest *keyd, as_record *r, int64_t *value);
+extern void as_sindex_covering_delete(as_sindex *si, cf_digest *keyd, int64_t value);
+extern void as_sindex_covering_drop(as_sindex *si, cf_digest *keyd);
 // **************************************************************************************************
 
 
@@ -518,7 +540,7 @@ extern int  as_sindex_sbins_from_rd(as_storage_rd *rd, uint16_t from_bin, uint16
 extern int  as_sindex_sbins_from_bin(as_namespace *ns, const char *set, const as_bin *b,
 			as_sindex_bin * start_sbin, as_sindex_op op);
 extern int  as_sindex_update_by_sbin(as_namespace *ns, const char *set, as_sindex_bin *start_sbin, 
-			int num_sbins, cf_digest * pkey);
+			int num_sbins, cf_digest * pkey, as_record *r);
 extern uint32_t as_sindex_sbins_populate(as_sindex_bin *sbins, as_namespace *ns, const char *set_name,
 			const as_bin *b_old, const as_bin *b_new);
 // **************************************************************************************************
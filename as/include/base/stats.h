@@ -79,6 +79,7 @@ typedef struct as_stats_s {
 	cf_atomic64		batch_index_huge_buffers; // not in ticker
 	cf_atomic64		batch_index_created_buffers; // not in ticker
 	cf_atomic64		batch_index_destroyed_buffers; // not in ticker
+	cf_atomic64		batch_index_steals; // not in ticker
 
 	// "Old" batch stats.
 	cf_atomic64		batch_initiate; // not in ticker
@@ -112,6 +113,8 @@ typedef struct as_stats_s {
 
 	histogram*		batch_index_hist;
 	bool			batch_index_hist_active; // automatically activated
+	histogram*		batch_index_small_hist;
+	bool			batch_index_small_hist_active; // automatically activated
 
 	histogram*		info_hist;
 
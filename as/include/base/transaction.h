@@ -94,6 +94,14 @@ struct as_namespace_s;
 // Client socket information - as_file_handle.
 //
 
+// A client write combined into another client's queued write on the same hot
+// key - it gets that write's result. See rw_request_hash.c.
+typedef struct as_reply_rider_s {
+	struct as_file_handle_s		*fd_h;
+	uint64_t					trid;
+	struct as_reply_rider_s		*next;
+} as_reply_rider;
+
 typedef struct as_file_handle_s {
 	char		client[64];		// client identifier (currently ip-addr:port)
 	uint64_t	last_used;		// last ms we read or wrote
@@ -104,11 +112,17 @@ typedef struct as_file_handle_s {
 	as_proto	proto_hdr;
 	as_proto	*proto;
 	uint64_t	proto_unread;
+	uint8_t		*pending;		// bytes read past the current request (pipelined)
+	uint32_t	pending_sz;
+	uint8_t		*out;			// replies held back while pipelined requests wait
+	uint32_t	out_sz;
+	as_reply_rider *riders;		// combined writes to reply to with ours
 	void		*security_filter;
 } as_file_handle;
 
 #define FH_INFO_DONOT_REAP	0x00000001	// this bit indicates that this file handle should not be reaped
 #define FH_INFO_XDR			0x00000002	// the file handle belongs to an XDR connection
+#define FH_INFO_COMPRESS	0x00000004	// the client sent compressed requests, so can take compressed replies
 
 // Helpers to release transaction file handles.
 void as_release_file_handle(as_file_handle *proto_fd_h);
@@ -207,6 +221,7 @@ typedef struct as_transaction_s {
 #define FROM_FLAG_BATCH_SUB		0x0002
 #define FROM_FLAG_SHIPPED_OP	0x0004
 #define FROM_FLAG_RESTART		0x0008
+#define FROM_FLAG_PROFILE		0x0010 // sampled for the hot path profiler
 
 // 'flags' bits - set in transaction body after queuing:
 #define AS_TRANSACTION_FLAG_SINDEX_TOUCHED	0x01
@@ -196,10 +196,12 @@ typedef struct drv_ssd_s
 	uint32_t		cold_start_block_counter;		// large blocks read
 	uint64_t		record_add_older_counter;		// records not inserted due to better existing one
 	uint64_t		record_add_expired_counter;		// records not inserted due to expiration
+	uint64_t		record_add_truncated_counter;	// records not inserted due to truncation
 	uint64_t		record_add_max_ttl_counter;		// records not inserted due to max-ttl
 	uint64_t		record_add_replace_counter;		// records reinserted
 	uint64_t		record_add_unique_counter;		// records inserted
 	uint64_t		record_add_sigfail_counter;
+	uint64_t		sindex_load_counter;			// records added to secondary indexes
 
 	ssd_alloc_table	*alloc_table;
 
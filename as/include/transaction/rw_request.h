@@ -118,6 +118,7 @@ typedef struct rw_request_s {
 	pthread_mutex_t		lock;
 
 	rw_wait_ele*		wait_queue_head;
+	uint32_t			wait_queue_depth;
 
 	bool				is_set_up; // TODO - redundant with timeout_cb
 	bool				has_udf; // TODO - only for stats?
@@ -186,15 +187,7 @@ rw_request_release(rw_request* rw)
 static inline uint32_t
 rw_request_wait_q_depth(rw_request* rw)
 {
-	uint32_t depth = 0;
-	rw_wait_ele* e = rw->wait_queue_head;
-
-	while (e) {
-		depth++;
-		e = e->next;
-	}
-
-	return depth;
+	return rw->wait_queue_depth;
 }
 
 
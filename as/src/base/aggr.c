@@ -28,8 +28,16 @@
 #include <string.h>
 
 
+#include "aerospike/as_arraylist.h"
+#include "aerospike/as_bytes.h"
+#include "aerospike/as_hashmap.h"
+#include "aerospike/as_integer.h"
+#include "aerospike/as_list.h"
+#include "aerospike/as_map.h"
+#include "aerospike/as_string.h"
 #include "aerospike/as_val.h"
 #include "aerospike/mod_lua.h"
+#include "citrusleaf/alloc.h"
 #include "citrusleaf/cf_ll.h"
 
 #include "fault.h"
@@ -287,6 +295,399 @@ static const as_aerospike_hooks as_aggr_aerospike_hooks = {
 
 
 
+/*
+ * Native aggregation operators
+ *
+ * Run in C directly over the records of the input stream - no Lua state, no
+ * as_val boxing per record. Each call (a query batch, or a scan partition)
+ * emits one partial result, as the equivalent Lua stream function would.
+ */
+// **************************************************************************************************
+#define NATIVE_MAX_TOP_K      1000
+#define NATIVE_HLL_BITS       10
+#define NATIVE_HLL_REGISTERS  (1 << NATIVE_HLL_BITS)
+
+typedef enum {
+	NATIVE_COUNT,
+	NATIVE_SUM,
+	NATIVE_MIN,
+	NATIVE_MAX,
+	NATIVE_GROUP_COUNT,
+	NATIVE_TOP_K,
+	NATIVE_DISTINCT
+} native_op;
+
+typedef struct {
+	const char * name;
+	native_op    op;
+	bool         needs_bin;
+} native_op_def;
+
+static const native_op_def native_ops[] = {
+	{ "count",       NATIVE_COUNT,       false },
+	{ "sum",         NATIVE_SUM,         true  },
+	{ "min",         NATIVE_MIN,         true  },
+	{ "max",         NATIVE_MAX,         true  },
+	{ "group_count", NATIVE_GROUP_COUNT, true  },
+	{ "top_k",       NATIVE_TOP_K,       true  },
+	{ "distinct",    NATIVE_DISTINCT,    true  }
+};
+
+#define N_NATIVE_OPS (sizeof(native_ops) / sizeof(native_op_def))
+
+typedef struct {
+	native_op     op;
+	const char  * bname;
+	bool          found;  // anything aggregated yet
+	int64_t       i64;    // count, sum, min, max
+	int64_t     * top;    // top_k - min-heap of the k largest values
+	uint32_t      k;
+	uint32_t      n_top;
+	as_hashmap  * groups; // group_count
+	uint8_t     * regs;   // distinct - HyperLogLog registers
+} native_aggr;
+
+static int
+native_fail(as_result *ap_res, const char *msg)
+{
+	cf_debug(AS_AGGR, "native aggregation: %s", msg);
+	as_result_setfailure(ap_res, (as_val *)as_string_new(cf_strdup(msg), true));
+	return AS_AGGR_ERR;
+}
+
+// FNV-1a, finished with a 64-bit mix so the HyperLogLog index bits are good.
+static uint64_t
+native_hash(const uint8_t *buf, size_t sz)
+{
+	uint64_t h = 0xcbf29ce484222325UL;
+
+	for (size_t i = 0; i < sz; i++) {
+		h ^= buf[i];
+		h *= 0x100000001b3UL;
+	}
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdUL;
+	h ^= h >> 33;
+
+	return h;
+}
+
+static void
+native_top_k_add(native_aggr *na, int64_t v)
+{
+	int64_t *top = na->top;
+	uint32_t i;
+
+	if (na->n_top < na->k) {
+		// Sift up.
+		i = na->n_top++;
+
+		while (i != 0 && top[(i - 1) / 2] > v) {
+			top[i] = top[(i - 1) / 2];
+			i = (i - 1) / 2;
+		}
+
+		top[i] = v;
+		return;
+	}
+
+	if (v <= top[0]) {
+		return;
+	}
+
+	// Replace the smallest and sift down.
+	i = 0;
+
+	while (true) {
+		uint32_t c = 2 * i + 1;
+
+		if (c >= na->n_top) {
+			break;
+		}
+
+		if (c + 1 < na->n_top && top[c + 1] < top[c]) {
+			c++;
+		}
+
+		if (top[c] >= v) {
+			break;
+		}
+
+		top[i] = top[c];
+		i = c;
+	}
+
+	top[i] = v;
+}
+
+static void
+native_distinct_add(native_aggr *na, const as_bin *b)
+{
+	uint64_t h;
+
+	if (as_bin_get_particle_type(b) == AS_PARTICLE_TYPE_INTEGER) {
+		int64_t v = as_bin_particle_integer_value(b);
+		h = native_hash((const uint8_t *)&v, sizeof(v));
+	}
+	else if (as_bin_get_particle_type(b) == AS_PARTICLE_TYPE_STRING) {
+		char *str;
+		uint32_t len = as_bin_particle_string_ptr(b, &str);
+		h = native_hash((const uint8_t *)str, len);
+	}
+	else {
+		return;
+	}
+
+	uint32_t idx = (uint32_t)(h >> (64 - NATIVE_HLL_BITS));
+	uint64_t w = (h << NATIVE_HLL_BITS) | (1UL << (NATIVE_HLL_BITS - 1));
+	uint8_t rank = (uint8_t)(__builtin_clzll(w) + 1);
+
+	if (rank > na->regs[idx]) {
+		na->regs[idx] = rank;
+	}
+
+	na->found = true;
+}
+
+static void
+native_group_count_add(native_aggr *na, const as_bin *b)
+{
+	as_particle_type type = as_bin_get_particle_type(b);
+
+	if (type != AS_PARTICLE_TYPE_INTEGER && type != AS_PARTICLE_TYPE_STRING) {
+		return;
+	}
+
+	as_val *key = as_bin_particle_to_asval(b);
+	as_integer *count = (as_integer *)as_hashmap_get(na->groups, key);
+
+	if (count) {
+		count->value++;
+		as_val_destroy(key);
+	}
+	else {
+		as_map_set((as_map *)na->groups, key, (as_val *)as_integer_new(1));
+	}
+
+	na->found = true;
+}
+
+static void
+native_add(native_aggr *na, udf_record *urecord)
+{
+	if (na->op == NATIVE_COUNT) {
+		na->i64++;
+		na->found = true;
+		return;
+	}
+
+	as_bin *b = as_bin_get(urecord->rd, na->bname);
+
+	if (! b) {
+		return;
+	}
+
+	switch (na->op) {
+	case NATIVE_GROUP_COUNT:
+		native_group_count_add(na, b);
+		return;
+	case NATIVE_DISTINCT:
+		native_distinct_add(na, b);
+		return;
+	default:
+		break;
+	}
+
+	// Remaining operators aggregate integers only.
+	if (as_bin_get_particle_type(b) != AS_PARTICLE_TYPE_INTEGER) {
+		return;
+	}
+
+	int64_t v = as_bin_particle_integer_value(b);
+
+	switch (na->op) {
+	case NATIVE_SUM:
+		// Add unsigned, so overflow wraps instead of being undefined.
+		na->i64 = (int64_t)((uint64_t)na->i64 + (uint64_t)v);
+		break;
+	case NATIVE_MIN:
+		if (! na->found || v < na->i64) {
+			na->i64 = v;
+		}
+		break;
+	case NATIVE_MAX:
+		if (! na->found || v > na->i64) {
+			na->i64 = v;
+		}
+		break;
+	case NATIVE_TOP_K:
+		native_top_k_add(na, v);
+		break;
+	default:
+		break;
+	}
+
+	na->found = true;
+}
+
+static int
+native_cmp_desc(const void *a, const void *b)
+{
+	int64_t x = *(const int64_t *)a;
+	int64_t y = *(const int64_t *)b;
+
+	return x < y ? 1 : (x > y ? -1 : 0);
+}
+
+// Returns the partial result, ownership passes to the caller.
+static as_val *
+native_result(native_aggr *na)
+{
+	if (! na->found) {
+		return NULL;
+	}
+
+	switch (na->op) {
+	case NATIVE_GROUP_COUNT: {
+		as_val *v = (as_val *)na->groups;
+		na->groups = NULL;
+		return v;
+	}
+	case NATIVE_TOP_K: {
+		qsort(na->top, na->n_top, sizeof(int64_t), native_cmp_desc);
+
+		as_arraylist *list = as_arraylist_new(na->n_top, 0);
+
+		for (uint32_t i = 0; i < na->n_top; i++) {
+			as_arraylist_append(list, (as_val *)as_integer_new(na->top[i]));
+		}
+
+		return (as_val *)list;
+	}
+	case NATIVE_DISTINCT: {
+		as_val *v = (as_val *)as_bytes_new_wrap(na->regs, NATIVE_HLL_REGISTERS, true);
+		na->regs = NULL;
+		return v;
+	}
+	default:
+		return (as_val *)as_integer_new(na->i64);
+	}
+}
+
+static void
+native_destroy(native_aggr *na)
+{
+	if (na->top) {
+		cf_free(na->top);
+	}
+
+	if (na->groups) {
+		as_val_destroy(na->groups);
+	}
+
+	if (na->regs) {
+		cf_free(na->regs);
+	}
+}
+
+static int
+native_init(native_aggr *na, const udf_def *def, as_result *ap_res)
+{
+	memset(na, 0, sizeof(native_aggr));
+
+	const native_op_def *op_def = NULL;
+
+	for (uint32_t i = 0; i < N_NATIVE_OPS; i++) {
+		if (strcmp(def->function, native_ops[i].name) == 0) {
+			op_def = &native_ops[i];
+			break;
+		}
+	}
+
+	if (! op_def) {
+		return native_fail(ap_res, "unknown native aggregation function");
+	}
+
+	na->op = op_def->op;
+
+	uint32_t n_args = def->arglist ? as_list_size(def->arglist) : 0;
+
+	if (op_def->needs_bin) {
+		as_string *bname = n_args > 0 ?
+				as_string_fromval(as_list_get(def->arglist, 0)) : NULL;
+
+		if (! bname) {
+			return native_fail(ap_res, "native aggregation needs a bin name");
+		}
+
+		na->bname = as_string_get(bname);
+	}
+
+	switch (na->op) {
+	case NATIVE_GROUP_COUNT:
+		na->groups = as_hashmap_new(64);
+		break;
+	case NATIVE_TOP_K: {
+		as_integer *k = n_args > 1 ?
+				as_integer_fromval(as_list_get(def->arglist, 1)) : NULL;
+
+		if (! k || as_integer_get(k) < 1 || as_integer_get(k) > NATIVE_MAX_TOP_K) {
+			return native_fail(ap_res, "top_k needs k between 1 and 1000");
+		}
+
+		na->k = (uint32_t)as_integer_get(k);
+		na->top = cf_malloc(na->k * sizeof(int64_t));
+		break;
+	}
+	case NATIVE_DISTINCT:
+		na->regs = cf_calloc(1, NATIVE_HLL_REGISTERS);
+		break;
+	default:
+		break;
+	}
+
+	return AS_AGGR_OK;
+}
+
+static int
+native_aggr_process(aggr_state *astate, as_result *ap_res)
+{
+	native_aggr na;
+
+	if (native_init(&na, &astate->call->def, ap_res) != AS_AGGR_OK) {
+		native_destroy(&na);
+		return AS_AGGR_ERR;
+	}
+
+	as_stream istream;
+	as_stream_init(&istream, astate, &istream_hooks);
+
+	as_val *v;
+
+	while ((v = as_stream_read(&istream)) != NULL) {
+		native_add(&na, as_rec_source((as_rec *)v));
+	}
+
+	as_val *result = native_result(&na);
+
+	native_destroy(&na);
+
+	if (result) {
+		as_stream ostream;
+		as_stream_init(&ostream, astate, &ostream_hooks);
+
+		if (as_stream_write(&ostream, result) != AS_STREAM_OK) {
+			return AS_AGGR_ERR;
+		}
+	}
+
+	return AS_AGGR_OK;
+}
+// **************************************************************************************************
+
+
+
 int
 as_aggr_process(as_namespace *ns, as_aggr_call * ag_call, cf_ll * ap_recl, void * udata, as_result * ap_res)
 {
@@ -322,6 +723,13 @@ as_aggr_process(as_namespace *ns, as_aggr_call * ag_call, cf_ll * ap_recl, void
 		return AS_AGGR_ERR;
 	}
 
+	if (strcmp(ag_call->def.filename, AS_AGGR_NATIVE_MODULE) == 0) {
+		int ret = native_aggr_process(&astate, ap_res);
+
+		acleanup(&astate);
+		return ret;
+	}
+
 	as_aerospike as;
 	as_aerospike_init(&as, NULL, &as_aggr_aerospike_hooks);
 
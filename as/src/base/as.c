@@ -135,7 +135,8 @@ const char HELP[] =
 		"\n"
 		"(Enterprise edition only.) If running multiple instances of Aerospike on one\n"
 		"machine (not recommended), each instance must be uniquely designated via this\n"
-		"option.\n"
+		"option. With auto-pin numa configured, the instance also selects the NUMA node\n"
+		"the instance runs on.\n"
 		;
 
 const char USAGE[] =
@@ -353,6 +354,7 @@ main(int argc, char **argv)
 	// [Note: This should ideally be at the very start of the "main()" function,
 	//        but we need to wait until after the config file has been parsed in
 	//        order to support run-time configurability.]
+	mem_count_set_sample_rate(c->memory_accounting_sample_rate);
 	mem_count_init(c->memory_accounting ? MEM_COUNT_ENABLE : MEM_COUNT_DISABLE);
 #endif
 
@@ -426,8 +428,10 @@ main(int argc, char **argv)
 	// Includes echoing the configuration file to log.
 	as_config_post_process(c, config_file);
 
-	// Detect the CPU topology.
-	cf_topo_init((cf_topo_numa_node_index)instance, false);
+	// Detect the CPU topology. With auto-pin numa, also confine this process
+	// (threads and memory) to the NUMA node selected by the instance.
+	cf_topo_init((cf_topo_numa_node_index)instance,
+			c->auto_pin == CF_TOPO_AUTO_PIN_NUMA);
 
 	// Make one more pass for XDR-related config and crash if needed.
 	// TODO : XDR config parsing should be merged with main config parsing.
@@ -47,6 +47,14 @@
 #define BATCH_MAX_TRANSACTION_SIZE (1024 * 1024 * 10) // 10MB
 #define BATCH_REPEAT_SIZE 25  // index(4),digest(20) and repeat(1)
 
+// Buffers bigger than BATCH_BLOCK_SIZE come in power of 2 size classes, up to
+// the first class that holds BATCH_MAX_TRANSACTION_SIZE.
+#define BATCH_HUGE_CLASSES 7 // 256K, 512K, ... 16M
+#define BATCH_HUGE_CACHE_BYTES (1024 * 1024 * 8) // 8M - cached per size class
+
+#define BATCH_SEND_QUANTUM 4 // buffers sent per turn before other batches get a go
+#define BATCH_SMALL_MAX_KEYS 100 // batches this size or smaller go in batch-index-small histogram
+
 //---------------------------------------------------------
 // TYPES
 //---------------------------------------------------------
@@ -64,7 +72,8 @@ typedef struct {
 	uint16_t n_ops;
 } __attribute__((__packed__)) as_batch_input;
 
-typedef struct {
+typedef struct as_batch_buffer_s {
+	struct as_batch_buffer_s* next; // next full buffer waiting to be sent
 	uint32_t capacity;
 	uint32_t size;
 	uint32_t tran_count;
@@ -73,9 +82,28 @@ typedef struct {
 	uint8_t data[];
 } __attribute__((__packed__)) as_batch_buffer;
 
+// Each worker thread has a queue of batches with buffers ready to send. A
+// batch is on at most one queue at a time (scheduled), so only one worker
+// ever writes to its socket. Workers send a few buffers of a batch, then put
+// it back at the end of its queue - concurrent batches take turns. Workers
+// that run out steal batches from other queues, then sleep on their own queue.
+// A batch whose own worker is busy is handed to a sleeping worker's queue.
+typedef struct {
+	cf_queue* response_queue; // scheduled batches (as_batch_shared*)
+	cf_queue* complete_queue;
+	cf_queue* buffer_queue; // block buffers freed by this queue's worker
+	cf_atomic32 count;
+	cf_atomic32 n_buffers; // full buffers waiting to be sent
+	cf_atomic32 idle; // worker is asleep on its (empty) response queue
+	volatile bool active;
+} as_batch_queue;
+
 struct as_batch_shared_s {
 	pthread_mutex_t lock;
-	cf_queue* response_queue;
+	as_batch_queue* batch_queue;
+	as_batch_buffer* send_head;
+	as_batch_buffer* send_tail;
+	bool scheduled;
 	as_file_handle* fd_h;
 	cl_msg* msgp;
 	as_batch_buffer* buffer;
@@ -86,18 +114,6 @@ struct as_batch_shared_s {
 	int result_code;
 };
 
-typedef struct {
-	as_batch_shared* shared;
-	as_batch_buffer* buffer;
-} as_batch_response;
-
-typedef struct {
-	cf_queue* response_queue;
-	cf_queue* complete_queue;
-	cf_atomic32 count;
-	volatile bool active;
-} as_batch_queue;
-
 typedef struct {
 	as_batch_queue* batch_queue;
 	bool complete;
@@ -109,10 +125,16 @@ typedef struct {
 
 static as_thread_pool batch_thread_pool;
 static as_buffer_pool batch_buffer_pool;
+static cf_queue* batch_huge_queues[BATCH_HUGE_CLASSES];
 
 static as_batch_queue batch_queues[MAX_BATCH_THREADS];
 static pthread_mutex_t batch_resize_lock;
 
+// Held (read) while popping from or pushing to another worker's queue, and
+// (write) by shutdown while it sends stop commands - so a stop command is never
+// stolen, and nothing is handed to a queue after its stop command.
+static pthread_rwlock_t batch_steal_lock = PTHREAD_RWLOCK_INITIALIZER;
+
 //---------------------------------------------------------
 // STATIC FUNCTIONS
 //---------------------------------------------------------
@@ -181,7 +203,18 @@ as_batch_send_buffer(as_batch_shared* shared, as_batch_buffer* buffer)
 	buffer->proto.sz = buffer->size;
 	as_proto_swap(&buffer->proto);
 
-	int status = as_batch_send(&shared->fd_h->sock, (uint8_t*)&buffer->proto, sizeof(as_proto) + buffer->size, MSG_NOSIGNAL | MSG_MORE);
+	struct iovec iov = { .iov_base = &buffer->proto, .iov_len = sizeof(as_proto) + buffer->size };
+	size_t comp_sz;
+	uint8_t* comp = as_proto_compress_reply(shared->fd_h, &iov, 1, &comp_sz);
+	int status;
+
+	if (comp) {
+		status = as_batch_send(&shared->fd_h->sock, comp, comp_sz, MSG_NOSIGNAL | MSG_MORE);
+		cf_free(comp);
+	}
+	else {
+		status = as_batch_send(&shared->fd_h->sock, (uint8_t*)&buffer->proto, sizeof(as_proto) + buffer->size, MSG_NOSIGNAL | MSG_MORE);
+	}
 
 	if (status) {
 		// Socket error. Close socket.
@@ -225,6 +258,10 @@ as_batch_send_final(as_batch_shared* shared)
 	// For now the model is timeouts don't appear in histograms.
 	if (shared->result_code != AS_PROTO_RESULT_FAIL_TIMEOUT) {
 		G_HIST_ACTIVATE_INSERT_DATA_POINT(batch_index_hist, shared->start);
+
+		if (shared->tran_max <= BATCH_SMALL_MAX_KEYS) {
+			G_HIST_ACTIVATE_INSERT_DATA_POINT(batch_index_small_hist, shared->start);
+		}
 	}
 
 	// Check final return code in order to update statistics.
@@ -242,8 +279,10 @@ as_batch_send_final(as_batch_shared* shared)
 }
 
 static inline void
-as_batch_free(as_batch_shared* shared, as_batch_queue* batch_queue)
+as_batch_free(as_batch_shared* shared)
 {
+	as_batch_queue* batch_queue = shared->batch_queue;
+
 	// Destroy lock
 	pthread_mutex_destroy(&shared->lock);
 
@@ -257,34 +296,106 @@ as_batch_free(as_batch_shared* shared, as_batch_queue* batch_queue)
 	cf_atomic32_decr(&batch_queue->count);
 }
 
+static inline uint32_t
+as_batch_huge_size(uint32_t huge_class)
+{
+	return BATCH_BLOCK_SIZE << (huge_class + 1);
+}
+
+static inline uint32_t
+as_batch_huge_max_unused(uint32_t huge_class)
+{
+	uint32_t max = BATCH_HUGE_CACHE_BYTES / as_batch_huge_size(huge_class);
+	return max != 0 ? max : 1;
+}
+
+static uint32_t
+as_batch_huge_class(uint32_t mem_size)
+{
+	// Smallest size class that holds mem_size.
+	uint32_t huge_class = 0;
+
+	while (huge_class < BATCH_HUGE_CLASSES - 1 && as_batch_huge_size(huge_class) < mem_size) {
+		huge_class++;
+	}
+	return huge_class;
+}
+
 static void
-as_batch_worker(void* udata)
+as_batch_buffer_release(as_batch_queue* batch_queue, as_batch_buffer* buffer)
+{
+	uint32_t mem_size = buffer->capacity + batch_buffer_pool.header_size;
+
+	if (mem_size == batch_buffer_pool.buffer_size) {
+		// Keep block buffers with this queue first - the transaction threads
+		// filling this queue's batches pop from here, so the global pool lock
+		// is only taken when a queue runs dry or overflows. Each queue keeps
+		// a share of half the unused buffer limit, the global pool the rest.
+		uint32_t queue_max = g_config.batch_max_unused_buffers / 2 / batch_thread_pool.thread_size;
+
+		if (cf_queue_sz(batch_queue->buffer_queue) < queue_max) {
+			cf_queue_push(batch_queue->buffer_queue, &buffer);
+			return;
+		}
+
+		if (as_buffer_pool_push_limit(&batch_buffer_pool, buffer, buffer->capacity, g_config.batch_max_unused_buffers / 2) != 0) {
+			cf_atomic64_incr(&g_stats.batch_index_destroyed_buffers);
+		}
+		return;
+	}
+
+	uint32_t huge_class = as_batch_huge_class(mem_size);
+
+	if (mem_size == as_batch_huge_size(huge_class) &&
+			cf_queue_sz(batch_huge_queues[huge_class]) < as_batch_huge_max_unused(huge_class)) {
+		cf_queue_push(batch_huge_queues[huge_class], &buffer);
+		return;
+	}
+
+	cf_free(buffer);
+	cf_atomic64_incr(&g_stats.batch_index_destroyed_buffers);
+}
+
+static void
+as_batch_send_shared(as_batch_shared* shared)
 {
 	// Send batch data to client, one buffer block at a time.
-	as_batch_work* work = (as_batch_work*)udata;
-	as_batch_queue* batch_queue = work->batch_queue;
-	cf_queue* response_queue = batch_queue->response_queue;
-	as_batch_response response;
-	as_batch_shared* shared;
-	as_batch_buffer* buffer;
+	as_batch_queue* batch_queue = shared->batch_queue;
 
-	while (cf_queue_pop(response_queue, &response, CF_QUEUE_FOREVER) == CF_QUEUE_OK) {
-		// Check if this thread task should end.
-		shared = response.shared;
-		if (! shared) {
-			break;
+	for (uint32_t n = 0; ; n++) {
+		pthread_mutex_lock(&shared->lock);
+
+		as_batch_buffer* buffer = shared->send_head;
+
+		if (! buffer) {
+			// Nothing more ready - next full buffer will reschedule batch.
+			shared->scheduled = false;
+			pthread_mutex_unlock(&shared->lock);
+			return;
+		}
+
+		if (n == BATCH_SEND_QUANTUM) {
+			// Let other batches on the queue have a turn.
+			pthread_mutex_unlock(&shared->lock);
+			cf_queue_push(batch_queue->response_queue, &shared);
+			return;
+		}
+
+		shared->send_head = buffer->next;
+
+		if (! shared->send_head) {
+			shared->send_tail = NULL;
 		}
 
-		buffer = response.buffer;
+		pthread_mutex_unlock(&shared->lock);
+
+		cf_atomic32_decr(&batch_queue->n_buffers);
 		shared->tran_count_response += buffer->tran_count;
 
 		if (buffer->capacity) {
 			// Send buffer block to client.
 			as_batch_send_buffer(shared, buffer);
-
-			if (as_buffer_pool_push_limit(&batch_buffer_pool, buffer, buffer->capacity, g_config.batch_max_unused_buffers) != 0) {
-				cf_atomic64_incr(&g_stats.batch_index_destroyed_buffers);
-			}
+			as_batch_buffer_release(batch_queue, buffer);
 		}
 		else {
 			// Server error buffers should not be put into buffer pool.
@@ -296,8 +407,71 @@ as_batch_worker(void* udata)
 		// final batch entry and releasing memory.
 		if (shared->tran_count_response == shared->tran_max) {
 			as_batch_send_final(shared);
-			as_batch_free(shared, batch_queue);
+			as_batch_free(shared);
+			return;
+		}
+	}
+}
+
+static bool
+as_batch_steal(as_batch_queue* batch_queue, as_batch_shared** shared)
+{
+	pthread_rwlock_rdlock(&batch_steal_lock);
+
+	uint32_t max = batch_thread_pool.thread_size;
+
+	for (uint32_t i = 0; i < max && i < MAX_BATCH_THREADS; i++) {
+		as_batch_queue* bq = &batch_queues[i];
+
+		// Stop commands only go on inactive queues.
+		if (bq == batch_queue || ! bq->active) {
+			continue;
 		}
+
+		if (cf_queue_pop(bq->response_queue, shared, CF_QUEUE_NOWAIT) == CF_QUEUE_OK) {
+			pthread_rwlock_unlock(&batch_steal_lock);
+			cf_atomic64_incr(&g_stats.batch_index_steals);
+			return true;
+		}
+	}
+
+	pthread_rwlock_unlock(&batch_steal_lock);
+	return false;
+}
+
+static as_batch_shared*
+as_batch_next_shared(as_batch_queue* batch_queue)
+{
+	as_batch_shared* shared;
+
+	if (cf_queue_pop(batch_queue->response_queue, &shared, CF_QUEUE_NOWAIT) == CF_QUEUE_OK) {
+		return shared;
+	}
+
+	// Own queue is empty - steal from another active queue.
+	if (as_batch_steal(batch_queue, &shared)) {
+		return shared;
+	}
+
+	// Nothing anywhere - sleep on own queue. Producers with a busy worker may
+	// now hand batches to this queue.
+	cf_atomic32_set(&batch_queue->idle, 1);
+	cf_queue_pop(batch_queue->response_queue, &shared, CF_QUEUE_FOREVER);
+	cf_atomic32_set(&batch_queue->idle, 0);
+
+	return shared;
+}
+
+static void
+as_batch_worker(void* udata)
+{
+	as_batch_work* work = (as_batch_work*)udata;
+	as_batch_queue* batch_queue = work->batch_queue;
+	as_batch_shared* shared;
+
+	// A NULL batch is the stop command - this thread task should end.
+	while ((shared = as_batch_next_shared(batch_queue)) != NULL) {
+		as_batch_send_shared(shared);
 	}
 
 	// Send back completion notification.
@@ -316,9 +490,12 @@ as_batch_create_thread_queues(uint32_t begin, uint32_t end)
 
 	for (uint32_t i = begin; i < end; i++) {
 		work.batch_queue = &batch_queues[i];
-		work.batch_queue->response_queue = cf_queue_create(sizeof(as_batch_response), true);
+		work.batch_queue->response_queue = cf_queue_create(sizeof(as_batch_shared*), true);
 		work.batch_queue->complete_queue = cf_queue_create(sizeof(uint32_t), true);
+		work.batch_queue->buffer_queue = cf_queue_create(sizeof(as_batch_buffer*), true);
 		work.batch_queue->count = 0;
+		work.batch_queue->n_buffers = 0;
+		work.batch_queue->idle = 0;
 		work.batch_queue->active = true;
 
 		int rc = as_thread_pool_queue_task_fixed(&batch_thread_pool, &work);
@@ -371,14 +548,18 @@ as_batch_shutdown_thread_queues(uint32_t begin, uint32_t end)
 		}
 	} while (true);
 
-	// Send stop command to excess queues.
-	as_batch_response response;
-	memset(&response, 0, sizeof(as_batch_response));
+	// Send stop command to excess queues. Holding the steal lock means no
+	// worker that saw these queues active is still stealing from them.
+	as_batch_shared* stop = NULL;
+
+	pthread_rwlock_wrlock(&batch_steal_lock);
 
 	for (uint32_t i = begin; i < end; i++) {
-		cf_queue_push(batch_queues[i].response_queue, &response);
+		cf_queue_push(batch_queues[i].response_queue, &stop);
 	}
 
+	pthread_rwlock_unlock(&batch_steal_lock);
+
 	// Wait for completion events.
 	uint32_t complete;
 	for (uint32_t i = begin; i < end; i++) {
@@ -388,6 +569,15 @@ as_batch_shutdown_thread_queues(uint32_t begin, uint32_t end)
 		bq->complete_queue = 0;
 		cf_queue_destroy(bq->response_queue);
 		bq->response_queue = 0;
+
+		as_batch_buffer* buffer;
+
+		while (cf_queue_pop(bq->buffer_queue, &buffer, CF_QUEUE_NOWAIT) == CF_QUEUE_OK) {
+			cf_free(buffer);
+			cf_atomic64_incr(&g_stats.batch_index_destroyed_buffers);
+		}
+		cf_queue_destroy(bq->buffer_queue);
+		bq->buffer_queue = 0;
 	}
 	return 0;
 }
@@ -399,7 +589,7 @@ as_batch_find_queue(int queue_index)
 	for (int index = queue_index - 1; index >= 0; index--) {
 		as_batch_queue* bq = &batch_queues[index];
 
-		if (bq->active && cf_queue_sz(bq->response_queue) < g_config.batch_max_buffers_per_queue) {
+		if (bq->active && bq->n_buffers < g_config.batch_max_buffers_per_queue) {
 			return bq;
 		}
 	}
@@ -413,7 +603,7 @@ as_batch_find_queue(int queue_index)
 			break;
 		}
 
-		if (cf_queue_sz(bq->response_queue) < g_config.batch_max_buffers_per_queue) {
+		if (bq->n_buffers < g_config.batch_max_buffers_per_queue) {
 			return bq;
 		}
 	}
@@ -436,15 +626,28 @@ as_batch_buffer_pop(as_batch_shared* shared, uint32_t size)
 	uint32_t mem_size = size + batch_buffer_pool.header_size;
 
 	if (mem_size > batch_buffer_pool.buffer_size) {
-		// Requested size is greater than fixed buffer size.
-		// Allocate new buffer, but don't put back into pool.
-		buffer = as_batch_buffer_create(mem_size);
-		cf_atomic64_incr(&g_stats.batch_index_huge_buffers);
+		// Requested size is greater than fixed buffer size. Reuse a buffer of
+		// the matching size class if one is cached, otherwise allocate one.
+		uint32_t huge_class = as_batch_huge_class(mem_size);
+		uint32_t huge_size = as_batch_huge_size(huge_class);
+
+		if (huge_size >= mem_size &&
+				cf_queue_pop(batch_huge_queues[huge_class], &buffer, CF_QUEUE_NOWAIT) == CF_QUEUE_OK) {
+			buffer->capacity = huge_size - batch_buffer_pool.header_size;
+		}
+		else {
+			buffer = as_batch_buffer_create(huge_size >= mem_size ? huge_size : mem_size);
+			cf_atomic64_incr(&g_stats.batch_index_huge_buffers);
+		}
 	}
 	else {
-		// Pop existing buffer from queue.
-		// The extra lock here is unavoidable.
-		int status = cf_queue_pop(batch_buffer_pool.queue, &buffer, CF_QUEUE_NOWAIT);
+		// Pop existing buffer from this batch's queue, then from the global
+		// pool.
+		int status = cf_queue_pop(shared->batch_queue->buffer_queue, &buffer, CF_QUEUE_NOWAIT);
+
+		if (status != CF_QUEUE_OK) {
+			status = cf_queue_pop(batch_buffer_pool.queue, &buffer, CF_QUEUE_NOWAIT);
+		}
 
 		if (status == CF_QUEUE_OK) {
 			buffer->capacity = batch_buffer_pool.buffer_size - batch_buffer_pool.header_size;
@@ -475,13 +678,76 @@ as_batch_buffer_pop(as_batch_shared* shared, uint32_t size)
 	return buffer->data;
 }
 
+// Pick the queue to schedule a batch on - its own, unless that queue's worker
+// is busy and another active queue's worker is asleep. Claiming the sleeper
+// (clearing its idle flag) means concurrent producers pick different ones.
+// The steal lock is only taken once a sleeper is seen.
+static as_batch_queue*
+as_batch_schedule_queue(as_batch_queue* batch_queue)
+{
+	if (cf_atomic32_get(batch_queue->idle) != 0) {
+		return batch_queue;
+	}
+
+	uint32_t max = batch_thread_pool.thread_size;
+
+	for (uint32_t i = 0; i < max && i < MAX_BATCH_THREADS; i++) {
+		as_batch_queue* bq = &batch_queues[i];
+
+		if (bq == batch_queue || cf_atomic32_get(bq->idle) == 0) {
+			continue;
+		}
+
+		pthread_rwlock_rdlock(&batch_steal_lock);
+
+		if (bq->active && __sync_bool_compare_and_swap(&bq->idle, 1, 0)) {
+			return bq; // caller pushes, then unlocks
+		}
+
+		pthread_rwlock_unlock(&batch_steal_lock);
+	}
+
+	return batch_queue;
+}
+
 static inline void
 as_batch_buffer_complete(as_batch_shared* shared, as_batch_buffer* buffer)
 {
 	// Flush when all writers have finished writing into the buffer.
 	if (cf_atomic32_decr(&buffer->writers) == 0) {
-		as_batch_response response = {.shared = shared, .buffer = buffer};
-		cf_queue_push(shared->response_queue, &response);
+		as_batch_queue* batch_queue = shared->batch_queue;
+
+		buffer->next = NULL;
+		cf_atomic32_incr(&batch_queue->n_buffers);
+
+		pthread_mutex_lock(&shared->lock);
+
+		if (shared->send_tail) {
+			shared->send_tail->next = buffer;
+		}
+		else {
+			shared->send_head = buffer;
+		}
+
+		shared->send_tail = buffer;
+
+		bool schedule = ! shared->scheduled;
+
+		shared->scheduled = true;
+		pthread_mutex_unlock(&shared->lock);
+
+		// Not yet on a queue - put it on its own, or hand it to a sleeping
+		// worker. The push wakes whichever worker sleeps on that queue.
+		if (schedule) {
+			as_batch_queue* bq = as_batch_schedule_queue(batch_queue);
+
+			cf_queue_push(bq->response_queue, &shared);
+
+			if (bq != batch_queue) {
+				pthread_rwlock_unlock(&batch_steal_lock);
+				cf_atomic64_incr(&g_stats.batch_index_steals);
+			}
+		}
 	}
 }
 
@@ -600,6 +866,10 @@ as_batch_init()
 		return rc;
 	}
 
+	for (uint32_t i = 0; i < BATCH_HUGE_CLASSES; i++) {
+		batch_huge_queues[i] = cf_queue_create(sizeof(as_batch_buffer*), true);
+	}
+
 	rc = as_batch_create_thread_queues(0, threads);
 
 	if (rc) {
@@ -712,10 +982,10 @@ as_batch_queue_task(as_transaction* btr)
 	as_batch_queue* batch_queue = &batch_queues[queue_index];
 
 	// batch_max_buffers_per_queue is a soft limit, but still must be checked under lock.
-	if (! (batch_queue->active && cf_queue_sz(batch_queue->response_queue) < g_config.batch_max_buffers_per_queue)) {
+	if (! (batch_queue->active && batch_queue->n_buffers < g_config.batch_max_buffers_per_queue)) {
 		// Queue buffer limit has been exceeded or thread has been shutdown (probably due to
 		// downwards thread resize).  Search for an available queue.
-		// cf_warning(AS_BATCH, "Queue %u full %d", queue_index, cf_queue_sz(batch_queue->response_queue));
+		// cf_warning(AS_BATCH, "Queue %u full %d", queue_index, batch_queue->n_buffers);
 		batch_queue = as_batch_find_queue(queue_index);
 
 		if (! batch_queue) {
@@ -726,7 +996,7 @@ as_batch_queue_task(as_transaction* btr)
 	}
 	// Increment batch queue transaction count.
 	cf_atomic32_incr(&batch_queue->count);
-	shared->response_queue = batch_queue->response_queue;
+	shared->batch_queue = batch_queue;
 
 	// Initialize generic transaction.
 	as_transaction tr;
@@ -1123,14 +1393,28 @@ as_batch_queues_info(cf_dyn_buf* db)
 		as_batch_queue* bq = &batch_queues[i];
 		cf_dyn_buf_append_uint32(db, bq->count);  // Batch count
 		cf_dyn_buf_append_char(db, ':');
-		cf_dyn_buf_append_int(db, cf_queue_sz(bq->response_queue));  // Buffer count
+		cf_dyn_buf_append_int(db, bq->n_buffers);  // Buffer count
 	}
 }
 
 int
 as_batch_unused_buffers()
 {
-	return cf_queue_sz(batch_buffer_pool.queue);
+	int count = cf_queue_sz(batch_buffer_pool.queue);
+
+	for (uint32_t i = 0; i < BATCH_HUGE_CLASSES; i++) {
+		count += cf_queue_sz(batch_huge_queues[i]);
+	}
+
+	for (uint32_t i = 0; i < MAX_BATCH_THREADS; i++) {
+		as_batch_queue* bq = &batch_queues[i];
+
+		if (! bq->active) {
+			break;
+		}
+		count += cf_queue_sz(bq->buffer_queue);
+	}
+	return count;
 }
 
 // Not currently called.  Put in this place holder in case server decides to
@@ -599,7 +599,7 @@ as_bin_allocate_bin_space(as_record *r, as_storage_rd *rd, int32_t delta) {
 		rd->n_bins = (uint16_t)delta;
 
 		as_bin_space* bin_space = (as_bin_space*)
-				cf_malloc_ns(sizeof(as_bin_space) + (rd->n_bins * sizeof(as_bin)));
+				as_namespace_dim_malloc(rd->ns, sizeof(as_bin_space) + (rd->n_bins * sizeof(as_bin)));
 
 		rd->bins = bin_space->bins;
 		as_bin_set_all_empty(rd);
@@ -620,7 +620,9 @@ as_bin_allocate_bin_space(as_record *r, as_storage_rd *rd, int32_t delta) {
 
 		if (new_n_bins != 0) {
 			as_bin_space* bin_space = (as_bin_space*)
-					cf_realloc_ns((void*)as_index_get_bin_space(r), sizeof(as_bin_space) + (rd->n_bins * sizeof(as_bin)));
+					as_namespace_dim_realloc(rd->ns, (void*)as_index_get_bin_space(r),
+							sizeof(as_bin_space) + (old_n_bins * sizeof(as_bin)),
+							sizeof(as_bin_space) + (rd->n_bins * sizeof(as_bin)));
 
 			rd->bins = bin_space->bins;
 
@@ -632,7 +634,8 @@ as_bin_allocate_bin_space(as_record *r, as_storage_rd *rd, int32_t delta) {
 			as_index_set_bin_space(r, bin_space);
 		}
 		else {
-			cf_free((void*)as_index_get_bin_space(r));
+			as_namespace_dim_free(rd->ns, (void*)as_index_get_bin_space(r),
+					sizeof(as_bin_space) + (old_n_bins * sizeof(as_bin)));
 			as_index_set_bin_space(r, NULL);
 			rd->bins = NULL;
 		}
@@ -103,6 +103,7 @@ uint32_t cfg_obj_size_hist_max(uint32_t hist_max);
 void cfg_set_cluster_name(char* cluster_name);
 void create_and_check_hist_track(cf_hist_track** h, const char* name, histogram_scale scale);
 void create_and_check_hist(histogram** h, const char* name, histogram_scale scale);
+void create_and_check_sharded_hist(histogram** h, const char* name, histogram_scale scale);
 void cfg_create_all_histograms();
 int cfg_reset_self_node(as_config* config_p, cf_ip_addr *rack_addr);
 void cfg_init_serv_spec(cf_serv_spec* spec_p);
@@ -169,6 +170,7 @@ cfg_set_defaults()
 	c->fabric_dump_msgs = false;
 	c->max_msgs_per_type = -1; // by default, the maximum number of "msg" objects per type is unlimited
 	c->memory_accounting = false;
+	c->memory_accounting_sample_rate = 1;
 	c->asmalloc_enabled = true;
 
 	// Network heartbeat defaults.
@@ -263,6 +265,9 @@ typedef enum {
 	CASE_SERVICE_PAXOS_SINGLE_REPLICA_LIMIT,
 	CASE_SERVICE_PIDFILE,
 	CASE_SERVICE_SERVICE_THREADS,
+	CASE_SERVICE_SERVICE_REUSE_PORT,
+	CASE_SERVICE_SERVICE_PIN_THREADS,
+	CASE_SERVICE_AUTO_PIN,
 	CASE_SERVICE_TRANSACTION_QUEUES,
 	CASE_SERVICE_TRANSACTION_THREADS_PER_QUEUE,
 	CASE_SERVICE_CLIENT_FD_MAX, // renamed
@@ -296,6 +301,8 @@ typedef enum {
 	CASE_SERVICE_PAXOS_PROTOCOL,
 	CASE_SERVICE_PAXOS_RECOVERY_POLICY,
 	CASE_SERVICE_PAXOS_RETRANSMIT_PERIOD,
+	CASE_SERVICE_PROTO_COALESCE_REPLIES,
+	CASE_SERVICE_PROTO_COMPRESS_THRESHOLD,
 	CASE_SERVICE_PROTO_FD_IDLE_MS,
 	CASE_SERVICE_QUERY_BATCH_SIZE,
 	CASE_SERVICE_QUERY_BUFPOOL_SIZE,
@@ -312,6 +319,7 @@ typedef enum {
 	CASE_SERVICE_QUERY_THRESHOLD,
 	CASE_SERVICE_QUERY_UNTRACKED_TIME_MS,
 	CASE_SERVICE_QUERY_WORKER_THREADS,
+	CASE_SERVICE_PROFILE_SAMPLE_RATE,
 	CASE_SERVICE_RESPOND_CLIENT_ON_MASTER_COMPLETION,
 	CASE_SERVICE_RUN_AS_DAEMON,
 	CASE_SERVICE_SCAN_MAX_ACTIVE,
@@ -320,6 +328,7 @@ typedef enum {
 	CASE_SERVICE_SCAN_THREADS,
 	CASE_SERVICE_SINDEX_BUILDER_THREADS,
 	CASE_SERVICE_TICKER_INTERVAL,
+	CASE_SERVICE_TRANSACTION_COMBINE_INCREMENTS,
 	CASE_SERVICE_TRANSACTION_MAX_MS,
 	CASE_SERVICE_TRANSACTION_PENDING_LIMIT,
 	CASE_SERVICE_TRANSACTION_REPEATABLE_READ,
@@ -331,6 +340,7 @@ typedef enum {
 	CASE_SERVICE_FABRIC_DUMP_MSGS,
 	CASE_SERVICE_MAX_MSGS_PER_TYPE,
 	CASE_SERVICE_MEMORY_ACCOUNTING,
+	CASE_SERVICE_MEMORY_ACCOUNTING_SAMPLE_RATE,
 	CASE_SERVICE_PROLE_EXTRA_TTL,
 	// Obsoleted:
 	CASE_SERVICE_ALLOW_INLINE_TRANSACTIONS,
@@ -379,6 +389,10 @@ typedef enum {
 	CASE_SERVICE_UDF_RUNTIME_MAX_MEMORY,
 	CASE_SERVICE_USE_QUEUE_PER_DEVICE,
 
+	// Service auto-pin options (value tokens):
+	CASE_SERVICE_AUTO_PIN_NONE,
+	CASE_SERVICE_AUTO_PIN_NUMA,
+
 	// Service paxos protocol options (value tokens):
 	CASE_SERVICE_PAXOS_PROTOCOL_V1,
 	CASE_SERVICE_PAXOS_PROTOCOL_V2,
@@ -528,11 +542,14 @@ typedef enum {
 	CASE_NAMESPACE_ENABLE_BENCHMARKS_UDF,
 	CASE_NAMESPACE_ENABLE_BENCHMARKS_UDF_SUB,
 	CASE_NAMESPACE_ENABLE_BENCHMARKS_WRITE,
+	CASE_NAMESPACE_ENABLE_BIN_SLAB,
 	CASE_NAMESPACE_ENABLE_HIST_PROXY,
 	CASE_NAMESPACE_EVICT_HIST_BUCKETS,
 	CASE_NAMESPACE_EVICT_TENTHS_PCT,
 	CASE_NAMESPACE_HIGH_WATER_DISK_PCT,
 	CASE_NAMESPACE_HIGH_WATER_MEMORY_PCT,
+	CASE_NAMESPACE_INDEX_FILE,
+	CASE_NAMESPACE_INDEX_ON_DEVICE,
 	CASE_NAMESPACE_LDT_ENABLED,
 	CASE_NAMESPACE_LDT_GC_RATE,
 	CASE_NAMESPACE_LDT_PAGE_SIZE,
@@ -642,6 +659,8 @@ typedef enum {
 	CASE_NAMESPACE_SI_GC_MAX_UNITS,
 	CASE_NAMESPACE_SI_HISTOGRAM,
 	CASE_NAMESPACE_SI_IGNORE_NOT_SYNC,
+	CASE_NAMESPACE_SI_COVERING,
+	CASE_NAMESPACE_SI_COVERING_HASH_SIZE,
 
 	// Namespace sindex options:
 	CASE_NAMESPACE_SINDEX_NUM_PARTITIONS,
@@ -721,6 +740,9 @@ const cfg_opt SERVICE_OPTS[] = {
 		{ "paxos-single-replica-limit",		CASE_SERVICE_PAXOS_SINGLE_REPLICA_LIMIT },
 		{ "pidfile",						CASE_SERVICE_PIDFILE },
 		{ "service-threads",				CASE_SERVICE_SERVICE_THREADS },
+		{ "service-reuse-port",				CASE_SERVICE_SERVICE_REUSE_PORT },
+		{ "service-pin-threads",			CASE_SERVICE_SERVICE_PIN_THREADS },
+		{ "auto-pin",						CASE_SERVICE_AUTO_PIN },
 		{ "transaction-queues",				CASE_SERVICE_TRANSACTION_QUEUES },
 		{ "transaction-threads-per-queue",	CASE_SERVICE_TRANSACTION_THREADS_PER_QUEUE },
 		{ "client-fd-max",					CASE_SERVICE_CLIENT_FD_MAX },
@@ -753,6 +775,8 @@ const cfg_opt SERVICE_OPTS[] = {
 		{ "paxos-protocol",					CASE_SERVICE_PAXOS_PROTOCOL },
 		{ "paxos-recovery-policy",			CASE_SERVICE_PAXOS_RECOVERY_POLICY },
 		{ "paxos-retransmit-period",		CASE_SERVICE_PAXOS_RETRANSMIT_PERIOD },
+		{ "proto-coalesce-replies",			CASE_SERVICE_PROTO_COALESCE_REPLIES },
+		{ "proto-compress-threshold",		CASE_SERVICE_PROTO_COMPRESS_THRESHOLD },
 		{ "proto-fd-idle-ms",				CASE_SERVICE_PROTO_FD_IDLE_MS },
 		{ "query-batch-size",				CASE_SERVICE_QUERY_BATCH_SIZE },
 		{ "query-bufpool-size",				CASE_SERVICE_QUERY_BUFPOOL_SIZE },
@@ -769,6 +793,7 @@ const cfg_opt SERVICE_OPTS[] = {
 		{ "query-threshold", 				CASE_SERVICE_QUERY_THRESHOLD },
 		{ "query-untracked-time-ms",		CASE_SERVICE_QUERY_UNTRACKED_TIME_MS },
 		{ "query-worker-threads",			CASE_SERVICE_QUERY_WORKER_THREADS },
+		{ "profile-sample-rate",			CASE_SERVICE_PROFILE_SAMPLE_RATE },
 		{ "respond-client-on-master-completion", CASE_SERVICE_RESPOND_CLIENT_ON_MASTER_COMPLETION },
 		{ "run-as-daemon",					CASE_SERVICE_RUN_AS_DAEMON },
 		{ "scan-max-active",				CASE_SERVICE_SCAN_MAX_ACTIVE },
@@ -777,6 +802,7 @@ const cfg_opt SERVICE_OPTS[] = {
 		{ "scan-threads",					CASE_SERVICE_SCAN_THREADS },
 		{ "sindex-builder-threads",			CASE_SERVICE_SINDEX_BUILDER_THREADS },
 		{ "ticker-interval",				CASE_SERVICE_TICKER_INTERVAL },
+		{ "transaction-combine-increments",	CASE_SERVICE_TRANSACTION_COMBINE_INCREMENTS },
 		{ "transaction-max-ms",				CASE_SERVICE_TRANSACTION_MAX_MS },
 		{ "transaction-pending-limit",		CASE_SERVICE_TRANSACTION_PENDING_LIMIT },
 		{ "transaction-repeatable-read",	CASE_SERVICE_TRANSACTION_REPEATABLE_READ },
@@ -787,6 +813,7 @@ const cfg_opt SERVICE_OPTS[] = {
 		{ "fabric-dump-msgs",				CASE_SERVICE_FABRIC_DUMP_MSGS },
 		{ "max-msgs-per-type",				CASE_SERVICE_MAX_MSGS_PER_TYPE },
 		{ "memory-accounting",				CASE_SERVICE_MEMORY_ACCOUNTING },
+		{ "memory-accounting-sample-rate",	CASE_SERVICE_MEMORY_ACCOUNTING_SAMPLE_RATE },
 		{ "prole-extra-ttl",				CASE_SERVICE_PROLE_EXTRA_TTL },
 		{ "allow-inline-transactions",		CASE_SERVICE_ALLOW_INLINE_TRANSACTIONS },
 		{ "auto-dun",						CASE_SERVICE_AUTO_DUN },
@@ -835,6 +862,11 @@ const cfg_opt SERVICE_OPTS[] = {
 		{ "}",								CASE_CONTEXT_END }
 };
 
+const cfg_opt SERVICE_AUTO_PIN_OPTS[] = {
+		{ "none",							CASE_SERVICE_AUTO_PIN_NONE },
+		{ "numa",							CASE_SERVICE_AUTO_PIN_NUMA }
+};
+
 const cfg_opt SERVICE_PAXOS_PROTOCOL_OPTS[] = {
 		{ "v1",								CASE_SERVICE_PAXOS_PROTOCOL_V1 },
 		{ "v2",								CASE_SERVICE_PAXOS_PROTOCOL_V2 },
@@ -983,11 +1015,14 @@ const cfg_opt NAMESPACE_OPTS[] = {
 		{ "enable-benchmarks-udf",			CASE_NAMESPACE_ENABLE_BENCHMARKS_UDF },
 		{ "enable-benchmarks-udf-sub",		CASE_NAMESPACE_ENABLE_BENCHMARKS_UDF_SUB },
 		{ "enable-benchmarks-write",		CASE_NAMESPACE_ENABLE_BENCHMARKS_WRITE },
+		{ "enable-bin-slab",				CASE_NAMESPACE_ENABLE_BIN_SLAB },
 		{ "enable-hist-proxy",				CASE_NAMESPACE_ENABLE_HIST_PROXY },
 		{ "evict-hist-buckets",				CASE_NAMESPACE_EVICT_HIST_BUCKETS },
 		{ "evict-tenths-pct",				CASE_NAMESPACE_EVICT_TENTHS_PCT },
 		{ "high-water-disk-pct",			CASE_NAMESPACE_HIGH_WATER_DISK_PCT },
 		{ "high-water-memory-pct",			CASE_NAMESPACE_HIGH_WATER_MEMORY_PCT },
+		{ "index-file",						CASE_NAMESPACE_INDEX_FILE },
+		{ "index-on-device",				CASE_NAMESPACE_INDEX_ON_DEVICE },
 		{ "ldt-enabled",					CASE_NAMESPACE_LDT_ENABLED },
 		{ "ldt-gc-rate",					CASE_NAMESPACE_LDT_GC_RATE },
 		{ "ldt-page-size",					CASE_NAMESPACE_LDT_PAGE_SIZE },
@@ -1105,6 +1140,8 @@ const cfg_opt NAMESPACE_SI_OPTS[] = {
 		{ "si-gc-max-units",				CASE_NAMESPACE_SI_GC_MAX_UNITS },
 		{ "si-histogram",					CASE_NAMESPACE_SI_HISTOGRAM },
 		{ "si-ignore-not-sync",				CASE_NAMESPACE_SI_IGNORE_NOT_SYNC },
+		{ "si-covering",					CASE_NAMESPACE_SI_COVERING },
+		{ "si-covering-hash-size",			CASE_NAMESPACE_SI_COVERING_HASH_SIZE },
 		{ "}",								CASE_CONTEXT_END }
 };
 
@@ -1173,6 +1210,7 @@ const cfg_opt SECURITY_SYSLOG_OPTS[] = {
 
 const int NUM_GLOBAL_OPTS							= sizeof(GLOBAL_OPTS) / sizeof(cfg_opt);
 const int NUM_SERVICE_OPTS							= sizeof(SERVICE_OPTS) / sizeof(cfg_opt);
+const int NUM_SERVICE_AUTO_PIN_OPTS					= sizeof(SERVICE_AUTO_PIN_OPTS) / sizeof(cfg_opt);
 const int NUM_SERVICE_PAXOS_PROTOCOL_OPTS			= sizeof(SERVICE_PAXOS_PROTOCOL_OPTS) / sizeof(cfg_opt);
 const int NUM_SERVICE_PAXOS_RECOVERY_OPTS			= sizeof(SERVICE_PAXOS_RECOVERY_OPTS) / sizeof(cfg_opt);
 const int NUM_LOGGING_OPTS							= sizeof(LOGGING_OPTS) / sizeof(cfg_opt);
@@ -2013,6 +2051,26 @@ as_config_init(const char* config_file)
 			case CASE_SERVICE_SERVICE_THREADS:
 				c->n_service_threads = cfg_int(&line, 1, MAX_DEMARSHAL_THREADS);
 				break;
+			case CASE_SERVICE_SERVICE_REUSE_PORT:
+				c->service_reuse_port = cfg_bool(&line);
+				break;
+			case CASE_SERVICE_SERVICE_PIN_THREADS:
+				c->service_pin_threads = cfg_bool(&line);
+				break;
+			case CASE_SERVICE_AUTO_PIN:
+				switch(cfg_find_tok(line.val_tok_1, SERVICE_AUTO_PIN_OPTS, NUM_SERVICE_AUTO_PIN_OPTS)) {
+				case CASE_SERVICE_AUTO_PIN_NONE:
+					c->auto_pin = CF_TOPO_AUTO_PIN_NONE;
+					break;
+				case CASE_SERVICE_AUTO_PIN_NUMA:
+					c->auto_pin = CF_TOPO_AUTO_PIN_NUMA;
+					break;
+				case CASE_NOT_FOUND:
+				default:
+					cfg_unknown_val_tok_1(&line);
+					break;
+				}
+				break;
 			case CASE_SERVICE_TRANSACTION_QUEUES:
 				c->n_transaction_queues = cfg_u32(&line, 1, MAX_TRANSACTION_QUEUES);
 				break;
@@ -2135,6 +2193,12 @@ as_config_init(const char* config_file)
 			case CASE_SERVICE_PAXOS_RETRANSMIT_PERIOD:
 				c->paxos_retransmit_period = cfg_u32_no_checks(&line);
 				break;
+			case CASE_SERVICE_PROTO_COALESCE_REPLIES:
+				c->proto_coalesce_replies = cfg_bool(&line);
+				break;
+			case CASE_SERVICE_PROTO_COMPRESS_THRESHOLD:
+				c->proto_compress_threshold = cfg_u32_no_checks(&line);
+				break;
 			case CASE_SERVICE_PROTO_FD_IDLE_MS:
 				c->proto_fd_idle_ms = cfg_int_no_checks(&line);
 				break;
@@ -2183,6 +2247,9 @@ as_config_init(const char* config_file)
 			case CASE_SERVICE_QUERY_WORKER_THREADS:
 				c->query_worker_threads = cfg_u32(&line, 1, AS_QUERY_MAX_WORKER_THREADS);
 				break;
+			case CASE_SERVICE_PROFILE_SAMPLE_RATE:
+				c->profile_sample_rate = cfg_u32_no_checks(&line);
+				break;
 			case CASE_SERVICE_RESPOND_CLIENT_ON_MASTER_COMPLETION:
 				c->respond_client_on_master_completion = cfg_bool(&line);
 				break;
@@ -2207,6 +2274,9 @@ as_config_init(const char* config_file)
 			case CASE_SERVICE_TICKER_INTERVAL:
 				c->ticker_interval = cfg_u32_no_checks(&line);
 				break;
+			case CASE_SERVICE_TRANSACTION_COMBINE_INCREMENTS:
+				c->transaction_combine_increments = cfg_bool(&line);
+				break;
 			case CASE_SERVICE_TRANSACTION_MAX_MS:
 				c->transaction_max_ns = cfg_u64_no_checks(&line) * 1000000;
 				break;
@@ -2238,6 +2308,9 @@ as_config_init(const char* config_file)
 			case CASE_SERVICE_MEMORY_ACCOUNTING:
 				c->memory_accounting = cfg_bool(&line);
 				break;
+			case CASE_SERVICE_MEMORY_ACCOUNTING_SAMPLE_RATE:
+				c->memory_accounting_sample_rate = cfg_u32(&line, 1, 1000000);
+				break;
 			case CASE_SERVICE_PROLE_EXTRA_TTL:
 				c->prole_extra_ttl = cfg_u32_no_checks(&line);
 				break;
@@ -2799,6 +2872,9 @@ as_config_init(const char* config_file)
 			case CASE_NAMESPACE_ENABLE_BENCHMARKS_WRITE:
 				ns->write_benchmarks_enabled = true;
 				break;
+			case CASE_NAMESPACE_ENABLE_BIN_SLAB:
+				ns->bin_slab_enabled = cfg_bool(&line);
+				break;
 			case CASE_NAMESPACE_ENABLE_HIST_PROXY:
 				ns->proxy_hist_enabled = cfg_bool(&line);
 				break;
@@ -2814,6 +2890,12 @@ as_config_init(const char* config_file)
 			case CASE_NAMESPACE_HIGH_WATER_MEMORY_PCT:
 				ns->hwm_memory = (float)cfg_pct_fraction(&line);
 				break;
+			case CASE_NAMESPACE_INDEX_FILE:
+				ns->index_file = cfg_strdup(&line, true);
+				break;
+			case CASE_NAMESPACE_INDEX_ON_DEVICE:
+				ns->index_on_device = cfg_bool(&line);
+				break;
 			case CASE_NAMESPACE_LDT_ENABLED:
 				ns->ldt_enabled = cfg_bool(&line);
 				break;
@@ -2927,6 +3009,15 @@ as_config_init(const char* config_file)
 				if (ns->ldt_enabled && ns->single_bin) {
 					cf_crash_nostack(AS_CFG, "ns %s ldt-enabled and single-bin can't both be true", ns->name);
 				}
+				if (ns->bin_slab_enabled && (ns->single_bin || ! ns->storage_data_in_memory)) {
+					cf_crash_nostack(AS_CFG, "ns %s enable-bin-slab needs data-in-memory and can't be used with single-bin", ns->name);
+				}
+				if (ns->index_file && (ns->storage_type != AS_STORAGE_ENGINE_SSD || ns->storage_data_in_memory)) {
+					cf_crash_nostack(AS_CFG, "ns %s index-file needs storage-engine device without data-in-memory", ns->name);
+				}
+				if (ns->index_on_device && ! ns->index_file) {
+					cf_crash_nostack(AS_CFG, "ns %s index-on-device needs index-file", ns->name);
+				}
 				if (ns->default_ttl > ns->max_ttl) {
 					cf_crash_nostack(AS_CFG, "ns %s default-ttl can't be > max-ttl", ns->name);
 				}
@@ -3138,6 +3229,12 @@ as_config_init(const char* config_file)
 			case CASE_NAMESPACE_SI_IGNORE_NOT_SYNC:
 				si_cfg.ignore_not_sync_flag = cfg_bool(&line) ? 1 : 0;
 				break;
+			case CASE_NAMESPACE_SI_COVERING:
+				si_cfg.covering = cfg_bool(&line);
+				break;
+			case CASE_NAMESPACE_SI_COVERING_HASH_SIZE:
+				si_cfg.covering_hash_sz = cfg_u32(&line, 1, 1024 * 1024);
+				break;
 			case CASE_CONTEXT_END:
 				if (SHASH_OK != shash_put_unique(ns->sindex_cfg_var_hash, (void*)si_cfg.name, (void*)&si_cfg)) {
 					cf_crash_nostack(AS_CFG, "ns %s failed inserting hash for si config item %s", ns->name, si_cfg.name);
@@ -3697,6 +3794,8 @@ as_config_post_process(as_config* c, const char* config_file)
 		ns->tree_shared.locks_shift			= 12 - cf_msb(ns->tree_shared.n_lock_pairs);
 		ns->tree_shared.sprigs_shift		= 12 - cf_msb(ns->tree_shared.n_sprigs);
 		ns->tree_shared.sprigs_offset		= sizeof(as_lock_pair) * ns->tree_shared.n_lock_pairs;
+		ns->tree_shared.runs_offset			= ns->tree_shared.sprigs_offset + (sizeof(as_sprig) * ns->tree_shared.n_sprigs);
+		ns->tree_shared.run_size			= ns->index_on_device ? INDEX_RUN_BYTES / as_index_size_get(ns) : 0;
 
 		char hist_name[HISTOGRAM_NAME_SIZE];
 
@@ -4203,14 +4302,24 @@ create_and_check_hist(histogram** h, const char* name, histogram_scale scale)
 	}
 }
 
+void
+create_and_check_sharded_hist(histogram** h, const char* name,
+		histogram_scale scale)
+{
+	if (NULL == (*h = histogram_create_sharded(name, scale))) {
+		cf_crash(AS_AS, "couldn't create histogram: %s", name);
+	}
+}
+
 // TODO - not really a config method any more, reorg needed.
 void
 cfg_create_all_histograms()
 {
 	create_and_check_hist(&g_stats.batch_index_hist, "batch-index", HIST_MILLISECONDS);
+	create_and_check_hist(&g_stats.batch_index_small_hist, "batch-index-small", HIST_MILLISECONDS);
 	create_and_check_hist(&g_stats.info_hist, "info", HIST_MILLISECONDS);
-	create_and_check_hist(&g_stats.svc_demarshal_hist, "svc-demarshal", HIST_MILLISECONDS);
-	create_and_check_hist(&g_stats.svc_queue_hist, "svc-queue", HIST_MILLISECONDS);
+	create_and_check_sharded_hist(&g_stats.svc_demarshal_hist, "svc-demarshal", HIST_MILLISECONDS);
+	create_and_check_sharded_hist(&g_stats.svc_queue_hist, "svc-queue", HIST_MILLISECONDS);
 
 	create_and_check_hist(&g_stats.fabric_send_init_hists[AS_FABRIC_CHANNEL_BULK], "fabric-bulk-send-init", HIST_MILLISECONDS);
 	create_and_check_hist(&g_stats.fabric_send_fragment_hists[AS_FABRIC_CHANNEL_BULK], "fabric-bulk-send-fragment", HIST_MILLISECONDS);
@@ -101,6 +101,7 @@ int as_index_sprig_exists(as_index_sprig *isprig, cf_digest *keyd);
 int as_index_sprig_get_vlock(as_index_sprig *isprig, cf_digest *keyd, as_index_ref *index_ref);
 int as_index_sprig_get_insert_vlock(as_index_sprig *isprig, cf_digest *keyd, as_index_ref *index_ref);
 int as_index_sprig_delete(as_index_sprig *isprig, cf_digest *keyd);
+cf_arenax_handle as_index_sprig_alloc(as_index_sprig *isprig);
 
 int as_index_sprig_search_lockless(as_index_sprig *isprig, cf_digest *keyd, as_index **ret, cf_arenax_handle *ret_h);
 void as_index_sprig_insert_rebalance(as_index_sprig *isprig, as_index *root_parent, as_index_ele *ele);
@@ -120,6 +121,8 @@ as_index_sprig_from_i(as_index_tree *tree, as_index_sprig *isprig,
 	isprig->arena = tree->arena;
 	isprig->pair = tree_locks(tree) + lock_i;
 	isprig->sprig = tree_sprigs(tree) + sprig_i;
+	isprig->run = tree->shared->run_size == 0 ? NULL : tree_runs(tree) + sprig_i;
+	isprig->run_size = tree->shared->run_size;
 }
 
 static inline void
@@ -140,6 +143,8 @@ as_index_sprig_from_keyd(as_index_tree *tree, as_index_sprig *isprig,
 	isprig->arena = tree->arena;
 	isprig->pair = tree_locks(tree) + lock_i;
 	isprig->sprig = tree_sprigs(tree) + sprig_i;
+	isprig->run = tree->shared->run_size == 0 ? NULL : tree_runs(tree) + sprig_i;
+	isprig->run_size = tree->shared->run_size;
 }
 
 
@@ -181,7 +186,10 @@ as_index_tree_create(as_index_tree_shared *shared, cf_arenax *arena)
 {
 	size_t locks_size = sizeof(pthread_mutex_t) * shared->n_lock_pairs * 2;
 	size_t sprigs_size = sizeof(as_sprig) * shared->n_sprigs;
-	size_t tree_size = sizeof(as_index_tree) + locks_size + sprigs_size;
+	size_t runs_size = shared->run_size == 0 ?
+			0 : sizeof(as_sprig_run) * shared->n_sprigs;
+	size_t tree_size = sizeof(as_index_tree) + locks_size + sprigs_size +
+			runs_size;
 
 	as_index_tree *tree = cf_rc_alloc(tree_size);
 
@@ -202,6 +210,10 @@ as_index_tree_create(as_index_tree_shared *shared, cf_arenax *arena)
 	// The tree starts empty.
 	memset(tree_sprigs(tree), 0, sprigs_size);
 
+	if (runs_size != 0) {
+		memset(tree_runs(tree), 0, runs_size);
+	}
+
 	return tree;
 }
 
@@ -375,6 +387,7 @@ as_index_tree_destroy(as_index_tree *tree)
 {
 	as_sprig* sprig = tree_sprigs(tree);
 	as_sprig* sprig_end = sprig + tree->shared->n_sprigs;
+	as_sprig_run* run = tree_runs(tree);
 
 	while (sprig < sprig_end) {
 		as_index_sprig isprig;
@@ -385,6 +398,11 @@ as_index_tree_destroy(as_index_tree *tree)
 		isprig.sprig = sprig;
 
 		as_index_sprig_traverse_purge(&isprig, isprig.sprig->root_h);
+
+		if (run) {
+			as_sprig_release_run(isprig.arena, run++);
+		}
+
 		sprig++;
 	}
 
@@ -700,7 +718,7 @@ as_index_sprig_get_insert_vlock(as_index_sprig *isprig, cf_digest *keyd,
 	cf_arenax_handle old_root = isprig->sprig->root_h;
 
 	// Make the new element.
-	cf_arenax_handle n_h = cf_arenax_alloc(isprig->arena);
+	cf_arenax_handle n_h = as_index_sprig_alloc(isprig);
 
 	if (n_h == 0) {
 		cf_warning(AS_INDEX, "arenax alloc failed");
@@ -918,6 +936,37 @@ as_index_sprig_delete(as_index_sprig *isprig, cf_digest *keyd)
 }
 
 
+// Allocate an element for insertion. Caller holds the sprig's lock pair. If
+// the index is on device, new elements come from a run the sprig owns, so a
+// sprig's elements (and a lookup's path) stay on few device pages - freed
+// elements are still reused first, singly.
+cf_arenax_handle
+as_index_sprig_alloc(as_index_sprig *isprig)
+{
+	as_sprig_run *run = isprig->run;
+
+	if (! run) {
+		return cf_arenax_alloc(isprig->arena);
+	}
+
+	if (run->run_left == 0) {
+		uint32_t n = isprig->run_size;
+		cf_arenax_handle run_h = cf_arenax_alloc_run(isprig->arena, &n);
+
+		if (run_h == 0) {
+			return cf_arenax_alloc(isprig->arena);
+		}
+
+		run->run_h = run_h;
+		run->run_left = n;
+	}
+
+	run->run_left--;
+
+	return run->run_h++;
+}
+
+
 //==========================================================
 // Local helpers - search/rebalance a sprig.
 //
@@ -26,29 +26,57 @@
 
 #include "base/index.h"
 
+#include <stdint.h>
+
 #include "arenax.h"
 #include "fault.h"
 
 #include "base/datamodel.h"
 
 
+//==========================================================
+// Forward declarations.
+//
+
+static uint32_t resume_sprig(cf_arenax *arena, cf_arenax_handle r_h);
+
+
 //==========================================================
 // Public API.
 //
 
+// Rebuild a tree from sprig roots saved by as_index_tree_shutdown(), with its
+// elements still in the (file-backed) arena.
 as_index_tree *
 as_index_tree_resume(as_index_tree_shared *shared, cf_arenax *arena,
 		as_treex *treex)
 {
-	cf_crash(AS_INDEX, "CE code called as_index_tree_resume()");
-	return NULL;
+	as_index_tree *tree = as_index_tree_create(shared, arena);
+	as_sprig *sprig = tree_sprigs(tree);
+
+	for (uint32_t i = 0; i < shared->n_sprigs; i++) {
+		sprig[i].root_h = treex[i].root_h;
+		sprig[i].n_elements = resume_sprig(arena, sprig[i].root_h);
+	}
+
+	return tree;
 }
 
 
+// Save sprig roots for as_index_tree_resume(). Caller holds all record locks.
 void
 as_index_tree_shutdown(as_index_tree *tree, as_treex *treex)
 {
-	// For enterprise version only.
+	as_sprig *sprig = tree_sprigs(tree);
+	as_sprig_run *run = tree_runs(tree);
+
+	for (uint32_t i = 0; i < tree->shared->n_sprigs; i++) {
+		if (run) {
+			as_sprig_release_run(tree->arena, &run[i]);
+		}
+
+		treex[i].root_h = sprig[i].root_h;
+	}
 }
 
 
@@ -65,3 +93,25 @@ as_index_reduce_partial_live(as_index_tree *tree, uint32_t sample_count,
 {
 	as_index_reduce_partial(tree, sample_count, cb, udata);
 }
+
+
+//==========================================================
+// Local helpers.
+//
+
+// Count a resumed sprig's elements, dropping any reservations that were held
+// at shutdown - only the tree's own reference survives a restart. Recursion
+// depth is bounded by the red-black tree height.
+static uint32_t
+resume_sprig(cf_arenax *arena, cf_arenax_handle r_h)
+{
+	if (r_h == SENTINEL_H) {
+		return 0;
+	}
+
+	as_index *r = (as_index*)cf_arenax_resolve(arena, r_h);
+
+	r->rc = 1;
+
+	return 1 + resume_sprig(arena, r->left_h) + resume_sprig(arena, r->right_h);
+}
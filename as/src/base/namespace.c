@@ -29,11 +29,14 @@
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 
 #include "citrusleaf/alloc.h"
 #include "citrusleaf/cf_atomic.h"
+#include "citrusleaf/cf_clock.h"
 
 #include "dynbuf.h"
 #include "fault.h"
@@ -41,6 +44,7 @@
 #include "jem.h"
 #include "linear_hist.h"
 #include "meminfo.h"
+#include "slab.h"
 #include "vmapx.h"
 
 #include "base/cfg.h"
@@ -55,6 +59,11 @@
 
 static as_namespace_id g_namespace_id_counter = 0;
 
+static bool g_truncate_smd_restored = false;
+
+static int truncate_smd_can_accept_cb(char *module, as_smd_item_t *item, void *udata);
+static int truncate_smd_accept_cb(char *module, as_smd_item_list_t *items, void *udata, uint32_t accept_opt);
+
 // Create a new namespace and hook it up in the data structure
 
 as_namespace *
@@ -118,6 +127,8 @@ as_namespace_create(char *name)
 	ns->evict_tenths_pct = 5; // default eviction amount is 0.5%
 	ns->hwm_disk = 0.5; // default high water mark for eviction is 50%
 	ns->hwm_memory = 0.6; // default high water mark for eviction is 60%
+	ns->index_file = NULL; // by default the index is in process memory only
+	ns->index_on_device = false;
 	ns->ldt_enabled = false; // By default ldt is not enabled
 	ns->ldt_gc_sleep_us = 500; // Default is sleep for .5Ms. This translates to constant 2k Subrecord
 							   // GC per second.
@@ -202,6 +213,10 @@ as_namespaces_init(bool cold_start_cmd, uint32_t instance)
 			cf_free(ns->sets_cfg_array);
 		}
 
+		if (ns->bin_slab_enabled) {
+			ns->bin_slab = cf_slab_create();
+		}
+
 		for (uint32_t pid = 0; pid < AS_PARTITIONS; pid++) {
 			as_partition_init(ns, pid);
 		}
@@ -225,6 +240,20 @@ as_namespaces_init(bool cold_start_cmd, uint32_t instance)
 	while (! g_sindex_smd_restored) {
 		usleep(1000);
 	}
+
+	// Truncate cutoffs must be restored before as_storage_init() loads
+	// records, so cold start can skip truncated ones.
+	retval = as_smd_create_module(TRUNCATE_MODULE, NULL, NULL,
+			truncate_smd_accept_cb, NULL, truncate_smd_can_accept_cb, NULL);
+
+	if (retval < 0) {
+		cf_crash(AS_NAMESPACE, "failed to create SMD module '%s' (rv %d)",
+				TRUNCATE_MODULE, retval);
+	}
+
+	while (! g_truncate_smd_restored) {
+		usleep(1000);
+	}
 }
 
 
@@ -316,6 +345,38 @@ as_namespace_get_bymsgfield(as_msg_field *fp)
 }
 
 
+// Memory for data-in-memory multi-bin records' bin space and stored keys.
+// Callers pass sizes since slab slots have no headers.
+void *
+as_namespace_dim_malloc(as_namespace *ns, size_t size)
+{
+	return ns->bin_slab ?
+			cf_slab_malloc(ns->bin_slab, size) : cf_malloc_ns(size);
+}
+
+
+void *
+as_namespace_dim_realloc(as_namespace *ns, void *p, size_t old_size,
+		size_t size)
+{
+	return ns->bin_slab ?
+			cf_slab_realloc(ns->bin_slab, p, old_size, size) :
+			cf_realloc_ns(p, size);
+}
+
+
+void
+as_namespace_dim_free(as_namespace *ns, void *p, size_t size)
+{
+	if (ns->bin_slab) {
+		cf_slab_free(ns->bin_slab, p, size);
+	}
+	else {
+		cf_free(p);
+	}
+}
+
+
 #define CL_TERA_BYTES	1099511627776L
 #define CL_PETA_BYTES	1125899906842624L
 
@@ -354,10 +415,11 @@ as_namespace_eval_write_state(as_namespace *ns, bool *hwm_breached, bool *stop_w
 	}
 
 	// compute memory size of namespace
-	// compute index size - index is always stored in memory
-	uint64_t index_sz = cf_atomic64_get(ns->n_objects) * as_index_size_get(ns);
-	uint64_t sub_index_sz = cf_atomic64_get(ns->n_sub_objects) * as_index_size_get(ns);
-	uint64_t tombstone_index_sz = cf_atomic64_get(ns->n_tombstones) * as_index_size_get(ns);
+	// compute index size - index is stored in memory unless it's on device
+	uint64_t index_element_sz = ns->index_on_device ? 0 : as_index_size_get(ns);
+	uint64_t index_sz = cf_atomic64_get(ns->n_objects) * index_element_sz;
+	uint64_t sub_index_sz = cf_atomic64_get(ns->n_sub_objects) * index_element_sz;
+	uint64_t tombstone_index_sz = cf_atomic64_get(ns->n_tombstones) * index_element_sz;
 	uint64_t sindex_sz = cf_atomic64_get(ns->n_bytes_sindex_memory);
 	uint64_t data_in_memory_sz = cf_atomic_int_get(ns->n_bytes_memory);
 	uint64_t memory_sz = index_sz + sub_index_sz + tombstone_index_sz + data_in_memory_sz + sindex_sz;
@@ -599,6 +661,10 @@ append_set_props(as_set *p_set, cf_dyn_buf *db)
 	cf_dyn_buf_append_string(db, IS_SET_DELETED(p_set) ? "true" : "false");
 	cf_dyn_buf_append_char(db, ':');
 
+	cf_dyn_buf_append_string(db, "truncate_lut=");
+	cf_dyn_buf_append_uint64(db, cf_atomic64_get(p_set->truncate_lut));
+	cf_dyn_buf_append_char(db, ':');
+
 	// Configuration:
 
 	cf_dyn_buf_append_string(db, "stop-writes-count=");
@@ -651,6 +717,167 @@ as_namespace_get_set_info(as_namespace *ns, const char *set_name, cf_dyn_buf *db
 	}
 }
 
+// Truncate cutoffs are system metadata - keys are "<ns>" or "<ns>:<set>",
+// values the cutoff. SMD distributes them to all nodes and persists them.
+
+static void
+truncate_apply(as_namespace *ns, const char *set_name, uint64_t lut)
+{
+	if (! set_name) {
+		cf_atomic64_setmax(&ns->truncate_lut, lut);
+		cf_info(AS_NAMESPACE, "{%s} truncating records last updated at or before %lu", ns->name, lut);
+		return;
+	}
+
+	// The set may not have been seen on this node yet.
+	as_set *p_set;
+	uint16_t set_id;
+
+	if (as_namespace_get_create_set_w_len(ns, set_name, strlen(set_name),
+			&p_set, &set_id) != 0) {
+		cf_warning(AS_NAMESPACE, "{%s} can't truncate set %s", ns->name, set_name);
+		return;
+	}
+
+	cf_atomic64_setmax(&p_set->truncate_lut, lut);
+	cf_info(AS_NAMESPACE, "{%s} truncating set %s records last updated at or before %lu", ns->name, set_name, lut);
+}
+
+// Splits an SMD item into namespace, set (NULL for a namespace) and cutoff.
+// Splits key in place.
+static as_namespace *
+truncate_parse_item(char *key, const char *value, char **p_set_name, uint64_t *p_lut)
+{
+	char *set_name = strchr(key, ':');
+
+	if (set_name) {
+		*set_name++ = 0;
+	}
+
+	as_namespace *ns = as_namespace_get_byname(key);
+
+	if (! ns || (set_name && *set_name == 0) || ! value) {
+		return NULL;
+	}
+
+	char *end;
+	uint64_t lut = strtoul(value, &end, 10);
+
+	if (*end != 0 || lut == 0) {
+		return NULL;
+	}
+
+	*p_set_name = set_name;
+	*p_lut = lut;
+
+	return ns;
+}
+
+static int
+truncate_smd_can_accept_cb(char *module, as_smd_item_t *item, void *udata)
+{
+	if (item->action != AS_SMD_ACTION_SET) {
+		return 0;
+	}
+
+	char key[strlen(item->key) + 1];
+	char *set_name;
+	uint64_t lut;
+
+	strcpy(key, item->key);
+
+	return truncate_parse_item(key, item->value, &set_name, &lut) ? 0 : -1;
+}
+
+static int
+truncate_smd_accept_cb(char *module, as_smd_item_list_t *items, void *udata,
+		uint32_t accept_opt)
+{
+	if (accept_opt & AS_SMD_ACCEPT_OPT_CREATE) {
+		g_truncate_smd_restored = true;
+		return 0;
+	}
+
+	for (size_t i = 0; i < items->num_items; i++) {
+		as_smd_item_t *item = items->item[i];
+
+		// Cutoffs only move forward - nothing to undo on delete.
+		if (item->action != AS_SMD_ACTION_SET) {
+			continue;
+		}
+
+		char key[strlen(item->key) + 1];
+		char *set_name;
+		uint64_t lut;
+
+		strcpy(key, item->key);
+
+		as_namespace *ns = truncate_parse_item(key, item->value, &set_name, &lut);
+
+		if (! ns) {
+			cf_warning(AS_NAMESPACE, "ignoring bad truncate item %s", item->key);
+			continue;
+		}
+
+		truncate_apply(ns, set_name, lut);
+	}
+
+	return 0;
+}
+
+// Truncate a set, or the whole namespace if set_name is NULL. Records last
+// updated at or before lut (clepoch ms, 0 for now) are treated as deleted from
+// here on - nsup deletes them in the background. Cutoffs only move forward.
+// The cutoff is applied cluster-wide when SMD accepts it.
+int
+as_namespace_truncate(as_namespace *ns, const char *set_name, uint64_t lut)
+{
+	uint64_t now = cf_clepoch_milliseconds();
+
+	if (lut == 0) {
+		lut = now;
+	}
+	else if (lut > now) {
+		cf_warning(AS_NAMESPACE, "{%s} can't truncate - lut %lu is in the future", ns->name, lut);
+		return -1;
+	}
+
+	char key[AS_ID_NAMESPACE_SZ + 1 + AS_SET_NAME_MAX_SIZE];
+	uint64_t cur_lut;
+
+	if (! set_name) {
+		snprintf(key, sizeof(key), "%s", ns->name);
+		cur_lut = cf_atomic64_get(ns->truncate_lut);
+	}
+	else {
+		as_set *p_set;
+
+		if (cf_vmapx_get_by_name(ns->p_sets_vmap, set_name, (void**)&p_set) != CF_VMAPX_OK) {
+			cf_warning(AS_NAMESPACE, "{%s} can't truncate - set %s doesn't exist", ns->name, set_name);
+			return -1;
+		}
+
+		snprintf(key, sizeof(key), "%s:%s", ns->name, set_name);
+		cur_lut = cf_atomic64_get(p_set->truncate_lut);
+	}
+
+	// SMD keeps the latest item, which must not hold an older cutoff.
+	if (lut < cur_lut) {
+		lut = cur_lut;
+	}
+
+	char value[24];
+
+	snprintf(value, sizeof(value), "%lu", lut);
+
+	if (as_smd_set_metadata(TRUNCATE_MODULE, key, value) != 0) {
+		cf_warning(AS_NAMESPACE, "{%s} failed to distribute truncate", ns->name);
+		return -1;
+	}
+
+	return 0;
+}
+
 void
 as_namespace_adjust_set_memory(as_namespace *ns, uint16_t set_id,
 		int64_t delta_bytes)
@@ -20,10 +20,18 @@
  * along with this program.  If not, see http://www.gnu.org/licenses/
  */
 
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 #include "citrusleaf/alloc.h"
+#include "citrusleaf/cf_random.h"
 
 #include "arenax.h"
 #include "fault.h"
@@ -33,6 +41,23 @@
 #include "base/datamodel.h"
 #include "base/index.h"
 
+// With index-file configured, a clean shutdown writes "<index-file>.ckpt" -
+// this header, then the tree roots (as_treex), then the sets vmap values
+// (as_set) in set-ID order. The token ties it to the arena checkpoint.
+typedef struct index_ckpt_s {
+	uint32_t	magic;
+	uint32_t	version;
+	uint64_t	token;
+	uint32_t	n_sprigs;
+	uint32_t	n_roots;
+	uint32_t	n_sets;
+	uint32_t	set_size;
+	uint64_t	truncate_lut;
+} index_ckpt;
+
+#define INDEX_CKPT_MAGIC	0x1D3C4E7A
+#define INDEX_CKPT_VERSION	2
+
 static bool
 check_capacity(uint32_t capacity)
 {
@@ -88,12 +113,128 @@ as_mem_check()
 	return capacity;
 }
 
+static uint32_t
+n_xmem_roots(const as_namespace* ns)
+{
+	return AS_PARTITIONS * ns->tree_shared.n_sprigs * (ns->ldt_enabled ? 2 : 1);
+}
+
+static uint32_t
+arena_flags(const as_namespace* ns)
+{
+	return CF_ARENAX_BIGLOCK | CF_ARENAX_MAGAZINES |
+			(ns->index_on_device ? CF_ARENAX_DEVICE : 0);
+}
+
 static void
-setup_namespace(as_namespace* ns, uint32_t stage_capacity)
+ckpt_path(const as_namespace* ns, const char* suffix, char* path)
+{
+	snprintf(path, PATH_MAX, "%s.ckpt%s", ns->index_file, suffix);
+}
+
+// Read (and consume) the index checkpoint, and resume the arena it refers to.
+// On success, tree roots are in ns->xmem_roots and the saved sets are returned
+// via pp_sets. Any checkpoint is removed regardless - once we've started, the
+// devices and arena will diverge from it.
+static bool
+resume_index(as_namespace* ns, bool cold_start_cmd, as_set** pp_sets,
+		uint32_t* p_n_sets)
+{
+	char path[PATH_MAX];
+
+	ckpt_path(ns, "", path);
+
+	int fd = open(path, O_RDONLY);
+
+	if (fd == -1) {
+		cf_info(AS_NAMESPACE, "{%s} no index checkpoint %s", ns->name, path);
+		return false;
+	}
+
+	unlink(path);
+
+	if (cold_start_cmd) {
+		cf_info(AS_NAMESPACE, "{%s} cold start command - ignoring index checkpoint", ns->name);
+		close(fd);
+		return false;
+	}
+
+	index_ckpt ckpt;
+	size_t roots_size = sizeof(as_treex) * n_xmem_roots(ns);
+
+	if (read(fd, &ckpt, sizeof(ckpt)) != (ssize_t)sizeof(ckpt) ||
+			ckpt.magic != INDEX_CKPT_MAGIC ||
+			ckpt.version != INDEX_CKPT_VERSION ||
+			ckpt.n_sprigs != ns->tree_shared.n_sprigs ||
+			ckpt.n_roots != n_xmem_roots(ns) ||
+			ckpt.n_sets > AS_SET_MAX_COUNT ||
+			ckpt.set_size != sizeof(as_set)) {
+		cf_warning(AS_NAMESPACE, "{%s} index checkpoint %s doesn't match configuration", ns->name, path);
+		close(fd);
+		return false;
+	}
+
+	as_set* sets = cf_malloc(sizeof(as_set) * (ckpt.n_sets + 1));
+
+	if (! sets) {
+		cf_crash(AS_NAMESPACE, "{%s} can't allocate checkpoint sets", ns->name);
+	}
+
+	if (read(fd, ns->xmem_roots, roots_size) != (ssize_t)roots_size ||
+			read(fd, sets, sizeof(as_set) * ckpt.n_sets) != (ssize_t)(sizeof(as_set) * ckpt.n_sets)) {
+		cf_warning(AS_NAMESPACE, "{%s} index checkpoint %s truncated", ns->name, path);
+		cf_free(sets);
+		close(fd);
+		return false;
+	}
+
+	close(fd);
+
+	cf_arenax_err arena_result = cf_arenax_resume_mapped(ns->arena, ns->index_file, as_index_size_get(ns), arena_flags(ns), ckpt.token);
+
+	if (arena_result != CF_ARENAX_OK) {
+		cf_warning(AS_NAMESPACE, "{%s} can't resume arena: %s", ns->name, cf_arenax_errstr(arena_result));
+		cf_free(sets);
+		return false;
+	}
+
+	cf_atomic64_set(&ns->truncate_lut, ckpt.truncate_lut);
+
+	*pp_sets = sets;
+	*p_n_sets = ckpt.n_sets;
+
+	return true;
+}
+
+static void
+setup_namespace(as_namespace* ns, uint32_t stage_capacity, bool cold_start_cmd)
 {
 	ns->cold_start = true;
 
-	cf_info(AS_NAMESPACE, "{%s} beginning COLD start", ns->name);
+	ns->arena = (cf_arenax*)cf_malloc(cf_arenax_sizeof());
+
+	if (! ns->arena) {
+		cf_crash(AS_NAMESPACE, "{%s} can't allocate index arena", ns->name);
+	}
+
+	as_set* ckpt_sets = NULL;
+	uint32_t n_ckpt_sets = 0;
+
+	if (ns->index_file) {
+		ns->xmem_roots = (as_treex*)cf_calloc(n_xmem_roots(ns), sizeof(as_treex));
+
+		if (! ns->xmem_roots) {
+			cf_crash(AS_NAMESPACE, "{%s} can't allocate tree roots", ns->name);
+		}
+
+		if (ns->ldt_enabled) {
+			ns->sub_tree_roots = ns->xmem_roots + (AS_PARTITIONS * ns->tree_shared.n_sprigs);
+		}
+
+		ns->cold_start = ! resume_index(ns, cold_start_cmd, &ckpt_sets, &n_ckpt_sets);
+	}
+
+	cf_info(AS_NAMESPACE, "{%s} beginning %s start", ns->name, ns->cold_start ? "COLD" : "WARM");
 
 	//--------------------------------------------
 	// Set up the set name vmap.
@@ -111,6 +252,24 @@ setup_namespace(as_namespace* ns, uint32_t stage_capacity)
 		cf_crash(AS_NAMESPACE, "{%s} can't create sets vmap: %d", ns->name, vmap_result);
 	}
 
+	// Restore sets in their original order, so set-IDs in the index still
+	// match. Counts are rebuilt when devices are resumed - truncate cutoffs are kept.
+	for (uint32_t i = 0; i < n_ckpt_sets; i++) {
+		as_set* p_set = &ckpt_sets[i];
+		uint32_t idx;
+
+		p_set->name[AS_SET_NAME_MAX_SIZE - 1] = 0;
+		cf_atomic64_set(&p_set->n_objects, 0);
+		cf_atomic64_set(&p_set->n_tombstones, 0);
+		cf_atomic64_set(&p_set->n_bytes_memory, 0);
+
+		if (cf_vmapx_put_unique(ns->p_sets_vmap, p_set, &idx) != CF_VMAPX_OK || idx != i) {
+			cf_crash(AS_NAMESPACE, "{%s} can't restore set %s from index checkpoint", ns->name, p_set->name);
+		}
+	}
+
+	cf_free(ckpt_sets);
+
 	// Transfer configuration file information about sets.
 	if (! as_namespace_configure_sets(ns)) {
 		cf_crash(AS_NAMESPACE, "{%s} can't configure sets", ns->name);
@@ -135,16 +294,16 @@ setup_namespace(as_namespace* ns, uint32_t stage_capacity)
 	}
 
 	//--------------------------------------------
-	// Set up the index arena.
+	// Set up the index arena (unless resumed).
 	//
 
-	ns->arena = (cf_arenax*)cf_malloc(cf_arenax_sizeof());
-
-	if (! ns->arena) {
-		cf_crash(AS_NAMESPACE, "{%s} can't allocate index arena", ns->name);
+	if (! ns->cold_start) {
+		return;
 	}
 
-	cf_arenax_err arena_result = cf_arenax_create(ns->arena, 0, as_index_size_get(ns), stage_capacity, 0, CF_ARENAX_BIGLOCK);
+	cf_arenax_err arena_result = ns->index_file ?
+			cf_arenax_create_mapped(ns->arena, ns->index_file, as_index_size_get(ns), stage_capacity, 0, arena_flags(ns)) :
+			cf_arenax_create(ns->arena, 0, as_index_size_get(ns), stage_capacity, 0, CF_ARENAX_BIGLOCK | CF_ARENAX_MAGAZINES);
 
 	if (arena_result != CF_ARENAX_OK) {
 		cf_crash(AS_NAMESPACE, "{%s} can't create arena: %s", ns->name, cf_arenax_errstr(arena_result));
@@ -155,12 +314,76 @@ void
 as_namespaces_setup(bool cold_start_cmd, uint32_t instance, uint32_t stage_capacity)
 {
 	for (uint32_t i = 0; i < g_config.n_namespaces; i++) {
-		setup_namespace(g_config.namespaces[i], stage_capacity);
+		setup_namespace(g_config.namespaces[i], stage_capacity, cold_start_cmd);
 	}
 }
 
+// Called at clean shutdown, after tree roots are saved and storage is flushed.
+// Write the checkpoint a file-backed index warm restarts from.
 void
 as_namespace_xmem_trusted(as_namespace *ns)
 {
-	// For enterprise version only.
+	if (! ns->index_file) {
+		return;
+	}
+
+	uint64_t token = cf_get_rand64();
+	cf_arenax_err arena_result = cf_arenax_checkpoint(ns->arena, token);
+
+	if (arena_result != CF_ARENAX_OK) {
+		cf_warning(AS_NAMESPACE, "{%s} can't checkpoint arena: %s - next start will be cold", ns->name, cf_arenax_errstr(arena_result));
+		return;
+	}
+
+	index_ckpt ckpt = {
+			.magic = INDEX_CKPT_MAGIC,
+			.version = INDEX_CKPT_VERSION,
+			.token = token,
+			.n_sprigs = ns->tree_shared.n_sprigs,
+			.n_roots = n_xmem_roots(ns),
+			.n_sets = cf_vmapx_count(ns->p_sets_vmap),
+			.set_size = sizeof(as_set),
+			.truncate_lut = cf_atomic64_get(ns->truncate_lut)
+	};
+
+	char tmp_path[PATH_MAX];
+	char path[PATH_MAX];
+
+	ckpt_path(ns, ".tmp", tmp_path);
+	ckpt_path(ns, "", path);
+
+	int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+
+	if (fd == -1) {
+		cf_warning(AS_NAMESPACE, "{%s} can't open %s: %s", ns->name, tmp_path, cf_strerror(errno));
+		return;
+	}
+
+	size_t roots_size = sizeof(as_treex) * ckpt.n_roots;
+	bool ok = write(fd, &ckpt, sizeof(ckpt)) == (ssize_t)sizeof(ckpt) &&
+			write(fd, ns->xmem_roots, roots_size) == (ssize_t)roots_size;
+
+	for (uint32_t i = 0; ok && i < ckpt.n_sets; i++) {
+		as_set* p_set;
+
+		ok = cf_vmapx_get_by_index(ns->p_sets_vmap, i, (void**)&p_set) == CF_VMAPX_OK &&
+				write(fd, p_set, sizeof(as_set)) == (ssize_t)sizeof(as_set);
+	}
+
+	if (! ok || fsync(fd) != 0) {
+		cf_warning(AS_NAMESPACE, "{%s} failed write of %s: %s", ns->name, tmp_path, cf_strerror(errno));
+		close(fd);
+		unlink(tmp_path);
+		return;
+	}
+
+	close(fd);
+
+	if (rename(tmp_path, path) != 0) {
+		cf_warning(AS_NAMESPACE, "{%s} can't rename %s: %s", ns->name, tmp_path, cf_strerror(errno));
+		unlink(tmp_path);
+		return;
+	}
+
+	cf_info(AS_NAMESPACE, "{%s} wrote index checkpoint %s", ns->name, path);
 }
@@ -20,8 +20,11 @@
  * along with this program.  If not, see http://www.gnu.org/licenses/
  */
 
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <sys/uio.h>
 #include <zlib.h>
 
 #include "citrusleaf/alloc.h"
@@ -33,6 +36,143 @@
 
 #define STACK_BUF_SZ (1024 * 16)
 
+// Replies are compressed for bandwidth, not size - favor speed.
+#define REPLY_COMPRESSION_LEVEL Z_BEST_SPEED
+
+
+//==========================================================
+// Per-thread zlib streams.
+//
+// Setting up a z_stream allocates its window and state (a few hundred KB for
+// deflate), which uncompress() and compress2() do afresh for every packet.
+// Instead, each thread keeps one inflate and one deflate stream and resets
+// them between packets. Streams are torn down when their thread exits.
+//
+
+typedef struct thread_zstreams_s {
+	z_stream	inflate_strm;
+	z_stream	deflate_strm;
+	bool		inflate_ok;
+	bool		deflate_ok;
+} thread_zstreams;
+
+static pthread_key_t g_zstreams_key;
+static pthread_once_t g_zstreams_once = PTHREAD_ONCE_INIT;
+
+static void
+zstreams_destroy(void *udata)
+{
+	thread_zstreams *zs = (thread_zstreams *)udata;
+
+	if (zs->inflate_ok) {
+		inflateEnd(&zs->inflate_strm);
+	}
+
+	if (zs->deflate_ok) {
+		deflateEnd(&zs->deflate_strm);
+	}
+
+	cf_free(zs);
+}
+
+static void
+zstreams_key_init()
+{
+	pthread_key_create(&g_zstreams_key, zstreams_destroy);
+}
+
+static thread_zstreams *
+get_thread_zstreams()
+{
+	pthread_once(&g_zstreams_once, zstreams_key_init);
+
+	thread_zstreams *zs = (thread_zstreams *)pthread_getspecific(g_zstreams_key);
+
+	if (! zs) {
+		zs = cf_calloc(1, sizeof(thread_zstreams));
+		cf_assert(zs, AS_COMPRESSION, "allocation failed");
+		pthread_setspecific(g_zstreams_key, zs);
+	}
+
+	return zs;
+}
+
+static z_stream *
+get_inflate_stream()
+{
+	thread_zstreams *zs = get_thread_zstreams();
+
+	if (zs->inflate_ok) {
+		return inflateReset(&zs->inflate_strm) == Z_OK ?
+				&zs->inflate_strm : NULL;
+	}
+
+	if (inflateInit(&zs->inflate_strm) != Z_OK) {
+		cf_warning(AS_COMPRESSION, "failed inflate init: %s",
+				zs->inflate_strm.msg ? zs->inflate_strm.msg : "");
+		return NULL;
+	}
+
+	zs->inflate_ok = true;
+
+	return &zs->inflate_strm;
+}
+
+static z_stream *
+get_deflate_stream()
+{
+	thread_zstreams *zs = get_thread_zstreams();
+
+	if (zs->deflate_ok) {
+		return deflateReset(&zs->deflate_strm) == Z_OK ?
+				&zs->deflate_strm : NULL;
+	}
+
+	if (deflateInit(&zs->deflate_strm, REPLY_COMPRESSION_LEVEL) != Z_OK) {
+		cf_warning(AS_COMPRESSION, "failed deflate init: %s",
+				zs->deflate_strm.msg ? zs->deflate_strm.msg : "");
+		return NULL;
+	}
+
+	zs->deflate_ok = true;
+
+	return &zs->deflate_strm;
+}
+
+// Same results as uncompress(), using this thread's inflate stream.
+static int
+stream_uncompress(uint8_t *out_buf, size_t *out_buf_len, const uint8_t *buf,
+		size_t buf_len)
+{
+	z_stream *strm = get_inflate_stream();
+
+	if (! strm) {
+		return Z_MEM_ERROR;
+	}
+
+	strm->next_in = (Bytef *)buf;
+	strm->avail_in = (uInt)buf_len;
+	strm->next_out = out_buf;
+	strm->avail_out = (uInt)*out_buf_len;
+
+	int rv = inflate(strm, Z_FINISH);
+
+	*out_buf_len = strm->total_out;
+
+	switch (rv) {
+	case Z_STREAM_END:
+		return Z_OK;
+	case Z_NEED_DICT:
+		return Z_DATA_ERROR;
+	case Z_OK:
+	case Z_BUF_ERROR:
+		// Input used up without reaching the end means it was truncated.
+		return strm->avail_in == 0 ? Z_DATA_ERROR : Z_BUF_ERROR;
+	default:
+		return rv;
+	}
+}
+
 /**
  * Function to decompress the given data
  * Expected arguments
@@ -50,11 +190,7 @@ as_decompress(compression_type type, size_t buf_len, const uint8_t *buf, size_t
 	cf_debug(AS_COMPRESSION, "In as_decompress");
 	switch (type) {
 		case COMPRESSION_ZLIB: {
-			// manual convert to match types just in case
-			uLongf converted_out_buf_len = *out_buf_len;
-			// zlib api to decompress the data
-			ret_value = uncompress(out_buf, &converted_out_buf_len, buf, (uLongf) buf_len);
-			*out_buf_len = converted_out_buf_len;
+			ret_value = stream_uncompress(out_buf, out_buf_len, buf, buf_len);
 			break;
 		}
 		default:
@@ -232,3 +368,72 @@ as_packet_compression(uint8_t *buf, size_t buf_sz, uint8_t **compressed_packet,
 	cf_debug(AS_COMPRESSION, "Returned as_packet_compression : 0");
 	return 0;
 }
+
+/*
+ * Function to compress an outgoing proto message, header included, into a
+ * PROTO_TYPE_AS_MSG_COMPRESSED packet. The message may be scattered over
+ * several iovec segments - they're streamed through this thread's deflate
+ * stream, without being gathered first.
+ * Returns the packet (cf_malloc'd), or NULL if compressing didn't shrink the
+ * message or failed - the caller then sends the message as is.
+ */
+uint8_t *
+as_proto_compress_iov(const struct iovec *iov, int n_iov, size_t *out_sz)
+{
+	size_t org_sz = 0;
+
+	for (int i = 0; i < n_iov; i++) {
+		org_sz += iov[i].iov_len;
+	}
+
+	if (org_sz <= sizeof(as_comp_proto)) {
+		return NULL;
+	}
+
+	z_stream *strm = get_deflate_stream();
+
+	if (! strm) {
+		return NULL;
+	}
+
+	// Only worth sending if it comes out smaller than the original, so give
+	// deflate no more room than that.
+	uint8_t *packet = cf_malloc(org_sz);
+
+	if (! packet) {
+		return NULL;
+	}
+
+	strm->next_out = packet + sizeof(as_comp_proto);
+	strm->avail_out = (uInt)(org_sz - sizeof(as_comp_proto));
+
+	int rv = Z_OK;
+
+	for (int i = 0; i < n_iov; i++) {
+		strm->next_in = (Bytef *)iov[i].iov_base;
+		strm->avail_in = (uInt)iov[i].iov_len;
+
+		rv = deflate(strm, i == n_iov - 1 ? Z_FINISH : Z_NO_FLUSH);
+
+		if (rv == Z_STREAM_ERROR || strm->avail_in != 0) {
+			break; // out of room - not compressible enough
+		}
+	}
+
+	if (rv != Z_STREAM_END) {
+		cf_free(packet);
+		return NULL;
+	}
+
+	*out_sz = sizeof(as_comp_proto) + strm->total_out;
+
+	as_comp_proto *as_comp_protop = (as_comp_proto *)packet;
+
+	as_comp_protop->proto.version = PROTO_VERSION;
+	as_comp_protop->proto.type = PROTO_TYPE_AS_MSG_COMPRESSED;
+	as_comp_protop->proto.sz = *out_sz - sizeof(as_proto);
+	as_proto_swap(&as_comp_protop->proto);
+	as_comp_protop->org_sz = org_sz;
+
+	return packet;
+}
@@ -40,6 +40,7 @@
 
 #include "base/datamodel.h"
 #include "base/ldt.h"
+#include "base/particle_blob.h"
 #include "base/proto.h"
 #include "fabric/partition.h"
 #include "storage/storage.h"
@@ -846,6 +847,26 @@ as_bin_particle_client_value_size(const as_bin *b)
 	return particle_vtable[type]->wire_size_fn(b->particle);
 }
 
+// Returns size of client value if it can be sent straight from the particle
+// (e.g. from a storage read buffer) without as_bin_particle_to_client(),
+// otherwise 0.
+uint32_t
+as_bin_particle_client_value_ptr(const as_bin *b, const uint8_t **p_value)
+{
+	if (! as_bin_inuse(b) || as_bin_is_hidden(b)) {
+		return 0;
+	}
+
+	uint8_t type = as_bin_get_particle_type(b);
+
+	// String and all the blob types - wire value is a plain copy.
+	if (particle_vtable[type]->to_wire_fn != blob_to_wire) {
+		return 0;
+	}
+
+	return blob_wire_ptr(b->particle, p_value);
+}
+
 uint32_t
 as_bin_particle_to_client(const as_bin *b, as_msg_op *op)
 {
@@ -226,6 +226,17 @@ blob_to_wire(const as_particle *p, uint8_t *wire)
 	return p_blob_mem->sz;
 }
 
+// Wire value is the particle's data as is - point at it instead of copying.
+uint32_t
+blob_wire_ptr(const as_particle *p, const uint8_t **p_wire)
+{
+	blob_mem *p_blob_mem = (blob_mem *)p;
+
+	*p_wire = p_blob_mem->data;
+
+	return p_blob_mem->sz;
+}
+
 //------------------------------------------------
 // Handle as_val translation.
 //
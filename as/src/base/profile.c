@@ -0,0 +1,260 @@
+/*
+ * profile.c
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+//==========================================================
+// Includes.
+//
+
+#include "base/profile.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "citrusleaf/alloc.h"
+#include "citrusleaf/cf_atomic.h"
+#include "citrusleaf/cf_clock.h"
+
+#include "dynbuf.h"
+#include "fault.h"
+
+#include "base/cfg.h"
+#include "base/transaction.h"
+
+
+//==========================================================
+// Typedefs & constants.
+//
+
+// Marks per thread - the most recent are kept. Must be a power of 2.
+#define RING_SIZE (1024 * 4)
+#define MAX_RINGS 1024
+
+// A mark packs elapsed ns above the phase (in the low 8 bits), so it's written
+// with a single store and a racing reader never sees half of one.
+typedef struct profile_ring_s {
+	uint64_t	n_marks;
+	uint64_t	marks[RING_SIZE];
+} profile_ring;
+
+static const char* PHASE_NAMES[] = {
+		"demarshal",
+		"queue-wait",
+		"index",
+		"storage-read",
+		"replication",
+		"response"
+};
+
+COMPILER_ASSERT(sizeof(PHASE_NAMES) / sizeof(const char*) == AS_PROFILE_N_PHASES);
+
+
+//==========================================================
+// Globals.
+//
+
+// Rings are never freed - they belong to long-lived service threads, and the
+// reader may be looking at one at any time.
+static profile_ring* g_rings[MAX_RINGS];
+static cf_atomic32 g_n_rings = 0;
+
+static __thread profile_ring* g_ring = NULL;
+static __thread uint32_t g_n_sample_candidates = 0;
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static profile_ring* get_ring();
+static void collect_ring(const profile_ring* ring, uint64_t** elapsed,
+		size_t* n_elapsed, const size_t* max_elapsed);
+static int compare_u64(const void* pa, const void* pb);
+
+
+//==========================================================
+// Public API.
+//
+
+// Called at demarshal - flags 1 in profile-sample-rate transactions for
+// profiling.
+void
+as_profile_sample(as_transaction* tr)
+{
+	uint32_t rate = g_config.profile_sample_rate;
+
+	if (rate != 0 && g_n_sample_candidates++ % rate == 0) {
+		tr->from_flags |= FROM_FLAG_PROFILE;
+	}
+}
+
+void
+as_profile_mark(as_profile_phase phase, uint64_t start_ns)
+{
+	profile_ring* ring = get_ring();
+
+	if (! ring) {
+		return;
+	}
+
+	uint64_t elapsed_ns = cf_getns() - start_ns;
+
+	ring->marks[ring->n_marks & (RING_SIZE - 1)] = (elapsed_ns << 8) | phase;
+	ring->n_marks++;
+}
+
+// Summarize the marks currently in all rings, per phase. All times are elapsed
+// microseconds since transaction start, so the growth from one phase to the
+// next shows where time goes.
+void
+as_profile_get_info(cf_dyn_buf* db)
+{
+	uint32_t n_rings = cf_atomic32_get(g_n_rings);
+
+	if (n_rings > MAX_RINGS) {
+		n_rings = MAX_RINGS;
+	}
+
+	// Size per phase first - rings keep filling meanwhile, so the second pass
+	// is bounded by these sizes.
+	size_t max_elapsed[AS_PROFILE_N_PHASES] = { 0 };
+
+	for (uint32_t i = 0; i < n_rings; i++) {
+		collect_ring(g_rings[i], NULL, max_elapsed, NULL);
+	}
+
+	uint64_t* elapsed[AS_PROFILE_N_PHASES];
+	size_t n_elapsed[AS_PROFILE_N_PHASES] = { 0 };
+
+	for (int p = 0; p < AS_PROFILE_N_PHASES; p++) {
+		elapsed[p] = max_elapsed[p] == 0 ?
+				NULL : cf_malloc(max_elapsed[p] * sizeof(uint64_t));
+
+		cf_assert(max_elapsed[p] == 0 || elapsed[p], AS_INFO, "alloc profile");
+	}
+
+	for (uint32_t i = 0; i < n_rings; i++) {
+		collect_ring(g_rings[i], elapsed, n_elapsed, max_elapsed);
+	}
+
+	for (int p = 0; p < AS_PROFILE_N_PHASES; p++) {
+		size_t n = n_elapsed[p];
+		uint64_t total = 0;
+
+		if (n != 0) {
+			qsort(elapsed[p], n, sizeof(uint64_t), compare_u64);
+
+			for (size_t e = 0; e < n; e++) {
+				total += elapsed[p][e];
+			}
+		}
+
+		cf_dyn_buf_append_string(db, PHASE_NAMES[p]);
+		cf_dyn_buf_append_string(db, ":count=");
+		cf_dyn_buf_append_uint64(db, n);
+		cf_dyn_buf_append_string(db, ",mean-us=");
+		cf_dyn_buf_append_uint64(db, n == 0 ? 0 : total / n / 1000);
+		cf_dyn_buf_append_string(db, ",p50-us=");
+		cf_dyn_buf_append_uint64(db, n == 0 ? 0 : elapsed[p][n / 2] / 1000);
+		cf_dyn_buf_append_string(db, ",p99-us=");
+		cf_dyn_buf_append_uint64(db, n == 0 ? 0 : elapsed[p][n * 99 / 100] / 1000);
+		cf_dyn_buf_append_string(db, ",p99.9-us=");
+		cf_dyn_buf_append_uint64(db, n == 0 ? 0 : elapsed[p][n * 999 / 1000] / 1000);
+		cf_dyn_buf_append_char(db, ';');
+
+		if (elapsed[p]) {
+			cf_free(elapsed[p]);
+		}
+	}
+
+	cf_dyn_buf_chomp(db);
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+static profile_ring*
+get_ring()
+{
+	if (g_ring) {
+		return g_ring;
+	}
+
+	uint32_t ix = cf_atomic32_incr(&g_n_rings) - 1;
+
+	if (ix >= MAX_RINGS) {
+		return NULL; // too many threads - this one goes unprofiled
+	}
+
+	profile_ring* ring = cf_calloc(1, sizeof(profile_ring));
+
+	cf_assert(ring, AS_INFO, "alloc profile_ring");
+
+	g_rings[ix] = ring;
+	g_ring = ring;
+
+	return ring;
+}
+
+// Without elapsed, just count marks per phase into n_elapsed.
+static void
+collect_ring(const profile_ring* ring, uint64_t** elapsed, size_t* n_elapsed,
+		const size_t* max_elapsed)
+{
+	if (! ring) {
+		return; // registered but not yet published
+	}
+
+	uint64_t n_marks = ring->n_marks;
+
+	if (n_marks > RING_SIZE) {
+		n_marks = RING_SIZE;
+	}
+
+	for (uint64_t m = 0; m < n_marks; m++) {
+		uint64_t mark = ring->marks[m];
+		uint32_t p = (uint32_t)(mark & 0xFF);
+
+		if (p >= AS_PROFILE_N_PHASES) {
+			continue;
+		}
+
+		if (! elapsed) {
+			n_elapsed[p]++;
+		}
+		else if (n_elapsed[p] < max_elapsed[p]) {
+			elapsed[p][n_elapsed[p]++] = mark >> 8;
+		}
+	}
+}
+
+static int
+compare_u64(const void* pa, const void* pb)
+{
+	uint64_t a = *(const uint64_t*)pa;
+	uint64_t b = *(const uint64_t*)pb;
+
+	return a < b ? -1 : (a > b ? 1 : 0);
+}
@@ -45,8 +45,10 @@
 #include "socket.h"
 
 #include "base/as_stap.h"
+#include "base/cfg.h"
 #include "base/datamodel.h"
 #include "base/index.h"
+#include "base/packet_compression.h"
 #include "base/thr_tsvc.h"
 #include "base/transaction.h"
 #include "storage/storage.h"
@@ -91,13 +93,35 @@ as_msg_swap_field(as_msg_field *mf)
 // Either way it returns what it filled in.
 //
 
-cl_msg *
-as_msg_make_response_msg(uint32_t result_code, uint32_t generation,
+// Bin values at least this big are sent from where they sit (e.g. a storage
+// read buffer) rather than copied into the response buffer.
+#define REPLY_ZERO_COPY_MIN_SZ (16 * 1024)
+#define REPLY_ZERO_COPY_MAX_BINS 16
+#define REPLY_IOV_MAX (1 + (2 * REPLY_ZERO_COPY_MAX_BINS))
+
+static uint32_t
+zero_copy_value(const as_bin *b, uint32_t n_refs, const uint8_t **p_value)
+{
+	if (! b || n_refs == REPLY_ZERO_COPY_MAX_BINS) {
+		return 0;
+	}
+
+	uint32_t sz = as_bin_particle_client_value_ptr(b, p_value);
+
+	return sz >= REPLY_ZERO_COPY_MIN_SZ ? sz : 0;
+}
+
+// If iov is not NULL, big values are left out of the returned buffer - iov
+// gets the buffer segments interleaved with those values, in wire order.
+static cl_msg *
+make_response_msg(uint32_t result_code, uint32_t generation,
 		uint32_t void_time, as_msg_op **ops, as_bin **bins, uint16_t bin_count,
 		as_namespace *ns, cl_msg *msgp_in, size_t *msg_sz_in, uint64_t trid,
-		const char *setname)
+		const char *setname, struct iovec *iov, int *p_n_iov)
 {
 	size_t msg_sz = sizeof(cl_msg);
+	size_t ref_sz = 0;
+	uint32_t n_refs = 0;
 
 	msg_sz += sizeof(as_msg_op) * bin_count;
 
@@ -116,6 +140,14 @@ as_msg_make_response_msg(uint32_t result_code, uint32_t generation,
 		if (bins[i]) {
 			msg_sz += as_bin_particle_client_value_size(bins[i]);
 		}
+
+		const uint8_t *value;
+		uint32_t value_sz;
+
+		if (iov && (value_sz = zero_copy_value(bins[i], n_refs, &value)) != 0) {
+			ref_sz += value_sz;
+			n_refs++;
+		}
 	}
 
 	if (trid != 0) {
@@ -129,10 +161,11 @@ as_msg_make_response_msg(uint32_t result_code, uint32_t generation,
 		msg_sz += sizeof(as_msg_field) + setname_len;
 	}
 
+	size_t buf_sz = msg_sz - ref_sz;
 	uint8_t *b;
 
-	if (! msgp_in || *msg_sz_in < msg_sz) {
-		b = cf_malloc(msg_sz);
+	if (! msgp_in || *msg_sz_in < buf_sz) {
+		b = cf_malloc(buf_sz);
 
 		if (! b) {
 			return NULL;
@@ -142,7 +175,7 @@ as_msg_make_response_msg(uint32_t result_code, uint32_t generation,
 		b = (uint8_t *)msgp_in;
 	}
 
-	*msg_sz_in = msg_sz;
+	*msg_sz_in = buf_sz;
 
 	uint8_t *buf = b;
 	cl_msg *msgp = (cl_msg *)buf;
@@ -196,6 +229,11 @@ as_msg_make_response_msg(uint32_t result_code, uint32_t generation,
 
 	as_msg_swap_header(m);
 
+	uint8_t *seg = b;
+	int n_iov = 0;
+
+	n_refs = 0;
+
 	for (uint16_t i = 0; i < bin_count; i++) {
 		as_msg_op *op = (as_msg_op *)buf;
 
@@ -214,29 +252,184 @@ as_msg_make_response_msg(uint32_t result_code, uint32_t generation,
 		op->op_sz = 4 + op->name_sz;
 
 		buf += sizeof(as_msg_op) + op->name_sz;
-		buf += as_bin_particle_to_client(bins[i], op);
+
+		const uint8_t *value;
+		uint32_t value_sz;
+
+		if (iov && (value_sz = zero_copy_value(bins[i], n_refs, &value)) != 0) {
+			op->particle_type = as_bin_get_particle_type(bins[i]);
+			op->op_sz += value_sz;
+
+			iov[n_iov].iov_base = seg;
+			iov[n_iov++].iov_len = buf - seg;
+			iov[n_iov].iov_base = (void *)value;
+			iov[n_iov++].iov_len = value_sz;
+
+			seg = buf;
+			n_refs++;
+		}
+		else {
+			buf += as_bin_particle_to_client(bins[i], op);
+		}
 
 		as_msg_swap_op(op);
 	}
 
+	if (iov) {
+		iov[n_iov].iov_base = seg;
+		iov[n_iov++].iov_len = buf - seg;
+		*p_n_iov = n_iov;
+	}
+
 	return (cl_msg *)b;
 }
 
+cl_msg *
+as_msg_make_response_msg(uint32_t result_code, uint32_t generation,
+		uint32_t void_time, as_msg_op **ops, as_bin **bins, uint16_t bin_count,
+		as_namespace *ns, cl_msg *msgp_in, size_t *msg_sz_in, uint64_t trid,
+		const char *setname)
+{
+	return make_response_msg(result_code, generation, void_time, ops, bins,
+			bin_count, ns, msgp_in, msg_sz_in, trid, setname, NULL, NULL);
+}
 
-// Send a response made by write_local().
-// TODO - refactor and share with as_msg_send_reply().
-int
-as_msg_send_ops_reply(as_file_handle *fd_h, cf_dyn_buf *db)
+
+//==========================================================
+// Reply compression.
+//
+
+// Compress an outgoing message if the client on this connection has sent us
+// compressed requests, and the message is at least proto-compress-threshold.
+// Returns the compressed message (cf_malloc'd), or NULL to send it as is.
+uint8_t *
+as_proto_compress_reply(const as_file_handle *fd_h, const struct iovec *iov,
+		int n_iov, size_t *out_sz)
+{
+	uint32_t threshold = g_config.proto_compress_threshold;
+
+	if (threshold == 0 || (fd_h->fh_info & FH_INFO_COMPRESS) == 0) {
+		return NULL;
+	}
+
+	size_t sz = 0;
+
+	for (int i = 0; i < n_iov; i++) {
+		sz += iov[i].iov_len;
+	}
+
+	if (sz < threshold) {
+		return NULL;
+	}
+
+	return as_proto_compress_iov(iov, n_iov, out_sz);
+}
+
+
+//==========================================================
+// Reply coalescing.
+//
+// A client that pipelines requests has the next one(s) sitting in the file
+// handle's pending bytes by the time the current reply is ready. If enabled,
+// such replies are held in the file handle and go out with the reply to the
+// last request of the pipeline, in one send. Each transaction still ends (and
+// rearms the connection) as usual - only the send is deferred.
+//
+// Anything else that writes directly to a client socket must flush first, so
+// replies stay in order.
+//
+
+#define REPLY_COALESCE_MAX (64 * 1024)
+
+static bool
+has_pipelined_request(const as_file_handle *fd_h)
+{
+	if (fd_h->pending_sz < sizeof(as_proto)) {
+		return false;
+	}
+
+	as_proto proto;
+
+	memcpy(&proto, fd_h->pending, sizeof(as_proto));
+	as_proto_swap(&proto);
+
+	return fd_h->pending_sz >= sizeof(as_proto) + proto.sz;
+}
+
+static void
+gather_reply(as_file_handle *fd_h, const struct iovec *iov, int n_iov)
+{
+	if (! fd_h->out) {
+		fd_h->out = cf_malloc(REPLY_COALESCE_MAX);
+		cf_assert(fd_h->out, AS_PROTO, "allocation: %s", cf_strerror(errno));
+	}
+
+	for (int i = 0; i < n_iov; i++) {
+		memcpy(fd_h->out + fd_h->out_sz, iov[i].iov_base, iov[i].iov_len);
+		fd_h->out_sz += (uint32_t)iov[i].iov_len;
+	}
+}
+
+static int
+send_reply_iov(as_file_handle *fd_h, struct iovec *iov, int n_iov)
 {
 	if (! cf_socket_exists(&fd_h->sock)) {
-		cf_crash(AS_PROTO, "fd is NULL");
+		cf_crash(AS_PROTO, "send reply: can't write to NULL fd");
 	}
 
-	if (cf_socket_send_all(&fd_h->sock, db->buf, db->used_sz, MSG_NOSIGNAL,
-			CF_SOCKET_TIMEOUT) < 0) {
+	struct iovec comp_iov;
+	size_t comp_sz;
+	uint8_t *comp = as_proto_compress_reply(fd_h, iov, n_iov, &comp_sz);
+
+	if (comp) {
+		comp_iov.iov_base = comp;
+		comp_iov.iov_len = comp_sz;
+		iov = &comp_iov;
+		n_iov = 1;
+	}
+
+	size_t sz = 0;
+
+	for (int i = 0; i < n_iov; i++) {
+		sz += iov[i].iov_len;
+	}
+
+	struct iovec out_iov;
+
+	if (fd_h->out_sz + sz > REPLY_COALESCE_MAX) {
+		as_msg_flush_replies(fd_h);
+	}
+	else if (g_config.proto_coalesce_replies && has_pipelined_request(fd_h)) {
+		gather_reply(fd_h, iov, n_iov);
+
+		if (comp) {
+			cf_free(comp);
+		}
+
+		as_end_of_transaction_ok(fd_h);
+		return 0;
+	}
+	else if (fd_h->out_sz != 0) {
+		gather_reply(fd_h, iov, n_iov);
+
+		out_iov.iov_base = fd_h->out;
+		out_iov.iov_len = fd_h->out_sz;
+		iov = &out_iov;
+		n_iov = 1;
+		fd_h->out_sz = 0;
+	}
+
+	int rv = cf_socket_send_iov_all(&fd_h->sock, iov, n_iov, MSG_NOSIGNAL,
+			CF_SOCKET_TIMEOUT);
+
+	if (comp) {
+		cf_free(comp);
+	}
+
+	if (rv < 0) {
 		// Common when a client aborts.
 		cf_debug(AS_PROTO, "protocol write fail: fd %d sz %zu errno %d",
-				CSFD(&fd_h->sock), db->used_sz, errno);
+				CSFD(&fd_h->sock), sz, errno);
 		as_end_of_transaction_force_close(fd_h);
 		return -1;
 	}
@@ -245,6 +438,98 @@ as_msg_send_ops_reply(as_file_handle *fd_h, cf_dyn_buf *db)
 	return 0;
 }
 
+static int
+send_reply(as_file_handle *fd_h, uint8_t *buf, size_t sz)
+{
+	struct iovec iov = { .iov_base = buf, .iov_len = sz };
+
+	return send_reply_iov(fd_h, &iov, 1);
+}
+
+// Send any held replies. On failure, shut the socket down so whoever writes
+// next fails and closes the connection the usual way.
+void
+as_msg_flush_replies(as_file_handle *fd_h)
+{
+	if (fd_h->out_sz == 0) {
+		return;
+	}
+
+	uint32_t sz = fd_h->out_sz;
+
+	fd_h->out_sz = 0;
+
+	if (cf_socket_send_all(&fd_h->sock, fd_h->out, sz, MSG_NOSIGNAL,
+			CF_SOCKET_TIMEOUT) < 0) {
+		cf_debug(AS_PROTO, "protocol write fail: fd %d sz %u errno %d",
+				CSFD(&fd_h->sock), sz, errno);
+		cf_socket_shutdown(&fd_h->sock);
+	}
+}
+
+
+static void
+reply_riders(as_reply_rider *rider, uint32_t result_code, uint32_t generation,
+		uint32_t void_time)
+{
+	while (rider) {
+		as_reply_rider *next = rider->next;
+
+		as_msg_send_reply(rider->fd_h, result_code, generation, void_time,
+				NULL, NULL, 0, NULL, rider->trid, NULL);
+		cf_free(rider);
+
+		rider = next;
+	}
+}
+
+// Reply to any writes combined into this handle's transaction, with its result.
+void
+as_msg_reply_riders(as_file_handle *fd_h, uint32_t result_code,
+		uint32_t generation, uint32_t void_time)
+{
+	as_reply_rider *riders = fd_h->riders;
+
+	fd_h->riders = NULL;
+	reply_riders(riders, result_code, generation, void_time);
+}
+
+// As above, taking the result from an already made (wire order) reply.
+void
+as_msg_reply_riders_from_msg(as_file_handle *fd_h, const uint8_t *buf,
+		size_t sz)
+{
+	if (! fd_h->riders) {
+		return;
+	}
+
+	if (sz < sizeof(cl_msg)) {
+		as_msg_reply_riders(fd_h, AS_PROTO_RESULT_FAIL_UNKNOWN, 0, 0);
+		return;
+	}
+
+	const as_msg *m = &((const cl_msg *)buf)->msg;
+
+	as_msg_reply_riders(fd_h, m->result_code, cf_swap_from_be32(m->generation),
+			cf_swap_from_be32(m->record_ttl));
+}
+
+
+// Send a response made by write_local().
+int
+as_msg_send_ops_reply(as_file_handle *fd_h, cf_dyn_buf *db)
+{
+	as_reply_rider *riders = fd_h->riders;
+
+	fd_h->riders = NULL;
+
+	int rv = send_reply(fd_h, db->buf, db->used_sz);
+
+	reply_riders(riders, AS_PROTO_RESULT_OK, 0, 0);
+
+	return rv;
+}
+
 
 // NB: this uses the same logic as the bufbuild function
 // as_msg_make_response_bufbuilder() but does not build a buffer and simply
@@ -656,36 +941,32 @@ as_msg_send_reply(as_file_handle *fd_h, uint32_t result_code, uint32_t generatio
 	size_t msg_sz = sizeof(fb);
 //	memset(fb,0xff,msg_sz);  // helpful to see what you might not be setting
 
-	uint8_t *msgp = (uint8_t *) as_msg_make_response_msg( result_code, generation,
-					void_time, ops, bins, bin_count, ns,
-					(cl_msg *)fb, &msg_sz, trid, setname);
+	// Big values go out straight from the bins - typically the storage read
+	// buffer - without being copied into the response.
+	struct iovec iov[REPLY_IOV_MAX];
+	int n_iov;
 
-	if (!msgp)	return(-1);
+	uint8_t *msgp = (uint8_t *) make_response_msg( result_code, generation,
+					void_time, ops, bins, bin_count, ns,
+					(cl_msg *)fb, &msg_sz, trid, setname, iov, &n_iov);
 
-	if (! cf_socket_exists(&fd_h->sock)) {
-		cf_warning(AS_PROTO, "write to NULL fd internal error");
-		cf_crash(AS_PROTO, "send reply: can't write to NULL fd");
-	}
+	// Riders get the same result, after the transaction's own reply.
+	as_reply_rider *riders = fd_h->riders;
 
-//	cf_detail(AS_PROTO, "write fd %d",fd);
-	int rv;
+	fd_h->riders = NULL;
 
-	if (cf_socket_send_all(&fd_h->sock, msgp, msg_sz, MSG_NOSIGNAL,
-			CF_SOCKET_TIMEOUT) < 0) {
-		// Common when a client aborts.
-		cf_debug(AS_PROTO, "protocol write fail: fd %d sz %zu",
-				CSFD(&fd_h->sock), msg_sz);
-		as_end_of_transaction_force_close(fd_h);
-		rv = -1;
-	}
-	else {
-		as_end_of_transaction_ok(fd_h);
-		rv = 0;
+	if (!msgp) {
+		reply_riders(riders, AS_PROTO_RESULT_FAIL_UNKNOWN, 0, 0);
+		return(-1);
 	}
 
+	int rv = send_reply_iov(fd_h, iov, n_iov);
+
 	if ((uint8_t *)msgp != fb)
 		cf_free(msgp);
 
+	reply_riders(riders, result_code, generation, void_time);
+
 	return(rv);
 }
 
@@ -865,11 +1146,25 @@ as_msg_send_fin(cf_socket *sock, uint32_t result_code)
 	return as_msg_send_response(sock, (uint8_t*) &m, sizeof(m), MSG_NOSIGNAL);
 }
 
-#define AS_NETIO_MAX_IO_RETRY         5
+//==========================================================
+// Async query result streaming.
+//
+// Query workers try to send each result packet straight away. If the client
+// can't take it all (EAGAIN), the packet is handed to the netio thread and
+// the worker moves on. The netio thread parks such packets in its epoll set,
+// waiting for the socket to become writable, instead of retrying on a timer.
+// Packets of a query must go out in order - a packet whose predecessor is
+// still pending waits on a retry queue, which is revisited every
+// proto-slow-netio-sleep-ms while anything is parked or waiting.
+//
+// Backpressure is the query's n_io_outstanding limit - see
+// query_netio_wait().
+//
+
+#define NETIO_POLL_SZ 256
+
 static pthread_t      g_netio_th;
-static pthread_t      g_netio_slow_th;
 static cf_queue     * g_netio_queue      = 0;
-static cf_queue     * g_netio_slow_queue = 0;
 
 int
 as_netio_send_packet(as_file_handle *fd_h, cf_buf_builder *bb_r, uint32_t *offset, bool blocking)
@@ -878,23 +1173,39 @@ as_netio_send_packet(as_file_handle *fd_h, cf_buf_builder *bb_r, uint32_t *offse
 	uint64_t nodeid = g_config.self_node;
 #endif
 
+	// A packet that was parked or retried already has its header (and may
+	// already be compressed) - only prepare it the first time.
+	if (((as_proto *)bb_r->buf)->type != PROTO_TYPE_AS_MSG_COMPRESSED) {
+		as_proto proto;
+		proto.version = PROTO_VERSION;
+		proto.type    = PROTO_TYPE_AS_MSG;
+		proto.sz      = bb_r->used_sz - 8;
+		as_proto_swap(&proto);
+
+		memcpy(bb_r->buf, &proto, 8);
+
+		if (*offset == 0) {
+			struct iovec iov = { .iov_base = bb_r->buf, .iov_len = bb_r->used_sz };
+			size_t comp_sz;
+			uint8_t *comp = as_proto_compress_reply(fd_h, &iov, 1, &comp_sz);
+
+			// Compressed is always smaller - reuse the packet's buffer.
+			if (comp) {
+				memcpy(bb_r->buf, comp, comp_sz);
+				bb_r->used_sz = (uint32_t)comp_sz;
+				cf_free(comp);
+			}
+		}
+	}
+
 	uint32_t len  = bb_r->used_sz;
 	uint8_t *buf  = bb_r->buf;
 
-	as_proto proto;
-	proto.version = PROTO_VERSION;
-	proto.type    = PROTO_TYPE_AS_MSG;
-	proto.sz      = len - 8;
-	as_proto_swap(&proto);
-
-    memcpy(bb_r->buf, &proto, 8); 
-
 	uint32_t pos = *offset;
 
 	ASD_QUERY_SENDPACKET_STARTING(nodeid, pos, len);
 
 	int rv;
-	int retry = 0;
 	cf_detail(AS_PROTO," Start At %p %d %d", buf, pos, len);
 	while (pos < len) {
 		rv = cf_socket_send(&fd_h->sock, buf + pos, len - pos, MSG_NOSIGNAL);
@@ -903,14 +1214,14 @@ as_netio_send_packet(as_file_handle *fd_h, cf_buf_builder *bb_r, uint32_t *offse
 				cf_debug(AS_PROTO, "Packet send response error returned %d errno %d fd %d", rv, errno, CSFD(&fd_h->sock));
 				return AS_NETIO_IO_ERR;
 			}
-			if (!blocking && (retry > AS_NETIO_MAX_IO_RETRY)) {
+			if (!blocking) {
+				// Socket buffer is full - let the netio thread finish it
+				// when the socket becomes writable.
 				*offset = pos;
 				cf_detail(AS_PROTO," End At %p %d %d", buf, pos, len);
 				ASD_QUERY_SENDPACKET_CONTINUE(nodeid, pos);
 				return AS_NETIO_CONTINUE;
 			}
-			retry++;
-			// bigger packets so try few extra times 
 			usleep(100);
 		}
 		else {
@@ -921,19 +1232,149 @@ as_netio_send_packet(as_file_handle *fd_h, cf_buf_builder *bb_r, uint32_t *offse
 	return AS_NETIO_OK;
 }
 
+typedef struct netio_parked_s {
+	as_netio				io;
+	struct netio_parked_s	*prev;
+	struct netio_parked_s	*next;
+} netio_parked;
+
+typedef struct netio_ctx_s {
+	cf_poll			poll;
+	cf_queue		*retry_q;	// packets waiting for an earlier packet to go out
+	netio_parked	*parked;	// packets waiting for their socket to be writable
+} netio_ctx;
+
+static void
+netio_park(netio_ctx *ctx, const as_netio *io)
+{
+	netio_parked *p = cf_malloc(sizeof(netio_parked));
+
+	cf_assert(p, AS_PROTO, "allocation: %s", cf_strerror(errno));
+
+	p->io = *io;
+	p->prev = NULL;
+	p->next = ctx->parked;
+
+	if (ctx->parked) {
+		ctx->parked->prev = p;
+	}
+
+	ctx->parked = p;
+
+	// The socket also sits (disarmed) in a demarshal epoll set - adding it to
+	// a second set is fine.
+	cf_poll_add_socket(ctx->poll, &p->io.fd_h->sock, EPOLLOUT | EPOLLONESHOT,
+			p);
+}
+
+static void
+netio_unpark(netio_ctx *ctx, netio_parked *p, as_netio *io)
+{
+	cf_poll_delete_socket(ctx->poll, &p->io.fd_h->sock);
+
+	if (p->prev) {
+		p->prev->next = p->next;
+	}
+	else {
+		ctx->parked = p->next;
+	}
+
+	if (p->next) {
+		p->next->prev = p->prev;
+	}
+
+	*io = p->io;
+	cf_free(p);
+}
+
+static void
+netio_attempt(netio_ctx *ctx, as_netio *io)
+{
+	int ret = io->start_cb(io, io->seq);
+
+	if (ret == AS_NETIO_CONTINUE) {
+		cf_queue_push(ctx->retry_q, io);
+		return;
+	}
+
+	if (ret == AS_NETIO_OK) {
+		ret = as_netio_send_packet(io->fd_h, io->bb_r, &io->offset, false);
+
+		if (ret == AS_NETIO_CONTINUE) {
+			netio_park(ctx, io);
+			return;
+		}
+	}
+
+	io->finish_cb(io, ret);
+}
+
 void *
-as_netio_th(void *q_to_wait_on) {
-	cf_queue *           q = (cf_queue*)q_to_wait_on;
+as_netio_th(void *unused)
+{
+	netio_ctx ctx;
+
+	cf_poll_create(&ctx.poll);
+	ctx.retry_q = cf_queue_create(sizeof(as_netio), false);
+	ctx.parked = NULL;
+
+	if (!ctx.retry_q) {
+		cf_crash(AS_PROTO, "Failed to create netio retry queue");
+	}
+
 	while (true) {
+		bool idle = ! ctx.parked && cf_queue_sz(ctx.retry_q) == 0;
+		int wait = idle ? CF_QUEUE_FOREVER : CF_QUEUE_NOWAIT;
 		as_netio io;
-		if (cf_queue_pop(q, &io, CF_QUEUE_FOREVER) != 0) {
-			cf_crash(AS_PROTO, "Failed to pop from IO worker queue.");
+
+		// Take everything the workers handed over.
+		while (cf_queue_pop(g_netio_queue, &io, wait) == CF_QUEUE_OK) {
+			netio_attempt(&ctx, &io);
+			wait = CF_QUEUE_NOWAIT;
+		}
+
+		// Packets whose predecessor may have gone out since.
+		int n_retry = cf_queue_sz(ctx.retry_q);
+
+		for (int i = 0; i < n_retry; i++) {
+			if (cf_queue_pop(ctx.retry_q, &io, CF_QUEUE_NOWAIT) != CF_QUEUE_OK) {
+				break;
+			}
+
+			netio_attempt(&ctx, &io);
+		}
+
+		if (! ctx.parked && cf_queue_sz(ctx.retry_q) == 0) {
+			continue;
+		}
+
+		cf_poll_event events[NETIO_POLL_SZ];
+		int32_t n_events = cf_poll_wait(ctx.poll, events, NETIO_POLL_SZ,
+				g_config.proto_slow_netio_sleep_ms);
+
+		for (int32_t i = 0; i < n_events; i++) {
+			netio_unpark(&ctx, (netio_parked *)events[i].data, &io);
+			netio_attempt(&ctx, &io);
 		}
-		if (io.slow) {
-			usleep(g_config.proto_slow_netio_sleep_ms * 1000);
+
+		// A client that stops reading never makes its socket writable - don't
+		// let that hold up noticing the query was aborted.
+		netio_parked *p = ctx.parked;
+
+		while (p) {
+			netio_parked *next = p->next;
+			int ret = p->io.start_cb(&p->io, p->io.seq);
+
+			if (ret != AS_NETIO_OK && ret != AS_NETIO_CONTINUE) {
+				netio_unpark(&ctx, p, &io);
+				io.finish_cb(&io, ret);
+			}
+
+			p = next;
 		}
-		as_netio_send(&io, g_netio_slow_queue, false);
 	}
+
+	return NULL;
 }
 
 void 
@@ -942,26 +1383,20 @@ as_netio_init()
 	g_netio_queue = cf_queue_create(sizeof(as_netio), true);
 	if (!g_netio_queue)
 		cf_crash(AS_PROTO, "Failed to create netio queue");
-	if (pthread_create(&g_netio_th, NULL, as_netio_th, (void *)g_netio_queue))
+	if (pthread_create(&g_netio_th, NULL, as_netio_th, NULL))
 		cf_crash(AS_PROTO, "Failed to create netio thread");
-
-	g_netio_slow_queue = cf_queue_create(sizeof(as_netio), true);
-	if (!g_netio_slow_queue)
-		cf_crash(AS_PROTO, "Failed to create netio slow queue");
-	if (pthread_create(&g_netio_slow_th, NULL, as_netio_th, (void *)g_netio_slow_queue))
-		cf_crash(AS_PROTO, "Failed to create netio slow thread");
 }
 
 /*
- * Based on io object send buffer to the network, if fails
- * the queues it up to be picked by the asynchronous queueing
- * thread
+ * Based on io object send buffer to the network, if the socket can't take
+ * it all, hand it to the netio thread to finish asynchronously.
  *
  * vtable:
  *
  * start_cb: Callback to the module before the real IO is started.
  *           it returns the status 
  *           AS_NETIO_OK: Everythin ok go ahead with IO
+ *           AS_NETIO_CONTINUE: Not this packet's turn yet, try again later
  *           AS_NETIO_ERR: If there was issue like abort/err/timeout etc.
  *
  * finish_cb: Callback to the module with the status code of the IO call
@@ -983,14 +1418,12 @@ as_netio_init()
  *     this function consumes qtr reference. It calls finish_cb which releases
  *     ref to qtr
  *     In case of AS_NETIO_CONTINUE: This function also consumes bb_r and ref for 
- *     fd_h. The background thread is responsible for freeing up bb_r and release
+ *     fd_h. The netio thread is responsible for freeing up bb_r and release
  *     ref to fd_h.
  */
 int
-as_netio_send(as_netio *io, void *q_to_use, bool blocking)
+as_netio_send(as_netio *io, bool blocking)
 {
-	cf_queue *q = (cf_queue *)q_to_use;
-
 	int ret = io->start_cb(io, io->seq);
 
 	if (ret == AS_NETIO_OK) {
@@ -1002,13 +1435,7 @@ as_netio_send(as_netio *io, void *q_to_use, bool blocking)
     // If needs requeue then requeue it
 	switch (ret) {
 		case AS_NETIO_CONTINUE:
-			if (!q) {
-				cf_queue_push(g_netio_queue, io);
-	 		}
-			else {
-				io->slow = true;
-				cf_queue_push(q, io);
-			}
+			cf_queue_push(g_netio_queue, io);
 			break;
 		default:
             ret = AS_NETIO_OK;
@@ -36,6 +36,7 @@
 
 #include "arenax.h"
 #include "fault.h"
+#include "vmapx.h"
 
 #include "base/cfg.h"
 #include "base/datamodel.h"
@@ -139,12 +140,13 @@ as_record_clean_bins(as_storage_rd *rd)
 }
 
 void
-as_record_free_bin_space(as_record *r)
+as_record_free_bin_space(as_record *r, as_namespace *ns)
 {
 	as_bin_space *bin_space = as_index_get_bin_space(r);
 
 	if (bin_space) {
-		cf_free((void*)bin_space);
+		as_namespace_dim_free(ns, (void*)bin_space,
+				sizeof(as_bin_space) + (bin_space->n_bins * sizeof(as_bin)));
 		as_index_set_bin_space(r, NULL);
 	}
 }
@@ -169,10 +171,12 @@ as_record_destroy(as_record *r, as_namespace *ns)
 		as_record_clean_bins(&rd);
 
 		if (! ns->single_bin) {
-			as_record_free_bin_space(r);
+			as_record_free_bin_space(r, ns);
 
 			if (r->dim) {
-				cf_free(r->dim); // frees the key
+				// Frees the key.
+				as_namespace_dim_free(ns, r->dim, sizeof(as_rec_space) +
+						((as_rec_space*)r->dim)->key_size);
 			}
 		}
 	}
@@ -243,10 +247,11 @@ as_record_done(as_index_ref *r_ref, as_namespace *ns)
 // Called only for data-in-memory multi-bin, with no key currently stored.
 // Note - have to modify if/when other metadata joins key in as_rec_space.
 void
-as_record_allocate_key(as_record* r, const uint8_t* key, uint32_t key_size)
+as_record_allocate_key(as_record* r, const uint8_t* key, uint32_t key_size,
+		as_namespace* ns)
 {
 	as_rec_space* rec_space = (as_rec_space*)
-			cf_malloc_ns(sizeof(as_rec_space) + key_size);
+			as_namespace_dim_malloc(ns, sizeof(as_rec_space) + key_size);
 
 	rec_space->bin_space = (as_bin_space*)r->dim;
 	rec_space->key_size = key_size;
@@ -258,11 +263,12 @@ as_record_allocate_key(as_record* r, const uint8_t* key, uint32_t key_size)
 // Called only for data-in-memory multi-bin, with a key currently stored.
 // Note - have to modify if/when other metadata joins key in as_rec_space.
 void
-as_record_remove_key(as_record* r)
+as_record_remove_key(as_record* r, as_namespace* ns)
 {
 	as_bin_space* p_bin_space = ((as_rec_space*)r->dim)->bin_space;
 
-	cf_free(r->dim);
+	as_namespace_dim_free(ns, r->dim,
+			sizeof(as_rec_space) + ((as_rec_space*)r->dim)->key_size);
 	r->dim = (void*)p_bin_space;
 }
 
@@ -458,7 +464,7 @@ as_record_unpickle_replace(as_record *r, as_storage_rd *rd, uint8_t *buf, size_t
 	}
 	if (ret == 0) {
 		if (has_sindex && sbins_populated) {
-			sindex_ret = as_sindex_update_by_sbin(ns, set_name, sbins, sbins_populated, &rd->keyd);
+			sindex_ret = as_sindex_update_by_sbin(ns, set_name, sbins, sbins_populated, &rd->keyd, NULL);
 			if (sindex_ret != AS_SINDEX_OK) {
 				cf_warning(AS_RECORD, "Failed: %s", as_sindex_err_str(sindex_ret));
 			}
@@ -496,7 +502,7 @@ as_record_apply_properties(as_record *r, as_namespace *ns, const as_rec_props *p
 	if (! as_index_is_flag_set(r, AS_INDEX_FLAG_KEY_STORED)) {
 		if (result == 0) {
 			if (ns->storage_data_in_memory) {
-				as_record_allocate_key(r, key, key_size);
+				as_record_allocate_key(r, key, key_size, ns);
 			}
 
 			as_index_set_flags(r, AS_INDEX_FLAG_KEY_STORED);
@@ -505,7 +511,7 @@ as_record_apply_properties(as_record *r, as_namespace *ns, const as_rec_props *p
 	// If a key was stored, but we didn't get one, remove the key.
 	else if (result != 0) {
 		if (ns->storage_data_in_memory) {
-			as_record_remove_key(r);
+			as_record_remove_key(r, ns);
 		}
 
 		as_index_clear_flags(r, AS_INDEX_FLAG_KEY_STORED);
@@ -526,7 +532,7 @@ as_record_clear_properties(as_record *r, as_namespace *ns)
 	// If a key was stored, and we didn't get one, remove the key.
 	if (as_index_is_flag_set(r, AS_INDEX_FLAG_KEY_STORED)) {
 		if (ns->storage_data_in_memory) {
-			as_record_remove_key(r);
+			as_record_remove_key(r, ns);
 		}
 
 		as_index_clear_flags(r, AS_INDEX_FLAG_KEY_STORED);
@@ -848,3 +854,36 @@ as_record_is_expired(as_record *r)
 {
 	return r->void_time != 0 && r->void_time < as_record_void_time_get();
 }
+
+// Is the record older than its namespace's or set's truncate cutoff? Such
+// records are treated as deleted on access, and nsup deletes them lazily.
+bool
+as_record_is_truncated(as_record *r, as_namespace *ns)
+{
+	uint64_t lut = r->last_update_time;
+	uint64_t ns_truncate_lut = cf_atomic64_get(ns->truncate_lut);
+
+	if (ns_truncate_lut != 0 && lut <= ns_truncate_lut) {
+		return true;
+	}
+
+	uint16_t set_id = as_index_get_set_id(r);
+	as_set *p_set;
+
+	if (set_id == INVALID_SET_ID ||
+			cf_vmapx_get_by_index(ns->p_sets_vmap, set_id - 1,
+					(void**)&p_set) != CF_VMAPX_OK) {
+		return false;
+	}
+
+	uint64_t set_truncate_lut = cf_atomic64_get(p_set->truncate_lut);
+
+	return set_truncate_lut != 0 && lut <= set_truncate_lut;
+}
+
+// Expired or truncated - either way, treat as not found.
+bool
+as_record_is_doomed(as_record *r, as_namespace *ns)
+{
+	return as_record_is_expired(r) || as_record_is_truncated(r, ns);
+}
@@ -121,7 +121,7 @@ typedef struct scan_options_s {
 int get_scan_set_id(as_transaction* tr, as_namespace* ns, uint16_t* p_set_id);
 scan_type get_scan_type(as_transaction* tr);
 bool get_scan_options(as_transaction* tr, scan_options* options);
-size_t send_blocking_response_chunk(cf_socket *sock, uint8_t* buf, size_t size);
+size_t send_blocking_response_chunk(as_file_handle* fd_h, uint8_t* buf, size_t size);
 size_t send_blocking_response_fin(cf_socket *sock, int result_code);
 static inline bool excluded_set(as_index* r, uint16_t set_id);
 
@@ -324,8 +324,9 @@ get_scan_options(as_transaction* tr, scan_options* options)
 }
 
 size_t
-send_blocking_response_chunk(cf_socket *sock, uint8_t* buf, size_t size)
+send_blocking_response_chunk(as_file_handle* fd_h, uint8_t* buf, size_t size)
 {
+	cf_socket* sock = &fd_h->sock;
 	as_proto proto;
 
 	proto.version = PROTO_VERSION;
@@ -333,14 +334,31 @@ send_blocking_response_chunk(cf_socket *sock, uint8_t* buf, size_t size)
 	proto.sz = size;
 	as_proto_swap(&proto);
 
-	if (cf_socket_send_all(sock, (uint8_t*)&proto, sizeof(as_proto),
-			MSG_NOSIGNAL | MSG_MORE, CF_SOCKET_TIMEOUT) < 0) {
-		cf_warning(AS_SCAN, "send error - fd %d %s", CSFD(sock),
-				cf_strerror(errno));
-		return 0;
+	struct iovec iov[2] = {
+			{ .iov_base = &proto, .iov_len = sizeof(as_proto) },
+			{ .iov_base = buf, .iov_len = size }
+	};
+	size_t comp_sz;
+	uint8_t* comp = as_proto_compress_reply(fd_h, iov, 2, &comp_sz);
+
+	if (comp) {
+		int rv = cf_socket_send_all(sock, comp, comp_sz, MSG_NOSIGNAL,
+				CF_SOCKET_TIMEOUT);
+
+		cf_free(comp);
+
+		if (rv < 0) {
+			cf_warning(AS_SCAN, "send error - fd %d sz %zu %s", CSFD(sock),
+					comp_sz, cf_strerror(errno));
+			return 0;
+		}
+
+		return comp_sz;
 	}
 
-	if (cf_socket_send_all(sock, buf, size, MSG_NOSIGNAL,
+	// Header and chunk in one send - one syscall, and one TLS record for
+	// smaller chunks.
+	if (cf_socket_send_iov_all(sock, iov, 2, MSG_NOSIGNAL,
 			CF_SOCKET_TIMEOUT) < 0) {
 		cf_warning(AS_SCAN, "send error - fd %d sz %lu %s", CSFD(sock),
 				size, cf_strerror(errno));
@@ -472,7 +490,7 @@ conn_scan_job_send_response(conn_scan_job* job, uint8_t* buf, size_t size)
 		return false;
 	}
 
-	size_t size_sent = send_blocking_response_chunk(&job->fd_h->sock, buf,
+	size_t size_sent = send_blocking_response_chunk(job->fd_h, buf,
 			size);
 
 	if (size_sent == 0) {
@@ -730,7 +748,7 @@ basic_scan_job_reduce_cb(as_index_ref* r_ref, void* udata)
 
 	as_index *r = r_ref->r;
 
-	if (excluded_set(r, _job->set_id) || as_record_is_expired(r)) {
+	if (excluded_set(r, _job->set_id) || as_record_is_doomed(r, ns)) {
 		as_record_done(r_ref, ns);
 		return;
 	}
@@ -1066,7 +1084,7 @@ aggr_scan_job_reduce_cb(as_index_ref* r_ref, void* udata)
 
 	as_index* r = r_ref->r;
 
-	if (excluded_set(r, _job->set_id) || as_record_is_expired(r)) {
+	if (excluded_set(r, _job->set_id) || as_record_is_doomed(r, ns)) {
 		as_record_done(r_ref, ns);
 		return;
 	}
@@ -1350,7 +1368,7 @@ udf_bg_scan_job_reduce_cb(as_index_ref* r_ref, void* udata)
 
 	as_index* r = r_ref->r;
 
-	if (excluded_set(r, _job->set_id) || as_record_is_expired(r)) {
+	if (excluded_set(r, _job->set_id) || as_record_is_doomed(r, ns)) {
 		as_record_done(r_ref, ns);
 		return;
 	}
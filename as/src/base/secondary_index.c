@@ -48,7 +48,7 @@
  *
  * BOOT INDEX
  *
- * as_sindex_boot_populateall --> If fast restart or data in memory and load at start up --> as_sbld_build_all
+ * as_sindex_boot_populateall --> If fast restart or data not loaded by cold start --> as_sbld_build_all
  *
  * SBIN creation
  *
@@ -393,6 +393,7 @@ as_sindex_config_var_default(as_sindex_config_var *si_cfg)
 	si_cfg->defrag_max_units     = from_si.config.defrag_max_units;
 	// related non config value defaults
 	si_cfg->ignore_not_sync_flag = from_si.config.flag;
+	si_cfg->covering_hash_sz     = AS_SINDEX_COVERING_HASH_SZ;
 }
 
 /*
@@ -1162,6 +1163,7 @@ as_sindex__stats_clear(as_sindex *si) {
 	s->lookup_response_size = 0;
 	s->lookup_num_records   = 0;
 	s->lookup_errs          = 0;
+	s->lookup_covered       = 0;
 
 	si->enable_histogram = false;
 	if (s->_write_hist) {
@@ -1335,6 +1337,7 @@ as_sindex_stats_str(as_namespace *ns, char * iname, cf_dyn_buf *db)
 	info_append_uint64(db, "query_lookups", lkup);
 	info_append_uint64(db, "query_lookup_avg_rec_count", lkup ? lkup_rec / lkup : 0);
 	info_append_uint64(db, "query_lookup_avg_record_size", lkup_rec ? lkup_size / lkup_rec : 0);
+	info_append_uint64(db, "query_lookup_covered", cf_atomic64_get(si->stats.lookup_covered));
 
 	//CONFIG
 	info_append_uint64(db, "gc-period", si->config.defrag_period);
@@ -1342,6 +1345,7 @@ as_sindex_stats_str(as_namespace *ns, char * iname, cf_dyn_buf *db)
 
 	info_append_bool(db, "histogram", si->enable_histogram);
 	info_append_bool(db, "ignore-not-sync", (si->config.flag & AS_SINDEX_CONFIG_IGNORE_ON_DESYNC) != 0);
+	info_append_bool(db, "covering", si->covering_hash != NULL);
 
 	cf_dyn_buf_chomp(db);
 
@@ -1637,6 +1641,198 @@ as_sindex_release_arr(as_sindex *si_arr[], int si_arr_sz)
 //                                    END - SI REFERENCE
 // ************************************************************************************************
 // ************************************************************************************************
+//                                          COVERING
+// A covering sindex keeps, next to the btree, the indexed value of each record
+// stamped with the record's last-update-time and generation. Queries projecting
+// only the indexed bin use it to skip the device read when the stamp still
+// matches the record in the primary index - anything else falls back to a read.
+
+#define AS_SINDEX_COVERING_ENTRY_SZ (sizeof(cf_digest) + sizeof(as_sindex_covering_entry))
+
+static inline uint32_t
+as_sindex__covering_hash_fn(void* p_key)
+{
+	return *(uint32_t *)((cf_digest *)p_key)->digest;
+}
+
+static int
+as_sindex__covering_delete_reduce_fn(void *key, void *data, void *udata)
+{
+	return SHASH_REDUCE_DELETE;
+}
+
+// Only plain integer bins can be covered - the stored value is then the bin.
+static void
+as_sindex__covering_create(as_sindex *si, uint32_t n_buckets)
+{
+	as_sindex_metadata *imd = si->imd;
+
+	if (imd->btype != AS_SINDEX_KTYPE_LONG || imd->itype != AS_SINDEX_ITYPE_DEFAULT
+			|| imd->path_length != 0 || si->ns->single_bin) {
+		cf_warning(AS_SINDEX, "Index %s is not a plain integer bin index, covering ignored",
+				imd->iname);
+		return;
+	}
+
+	if (SHASH_OK != shash_create(&si->covering_hash, as_sindex__covering_hash_fn,
+			sizeof(cf_digest), sizeof(as_sindex_covering_entry),
+			n_buckets, SHASH_CR_MT_MANYLOCK)) {
+		cf_warning(AS_SINDEX, "Couldn't create covering hash for index %s", imd->iname);
+		si->covering_hash = NULL;
+	}
+}
+
+static void
+as_sindex__covering_clear(as_sindex *si)
+{
+	uint32_t n_entries = shash_get_size(si->covering_hash);
+
+	shash_reduce_delete(si->covering_hash, as_sindex__covering_delete_reduce_fn, NULL);
+	cf_atomic64_sub(&si->ns->n_bytes_sindex_memory,
+			(int64_t)n_entries * AS_SINDEX_COVERING_ENTRY_SZ);
+}
+
+static void
+as_sindex__covering_destroy(as_sindex *si)
+{
+	if (! si->covering_hash) {
+		return;
+	}
+
+	as_sindex__covering_clear(si);
+	shash_destroy(si->covering_hash);
+	si->covering_hash = NULL;
+}
+
+static void
+as_sindex__covering_put(as_sindex *si, cf_digest *keyd, as_record *r, int64_t value)
+{
+	as_sindex_covering_entry *e;
+	pthread_mutex_t *vlock;
+
+	if (SHASH_OK == shash_get_vlock(si->covering_hash, keyd, (void **)&e, &vlock)) {
+		e->last_update_time = r->last_update_time;
+		e->value            = value;
+		e->generation       = r->generation;
+		pthread_mutex_unlock(vlock);
+		return;
+	}
+
+	as_sindex_covering_entry new_e = {
+		.last_update_time = r->last_update_time,
+		.value            = value,
+		.generation       = r->generation
+	};
+
+	if (SHASH_OK == shash_put_unique(si->covering_hash, keyd, &new_e)) {
+		cf_atomic64_add(&si->ns->n_bytes_sindex_memory, AS_SINDEX_COVERING_ENTRY_SZ);
+	}
+}
+
+static void
+as_sindex__covering_invalidate(as_sindex *si, cf_digest *keyd)
+{
+	if (SHASH_OK == shash_delete(si->covering_hash, keyd)) {
+		cf_atomic64_sub(&si->ns->n_bytes_sindex_memory, AS_SINDEX_COVERING_ENTRY_SZ);
+	}
+}
+
+// Queries call this when the record behind a digest is gone from the primary
+// index, so entries of deleted, expired, evicted or truncated records don't
+// have to wait for sindex gc.
+void
+as_sindex_covering_drop(as_sindex *si, cf_digest *keyd)
+{
+	if (si->covering_hash) {
+		as_sindex__covering_invalidate(si, keyd);
+	}
+}
+
+// Remove the entry only if it still holds this value - a stale sindex entry
+// being dropped must not invalidate the record's current value.
+void
+as_sindex_covering_delete(as_sindex *si, cf_digest *keyd, int64_t value)
+{
+	if (! si->covering_hash) {
+		return;
+	}
+
+	as_sindex_covering_entry *e;
+	pthread_mutex_t *vlock;
+
+	if (SHASH_OK != shash_get_vlock(si->covering_hash, keyd, (void **)&e, &vlock)) {
+		return;
+	}
+
+	bool matches = e->value == value;
+
+	if (matches) {
+		shash_delete_lockfree(si->covering_hash, keyd);
+	}
+
+	pthread_mutex_unlock(vlock);
+
+	if (matches) {
+		cf_atomic64_sub(&si->ns->n_bytes_sindex_memory, AS_SINDEX_COVERING_ENTRY_SZ);
+	}
+}
+
+// Inserts stamp the entry with the record's final metadata when the caller
+// has it (r non-NULL), otherwise the entry is dropped until the next write.
+static void
+as_sindex__covering_update(as_sindex *si, as_sindex_op op, cf_digest *keyd, int64_t value,
+		as_record *r)
+{
+	if (op == AS_SINDEX_OP_DELETE) {
+		as_sindex_covering_delete(si, keyd, value);
+	}
+	else if (r) {
+		as_sindex__covering_put(si, keyd, r, value);
+	}
+	else {
+		as_sindex__covering_invalidate(si, keyd);
+	}
+}
+
+// Caller holds the record lock. Returns true and the indexed value if the
+// entry was stamped by the record's current version.
+bool
+as_sindex_covering_get(as_sindex *si, cf_digest *keyd, as_record *r, int64_t *value)
+{
+	if (! si->covering_hash) {
+		return false;
+	}
+
+	as_sindex_covering_entry *e;
+	pthread_mutex_t *vlock;
+
+	if (SHASH_OK != shash_get_vlock(si->covering_hash, keyd, (void **)&e, &vlock)) {
+		return false;
+	}
+
+	// An entry stamped by an older version can never match again - only the
+	// next write of the indexed bin re-stamps it - so drop it now.
+	bool current = e->last_update_time == r->last_update_time &&
+			e->generation == r->generation;
+
+	if (current) {
+		*value = e->value;
+	}
+	else {
+		shash_delete_lockfree(si->covering_hash, keyd);
+	}
+
+	pthread_mutex_unlock(vlock);
+
+	if (! current) {
+		cf_atomic64_sub(&si->ns->n_bytes_sindex_memory, AS_SINDEX_COVERING_ENTRY_SZ);
+	}
+
+	return current;
+}
+//                                        END - COVERING
+// ************************************************************************************************
+// ************************************************************************************************
 //                                          SINDEX CREATE
 // simatch is index in sindex array
 // nptr is index of pimd in imd
@@ -1836,6 +2032,9 @@ as_sindex_create(as_namespace *ns, as_sindex_metadata *imd, bool user_create)
 				// delete the old hash entry
 				cf_info(AS_SINDEX,"Found custom configuration for SI:%s, applying", imd->iname);
 				as_sindex_config_var_copy(si, &check_si_conf);
+				if (check_si_conf.covering) {
+					as_sindex__covering_create(si, check_si_conf.covering_hash_sz);
+				}
 				shash_delete(ns->sindex_cfg_var_hash,  (void *)iname);
 				check_si_conf.conf_valid_flag = true;
 				shash_put_unique(ns->sindex_cfg_var_hash, (void *)iname, (void *)&check_si_conf);
@@ -1918,6 +2117,7 @@ as_sindex_destroy_pmetadata(as_sindex *si)
 		pthread_rwlock_destroy(&pimd->slock);
 	}
 	as_sindex__destroy_histogram(si);
+	as_sindex__covering_destroy(si);
 	cf_free(si->imd->pimd);
 	si->imd->pimd = NULL;
 }
@@ -1994,6 +2194,9 @@ as_sindex_empty_index(as_sindex_metadata * imd)
 	}
 	cf_atomic64_add(&imd->si->ns->n_bytes_sindex_memory,
 			ai_btree_get_isize(imd));
+	if (imd->si->covering_hash) {
+		as_sindex__covering_clear(imd->si);
+	}
 	as_sindex_clear_stats_on_empty_index(imd->si);
 }
 
@@ -2030,11 +2233,22 @@ as_sindex_populate_done(as_sindex *si)
 	SINDEX_UNLOCK(&si->imd->slock);
 	return ret;
 }
+/*
+ * Returns true if the namespace's secondary indexes must be populated by a
+ * namespace scan at boot. Cold start populates them upfront - as records are
+ * added if data is in memory, else by a device sweep after the index is loaded.
+ */
+static bool
+as_sindex_boot_needs_scan(as_namespace *ns)
+{
+	return !ns->cold_start
+			|| (!ns->storage_data_in_memory && !ns->cold_start_sindex_loaded);
+}
+
 /*
  * Client API to start namespace scan to populate secondary index. The scan
- * is only performed in the namespace is warm start or if its data is not in
- * memory and data is loaded from. For cold start with data in memory the indexes
- * are populate upfront.
+ * is only performed if the namespace is warm start, or if cold start did not
+ * populate the indexes (see as_sindex_boot_needs_scan()).
  *
  * This call is only made at the boot time.
  */
@@ -2057,9 +2271,8 @@ as_sindex_boot_populateall()
 		}
 
 		// If FAST START
-		// OR (Data not in memory AND COLD START)
-		if (!ns->cold_start
-			|| (!ns->storage_data_in_memory)) {
+		// OR (Data not in memory AND COLD START didn't load sindexes)
+		if (as_sindex_boot_needs_scan(ns)) {
 			// reserve all sindexes
 			as_sindex_populator_reserve_all(ns);
 			as_sbld_build_all(ns);
@@ -2082,9 +2295,7 @@ as_sindex_boot_populateall()
 			continue;
 		}
 
-		// If FAST START
-		// OR (Data not in memory AND COLD START)
-		if (!ns->cold_start || (!ns->storage_data_in_memory)) {
+		if (as_sindex_boot_needs_scan(ns)) {
 			as_sindex_populator_release_all(ns);
 		}
 	}
@@ -3034,7 +3245,8 @@ as_sindex_sbin_freeall(as_sindex_bin *sbin, int numbins)
 }
 
 as_sindex_status
-as_sindex__op_by_sbin(as_namespace *ns, const char *set, int numbins, as_sindex_bin *start_sbin, cf_digest * pkey)
+as_sindex__op_by_sbin(as_namespace *ns, const char *set, int numbins, as_sindex_bin *start_sbin, cf_digest * pkey,
+		as_record *r)
 {
 	// If numbins == 0 return AS_SINDEX_OK
 	// Iterate through sbins
@@ -3129,6 +3341,11 @@ as_sindex__op_by_sbin(as_namespace *ns, const char *set, int numbins, as_sindex_
 	//			Release the pimd lock
 			SINDEX_UNLOCK(&pimd->slock);
 			as_sindex__process_ret(si, ret, op, starttime, __LINE__);
+
+	//			Keep the covering entry in step with the btree
+			if (si->covering_hash && sbin->type == AS_PARTICLE_TYPE_INTEGER) {
+				as_sindex__covering_update(si, op, pkey, *(int64_t *)skey, r);
+			}
 		}
 		cf_debug(AS_SINDEX, " Secondary Index Op Finish------------- ");
 
@@ -4234,7 +4451,8 @@ as_sindex_sbins_from_rd(as_storage_rd *rd, uint16_t from_bin, uint16_t to_bin, a
 
 // Needs comments
 int
-as_sindex_update_by_sbin(as_namespace *ns, const char *set, as_sindex_bin *start_sbin, int num_sbins, cf_digest * pkey)
+as_sindex_update_by_sbin(as_namespace *ns, const char *set, as_sindex_bin *start_sbin, int num_sbins, cf_digest * pkey,
+		as_record *r)
 {
 	cf_debug(AS_SINDEX, "as_sindex_update_by_sbin");
 
@@ -4244,12 +4462,12 @@ as_sindex_update_by_sbin(as_namespace *ns, const char *set, as_sindex_bin *start
 	int sindex_ret = AS_SINDEX_OK;
 	for (int i=0; i<num_sbins; i++) {
 		if (start_sbin[i].op == AS_SINDEX_OP_DELETE) {
-			sindex_ret = as_sindex__op_by_sbin(ns, set, 1, &start_sbin[i], pkey);
+			sindex_ret = as_sindex__op_by_sbin(ns, set, 1, &start_sbin[i], pkey, r);
 		}
 	}
 	for (int i=0; i<num_sbins; i++) {
 		if (start_sbin[i].op == AS_SINDEX_OP_INSERT) {
-			sindex_ret = as_sindex__op_by_sbin(ns, set, 1, &start_sbin[i], pkey);
+			sindex_ret = as_sindex__op_by_sbin(ns, set, 1, &start_sbin[i], pkey, r);
 		}
 	}
 	return sindex_ret;
@@ -4338,7 +4556,7 @@ as_sindex_put_rd(as_sindex *si, as_storage_rd *rd)
 	}
 
 	if (sbins_populated) {
-		as_sindex_update_by_sbin(rd->ns, setname, sbins, sbins_populated, &rd->keyd);
+		as_sindex_update_by_sbin(rd->ns, setname, sbins, sbins_populated, &rd->keyd, rd->r);
 		as_sindex_sbin_freeall(sbins, sbins_populated);
 	}
 
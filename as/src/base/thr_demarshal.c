@@ -40,6 +40,7 @@
 #include "citrusleaf/cf_queue.h"
 
 #include "fault.h"
+#include "hardware.h"
 #include "hist.h"
 #include "socket.h"
 #include "tls.h"
@@ -48,6 +49,7 @@
 #include "base/batch.h"
 #include "base/cfg.h"
 #include "base/packet_compression.h"
+#include "base/profile.h"
 #include "base/proto.h"
 #include "base/security.h"
 #include "base/stats.h"
@@ -65,6 +67,7 @@ extern void *thr_demarshal(void *arg);
 
 typedef struct {
 	cf_poll			polls[MAX_DEMARSHAL_THREADS];
+	cf_sockets		*socks[MAX_DEMARSHAL_THREADS]; // listening sockets, if thread accepts
 	unsigned int	num_threads;
 	pthread_t	dm_th[MAX_DEMARSHAL_THREADS];
 } demarshal_args;
@@ -82,6 +85,14 @@ cf_serv_cfg g_service_bind = { .n_cfgs = 0 };
 
 static cf_sockets g_sockets;
 
+// With service-reuse-port, threads other than the first get their own
+// listening sockets on the same addresses.
+static cf_sockets g_reuse_port_sockets[MAX_DEMARSHAL_THREADS - 1];
+
+// Each header read grabs up to this much, so small requests arrive with their
+// header in one recv() call.
+#define DEMARSHAL_RECV_BUF_SZ (16 * 1024)
+
 //
 // File handle reaper.
 //
@@ -100,9 +111,18 @@ thr_demarshal_rearm(as_file_handle *fd_h)
 	// This causes ENOENT, when we reached NextEvent_FD_Cleanup (e.g, because
 	// the client disconnected) while the transaction was still ongoing.
 
+	// If the client pipelined requests and we already hold the bytes, the
+	// socket may never become readable again - ask for EPOLLOUT too, which
+	// fires as soon as there's send buffer space, i.e. right away.
+	uint32_t events = EPOLLIN | EPOLLONESHOT | EPOLLRDHUP;
+
+	if (fd_h->pending_sz != 0) {
+		events |= EPOLLOUT;
+	}
+
 	static int32_t err_ok[] = { ENOENT };
 	CF_IGNORE_ERROR(cf_poll_modify_socket_forgiving(fd_h->poll, &fd_h->sock,
-			EPOLLIN | EPOLLONESHOT | EPOLLRDHUP, fd_h,
+			events, fd_h,
 			sizeof(err_ok) / sizeof(int32_t), err_ok));
 }
 
@@ -359,13 +379,15 @@ thr_demarshal_config_xdr(cf_socket *sock)
 // processing. Note that once fd is assigned to a thread all the work on that fd
 // is done by that thread. Fair fd usage is expected of the client. First thread
 // is special - also does accept [listens for new connections]. It is the only
-// thread which does it.
+// thread which does it, unless service-reuse-port is set - then every thread
+// accepts on its own listening sockets and keeps what it accepts.
 void *
 thr_demarshal(void *unused)
 {
 	cf_poll poll;
 	int nevents, i;
 	cf_clock last_fd_print = 0;
+	uint8_t recv_buf[DEMARSHAL_RECV_BUF_SZ];
 
 #if defined(USE_SYSTEMTAP)
 	uint64_t nodeid = g_config.self_node;
@@ -384,14 +406,21 @@ thr_demarshal(void *unused)
 		return(0);
 	}
 
+	if (g_config.service_pin_threads) {
+		cf_topo_pin_to_cpu((cf_topo_cpu_index)(thr_id % cf_topo_count_cpus()));
+	}
+
 	cf_poll_create(&poll);
 
-	// First thread accepts new connection at interface socket.
-	if (thr_id == 0) {
-		demarshal_file_handle_init();
+	// Accepting threads listen for new connections at interface sockets.
+	cf_sockets *socks = g_demarshal_args->socks[thr_id];
 
-		cf_poll_add_sockets(poll, &g_sockets, EPOLLIN | EPOLLERR | EPOLLHUP);
-		cf_socket_show_server(AS_DEMARSHAL, "client", &g_sockets);
+	if (socks) {
+		cf_poll_add_sockets(poll, socks, EPOLLIN | EPOLLERR | EPOLLHUP);
+
+		if (thr_id == 0) {
+			cf_socket_show_server(AS_DEMARSHAL, "client", socks);
+		}
 	}
 
 	g_demarshal_args->polls[thr_id] = poll;
@@ -415,7 +444,7 @@ thr_demarshal(void *unused)
 		for (i = 0; i < nevents; i++) {
 			cf_socket *ssock = events[i].data;
 
-			if (cf_sockets_has_socket(&g_sockets, ssock)) {
+			if (socks && cf_sockets_has_socket(socks, ssock)) {
 				// Accept new connections on the service socket.
 				cf_socket csock;
 				cf_sock_addr sa;
@@ -479,6 +508,11 @@ thr_demarshal(void *unused)
 				fd_h->reap_me = false;
 				fd_h->proto = 0;
 				fd_h->proto_unread = (uint64_t)sizeof(as_proto);
+				fd_h->pending = NULL;
+				fd_h->pending_sz = 0;
+				fd_h->out = NULL;
+				fd_h->out_sz = 0;
+				fd_h->riders = NULL;
 				fd_h->fh_info = 0;
 				fd_h->security_filter = as_security_filter_create();
 
@@ -510,9 +544,12 @@ thr_demarshal(void *unused)
 					cf_rc_free(fd_h); // will free even with ref-count of 2
 				}
 				else {
-					// Round-robin pick up demarshal thread epoll_fd and add
-					// this new connection to epoll.
-					int id = (id_cntr++) % g_demarshal_args->num_threads;
+					// With SO_REUSEPORT the kernel already spread connections
+					// across threads - keep this one. Otherwise round-robin
+					// pick up demarshal thread epoll_fd and add this new
+					// connection to epoll.
+					int id = g_config.service_reuse_port ?
+							thr_id : (id_cntr++) % g_demarshal_args->num_threads;
 					fd_h->poll = g_demarshal_args->polls[id];
 
 					// Place the client socket in the event queue.
@@ -544,22 +581,45 @@ thr_demarshal(void *unused)
 				// If pointer is NULL, then we need to create a transaction and
 				// store it in the buffer.
 				if (fd_h->proto == NULL) {
-					int32_t recv_sz = cf_socket_recv(sock, (uint8_t *)&fd_h->proto_hdr + sizeof(as_proto) - fd_h->proto_unread,	fd_h->proto_unread, 0);
-
-					if (recv_sz <= 0) {
-						if (recv_sz != 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-							// This can happen because TLS protocol
-							// overhead can trip the epoll but no
-							// application-level bytes are actually
-							// available yet.
-							thr_demarshal_rearm(fd_h);
-							goto NextEvent;
+					int32_t recv_sz;
+
+					if (fd_h->pending_sz != 0) {
+						// Left over from the previous read - the client
+						// pipelined requests.
+						recv_sz = (int32_t)fd_h->pending_sz;
+						memcpy(recv_buf, fd_h->pending, fd_h->pending_sz);
+						cf_free(fd_h->pending);
+						fd_h->pending = NULL;
+						fd_h->pending_sz = 0;
+					}
+					else {
+						// Read as much as is available - header and, for
+						// small requests, the whole body in one call.
+						recv_sz = cf_socket_recv(sock, recv_buf, sizeof(recv_buf), 0);
+
+						if (recv_sz <= 0) {
+							if (recv_sz != 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+								// This can happen because TLS protocol
+								// overhead can trip the epoll but no
+								// application-level bytes are actually
+								// available yet.
+								thr_demarshal_rearm(fd_h);
+								goto NextEvent;
+							}
+							cf_detail(AS_DEMARSHAL, "proto socket: read header fail: error: rv %d errno %d", recv_sz, errno);
+							goto NextEvent_FD_Cleanup;
 						}
-						cf_detail(AS_DEMARSHAL, "proto socket: read header fail: error: rv %d errno %d", recv_sz, errno);
-						goto NextEvent_FD_Cleanup;
 					}
 
-					fd_h->proto_unread -= recv_sz;
+					uint8_t *buf = recv_buf;
+					uint32_t buf_sz = (uint32_t)recv_sz;
+					uint32_t hdr_sz = buf_sz < fd_h->proto_unread ?
+							buf_sz : (uint32_t)fd_h->proto_unread;
+
+					memcpy((uint8_t *)&fd_h->proto_hdr + sizeof(as_proto) - fd_h->proto_unread, buf, hdr_sz);
+					buf += hdr_sz;
+					buf_sz -= hdr_sz;
+					fd_h->proto_unread -= hdr_sz;
 
 					if (fd_h->proto_unread != 0) {
 						thr_demarshal_rearm(fd_h);
@@ -604,6 +664,24 @@ thr_demarshal(void *unused)
 					memcpy(fd_h->proto, &fd_h->proto_hdr, sizeof(as_proto));
 
 					fd_h->proto_unread = fd_h->proto->sz;
+
+					// Consume whatever part of the body came with the header.
+					uint32_t body_sz = buf_sz < fd_h->proto_unread ?
+							buf_sz : (uint32_t)fd_h->proto_unread;
+
+					memcpy(fd_h->proto->data, buf, body_sz);
+					buf += body_sz;
+					buf_sz -= body_sz;
+					fd_h->proto_unread -= body_sz;
+
+					// Anything beyond this request belongs to the next one(s).
+					// Keep it until this transaction ends and we're rearmed.
+					if (buf_sz != 0) {
+						fd_h->pending = cf_malloc(buf_sz);
+						cf_assert(fd_h->pending, AS_DEMARSHAL, "allocation: %u %s", buf_sz, cf_strerror(errno));
+						memcpy(fd_h->pending, buf, buf_sz);
+						fd_h->pending_sz = buf_sz;
+					}
 				}
 
 				if (fd_h->proto_unread != 0) {
@@ -641,6 +719,13 @@ thr_demarshal(void *unused)
 				cf_rc_reserve(fd_h);
 				has_extra_ref = true;
 
+				// Info, security and batch replies are written directly to
+				// the socket - send any replies held for earlier requests.
+				if (proto_p->type != PROTO_TYPE_AS_MSG ||
+						(((cl_msg *)proto_p)->msg.info1 & AS_MSG_INFO1_BATCH) != 0) {
+					as_msg_flush_replies(fd_h);
+				}
+
 				// Info protocol requests.
 				if (proto_p->type == PROTO_TYPE_INFO) {
 					as_info_transaction it = { fd_h, proto_p, now_ns };
@@ -694,6 +779,10 @@ thr_demarshal(void *unused)
 						as_transaction_demarshal_error(&tr, AS_PROTO_RESULT_FAIL_UNKNOWN);
 						goto NextEvent;
 					}
+
+					// The client compresses, so it can take compressed
+					// replies - see proto-compress-threshold.
+					fd_h->fh_info |= FH_INFO_COMPRESS;
 				}
 
 				// If it's an XDR connection and we haven't yet modified the connection settings, ...
@@ -735,6 +824,11 @@ thr_demarshal(void *unused)
 
 				ASD_TRANS_DEMARSHAL(nodeid, (uint64_t) tr.msgp, as_transaction_trid(&tr));
 
+				if (g_config.profile_sample_rate != 0) {
+					as_profile_sample(&tr);
+					AS_PROFILE_MARK((&tr), AS_PROFILE_DEMARSHAL);
+				}
+
 				// Directly process or queue the transaction.
 				if (g_config.n_namespaces_in_memory != 0 &&
 						(g_config.n_namespaces_not_in_memory == 0 ||
@@ -839,9 +933,27 @@ as_demarshal_start()
 
 	as_xdr_info_port(&g_service_bind);
 
-	if (cf_socket_init_server(&g_service_bind, &g_sockets) < 0) {
-		cf_crash(AS_DEMARSHAL, "Couldn't initialize service socket");
+	if (g_config.service_reuse_port) {
+		for (int32_t i = 0; i < dm->num_threads; ++i) {
+			cf_sockets *socks = i == 0 ? &g_sockets : &g_reuse_port_sockets[i - 1];
+
+			if (cf_socket_init_server_reuse_port(&g_service_bind, socks) < 0) {
+				cf_crash(AS_DEMARSHAL, "Couldn't initialize service socket");
+			}
+
+			dm->socks[i] = socks;
+		}
 	}
+	else {
+		if (cf_socket_init_server(&g_service_bind, &g_sockets) < 0) {
+			cf_crash(AS_DEMARSHAL, "Couldn't initialize service socket");
+		}
+
+		dm->socks[0] = &g_sockets;
+	}
+
+	// Before any thread can accept.
+	demarshal_file_handle_init();
 
 	// Create all the epoll_fds and wait for all the threads to come up.
 
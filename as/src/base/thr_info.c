@@ -60,6 +60,7 @@
 #include "base/index.h"
 #include "base/ldt.h"
 #include "base/monitor.h"
+#include "base/profile.h"
 #include "base/scan.h"
 #include "base/thr_batch.h"
 #include "base/thr_demarshal.h"
@@ -328,6 +329,7 @@ info_get_stats(char *name, cf_dyn_buf *db)
 	info_append_uint64(db, "batch_index_huge_buffers", g_stats.batch_index_huge_buffers);
 	info_append_uint64(db, "batch_index_created_buffers", g_stats.batch_index_created_buffers);
 	info_append_uint64(db, "batch_index_destroyed_buffers", g_stats.batch_index_destroyed_buffers);
+	info_append_uint64(db, "batch_index_steals", g_stats.batch_index_steals);
 
 	info_append_uint64(db, "batch_initiate", g_stats.batch_initiate);
 	info_append_int(db, "batch_queue", as_batch_direct_queue_size());
@@ -375,6 +377,14 @@ info_get_stats(char *name, cf_dyn_buf *db)
 cf_atomic32	 g_node_info_generation = 0;
 
 
+int
+info_get_profile(char *name, cf_dyn_buf *db)
+{
+	as_profile_get_info(db);
+
+	return 0;
+}
+
 int
 info_get_cluster_generation(char *name, cf_dyn_buf *db)
 {
@@ -1018,6 +1028,98 @@ info_command_dump_wb_summary(char *name, char *params, cf_dyn_buf *db)
 	return(0);
 }
 
+int
+info_command_trim_index(char *name, char *params, cf_dyn_buf *db)
+{
+	as_namespace *ns;
+	char param_str[100];
+	int param_str_len = sizeof(param_str);
+
+	/*
+	 *  Command Format:  "trim-index:ns=<Namespace>"
+	 *
+	 *  where <Namespace> is the name of an existing namespace.
+	 */
+	param_str[0] = '\0';
+	if (!as_info_parameter_get(params, "ns", param_str, &param_str_len)) {
+		if (!(ns = as_namespace_get_byname(param_str))) {
+			cf_warning(AS_INFO, "The \"%s:\" command argument \"ns\" value must be the name of an existing namespace, not \"%s\"", name, param_str);
+			cf_dyn_buf_append_string(db, "error");
+			return(0);
+		}
+	} else {
+		cf_warning(AS_INFO, "The \"%s:\" command requires an argument of the form \"ns=<Namespace>\"", name);
+		cf_dyn_buf_append_string(db, "error");
+		return 0;
+	}
+
+	uint32_t n_released = cf_arenax_trim(ns->arena);
+
+	cf_info(AS_INFO, "{%s} index trim released %u arena stage(s)", ns->name, n_released);
+
+	cf_dyn_buf_append_string(db, "ok");
+
+	return(0);
+}
+
+int
+info_command_truncate(char *name, char *params, cf_dyn_buf *db)
+{
+	as_namespace *ns;
+	char param_str[100];
+	int param_str_len = sizeof(param_str);
+
+	/*
+	 *  Command Format:  "truncate:ns=<Namespace>{;set=<Set>}{;lut=<LUT>}"
+	 *
+	 *  where <Namespace> is the name of an existing namespace, <Set> is the
+	 *  name of an existing set in it (if omitted, the whole namespace is
+	 *  truncated), and <LUT> is a last-update-time cutoff in milliseconds
+	 *  since the Citrusleaf epoch (if omitted, now).
+	 */
+	param_str[0] = '\0';
+	if (!as_info_parameter_get(params, "ns", param_str, &param_str_len)) {
+		if (!(ns = as_namespace_get_byname(param_str))) {
+			cf_warning(AS_INFO, "The \"%s:\" command argument \"ns\" value must be the name of an existing namespace, not \"%s\"", name, param_str);
+			cf_dyn_buf_append_string(db, "error");
+			return(0);
+		}
+	} else {
+		cf_warning(AS_INFO, "The \"%s:\" command requires an argument of the form \"ns=<Namespace>\"", name);
+		cf_dyn_buf_append_string(db, "error");
+		return 0;
+	}
+
+	char set_name[AS_SET_NAME_MAX_SIZE];
+	int set_name_len = sizeof(set_name);
+	int set_rv = as_info_parameter_get(params, "set", set_name, &set_name_len);
+
+	if (set_rv == -2) {
+		cf_warning(AS_INFO, "The \"%s:\" command argument \"set\" value is too long", name);
+		cf_dyn_buf_append_string(db, "error");
+		return(0);
+	}
+
+	uint64_t lut = 0;
+	param_str_len = sizeof(param_str);
+	if (!as_info_parameter_get(params, "lut", param_str, &param_str_len)) {
+		if (0 != cf_str_atoi_u64(param_str, &lut) || lut == 0) {
+			cf_warning(AS_INFO, "The \"%s:\" command argument \"lut\" value must be a positive integer, not \"%s\"", name, param_str);
+			cf_dyn_buf_append_string(db, "error");
+			return(0);
+		}
+	}
+
+	if (as_namespace_truncate(ns, set_rv == 0 ? set_name : NULL, lut) != 0) {
+		cf_dyn_buf_append_string(db, "error");
+		return(0);
+	}
+
+	cf_dyn_buf_append_string(db, "ok");
+
+	return(0);
+}
+
 int
 info_command_dump_rw_request_hash(char *name, char *params, cf_dyn_buf *db)
 {
@@ -1866,6 +1968,9 @@ info_service_config_get(cf_dyn_buf *db)
 	info_append_uint32(db, "paxos-single-replica-limit", g_config.paxos_single_replica_limit);
 	info_append_string_safe(db, "pidfile", g_config.pidfile);
 	info_append_int(db, "service-threads", g_config.n_service_threads);
+	info_append_bool(db, "service-reuse-port", g_config.service_reuse_port);
+	info_append_bool(db, "service-pin-threads", g_config.service_pin_threads);
+	info_append_string(db, "auto-pin", g_config.auto_pin == CF_TOPO_AUTO_PIN_NUMA ? "numa" : "none");
 	info_append_uint32(db, "transaction-queues", g_config.n_transaction_queues);
 	info_append_uint32(db, "transaction-threads-per-queue", g_config.n_transaction_threads_per_queue);
 	info_append_int(db, "proto-fd-max", g_config.n_proto_fd_max);
@@ -1911,6 +2016,8 @@ info_service_config_get(cf_dyn_buf *db)
 			(AS_PAXOS_RECOVERY_POLICY_AUTO_RESET_MASTER == g_config.paxos_recovery_policy ? "auto-reset-master" : "undefined"));
 
 	info_append_uint32(db, "paxos-retransmit-period", g_config.paxos_retransmit_period);
+	info_append_bool(db, "proto-coalesce-replies", g_config.proto_coalesce_replies);
+	info_append_uint32(db, "proto-compress-threshold", g_config.proto_compress_threshold);
 	info_append_int(db, "proto-fd-idle-ms", g_config.proto_fd_idle_ms);
 	info_append_int(db, "proto-slow-netio-sleep-ms", g_config.proto_slow_netio_sleep_ms); // dynamic only
 	info_append_uint32(db, "query-batch-size", g_config.query_bsize);
@@ -1930,6 +2037,7 @@ info_service_config_get(cf_dyn_buf *db)
 	info_append_uint32(db, "query-threshold", g_config.query_threshold);
 	info_append_uint64(db, "query-untracked-time-ms", g_config.query_untracked_time_ms);
 	info_append_uint32(db, "query-worker-threads", g_config.query_worker_threads);
+	info_append_uint32(db, "profile-sample-rate", g_config.profile_sample_rate);
 	info_append_bool(db, "respond-client-on-master-completion", g_config.respond_client_on_master_completion);
 	info_append_bool(db, "run-as-daemon", g_config.run_as_daemon);
 	info_append_uint32(db, "scan-max-active", g_config.scan_max_active);
@@ -1940,6 +2048,7 @@ info_service_config_get(cf_dyn_buf *db)
 
 	info_append_bool(db, "sindex-gc-enable-histogram", g_config.sindex_gc_enable_histogram); // dynamic only
 	info_append_uint32(db, "ticker-interval", g_config.ticker_interval);
+	info_append_bool(db, "transaction-combine-increments", g_config.transaction_combine_increments);
 	info_append_int(db, "transaction-max-ms", (int)(g_config.transaction_max_ns / 1000000));
 	info_append_uint32(db, "transaction-pending-limit", g_config.transaction_pending_limit);
 	info_append_bool(db, "transaction-repeatable-read", g_config.transaction_repeatable_read);
@@ -1954,6 +2063,7 @@ info_service_config_get(cf_dyn_buf *db)
 	info_append_int(db, "max-msgs-per-type", (int)g_config.max_msgs_per_type);
 #ifdef MEM_COUNT
 	info_append_bool(db, "memory-accounting", g_config.memory_accounting);
+	info_append_uint32(db, "memory-accounting-sample-rate", g_config.memory_accounting_sample_rate);
 #endif
 	info_append_uint32(db, "prole-extra-ttl", g_config.prole_extra_ttl);
 	info_append_bool(db, "non-master-sets-delete", g_config.non_master_sets_delete); // dynamic only
@@ -2063,11 +2173,14 @@ info_namespace_config_get(char* context, cf_dyn_buf *db)
 	info_append_bool(db, "enable-benchmarks-udf", ns->udf_benchmarks_enabled);
 	info_append_bool(db, "enable-benchmarks-udf-sub", ns->udf_sub_benchmarks_enabled);
 	info_append_bool(db, "enable-benchmarks-write", ns->write_benchmarks_enabled);
+	info_append_bool(db, "enable-bin-slab", ns->bin_slab_enabled);
 	info_append_bool(db, "enable-hist-proxy", ns->proxy_hist_enabled);
 	info_append_uint32(db, "evict-hist-buckets", ns->evict_hist_buckets);
 	info_append_uint32(db, "evict-tenths-pct", ns->evict_tenths_pct);
 	info_append_int(db, "high-water-disk-pct", (int)(ns->hwm_disk * 100));
 	info_append_int(db, "high-water-memory-pct", (int)(ns->hwm_memory * 100));
+	info_append_string_safe(db, "index-file", ns->index_file);
+	info_append_bool(db, "index-on-device", ns->index_on_device);
 	info_append_bool(db, "ldt-enabled", ns->ldt_enabled);
 	info_append_uint32(db, "ldt-gc-rate", ns->ldt_gc_sleep_us / 1000000);
 	info_append_uint32(db, "ldt-page-size", ns->ldt_page_size);
@@ -2303,6 +2416,18 @@ info_command_config_set_threadsafe(char *name, char *params, cf_dyn_buf *db)
 			cf_info(AS_INFO, "Changing value of transaction-retry-ms from %"PRIu64" to %d ", (g_config.transaction_max_ns / 1000000), val);
 			g_config.transaction_max_ns = (uint64_t)val * 1000000;
 		}
+		else if (0 == as_info_parameter_get(params, "transaction-combine-increments", context, &context_len)) {
+			if (strncmp(context, "true", 4) == 0 || strncmp(context, "yes", 3) == 0) {
+				cf_info(AS_INFO, "Changing value of transaction-combine-increments from %s to %s", bool_val[g_config.transaction_combine_increments], context);
+				g_config.transaction_combine_increments = true;
+			}
+			else if (strncmp(context, "false", 5) == 0 || strncmp(context, "no", 2) == 0) {
+				cf_info(AS_INFO, "Changing value of transaction-combine-increments from %s to %s", bool_val[g_config.transaction_combine_increments], context);
+				g_config.transaction_combine_increments = false;
+			}
+			else
+				goto Error;
+		}
 		else if (0 == as_info_parameter_get(params, "transaction-pending-limit", context, &context_len)) {
 			if (0 != cf_str_atoi(context, &val))
 				goto Error;
@@ -2418,6 +2543,24 @@ info_command_config_set_threadsafe(char *name, char *params, cf_dyn_buf *db)
 			cf_info(AS_INFO, "Changing value of proto-fd-max from %d to %d ", g_config.n_proto_fd_max, val);
 			g_config.n_proto_fd_max = val;
 		}
+		else if (0 == as_info_parameter_get(params, "proto-coalesce-replies", context, &context_len)) {
+			if (strncmp(context, "true", 4) == 0 || strncmp(context, "yes", 3) == 0) {
+				cf_info(AS_INFO, "Changing value of proto-coalesce-replies from %s to %s", bool_val[g_config.proto_coalesce_replies], context);
+				g_config.proto_coalesce_replies = true;
+			}
+			else if (strncmp(context, "false", 5) == 0 || strncmp(context, "no", 2) == 0) {
+				cf_info(AS_INFO, "Changing value of proto-coalesce-replies from %s to %s", bool_val[g_config.proto_coalesce_replies], context);
+				g_config.proto_coalesce_replies = false;
+			}
+			else
+				goto Error;
+		}
+		else if (0 == as_info_parameter_get(params, "proto-compress-threshold", context, &context_len)) {
+			if (0 != cf_str_atoi(context, &val) || val < 0)
+				goto Error;
+			cf_info(AS_INFO, "Changing value of proto-compress-threshold from %u to %d ", g_config.proto_compress_threshold, val);
+			g_config.proto_compress_threshold = (uint32_t)val;
+		}
 		else if (0 == as_info_parameter_get(params, "proto-fd-idle-ms", context, &context_len)) {
 			if (0 != cf_str_atoi(context, &val))
 				goto Error;
@@ -2507,6 +2650,12 @@ info_command_config_set_threadsafe(char *name, char *params, cf_dyn_buf *db)
 			else
 				goto Error;
 		}
+		else if (0 == as_info_parameter_get(params, "profile-sample-rate", context, &context_len)) {
+			if (0 != cf_str_atoi(context, &val) || val < 0)
+				goto Error;
+			cf_info(AS_INFO, "Changing value of profile-sample-rate from %u to %d ", g_config.profile_sample_rate, val);
+			g_config.profile_sample_rate = (uint32_t)val;
+		}
 		else if (0 == as_info_parameter_get(params, "respond-client-on-master-completion", context, &context_len)) {
 			if (strncmp(context, "true", 4) == 0 || strncmp(context, "yes", 3) == 0) {
 				cf_info(AS_INFO, "Changing value of respond-client-on-master-completion from %s to %s", bool_val[g_config.respond_client_on_master_completion], context);
@@ -2559,6 +2708,14 @@ info_command_config_set_threadsafe(char *name, char *params, cf_dyn_buf *db)
 			else
 				goto Error;
 		}
+		else if (0 == as_info_parameter_get(params, "memory-accounting-sample-rate", context, &context_len)) {
+			if (0 != cf_str_atoi(context, &val) || val < 1 || val > 1000000) {
+				goto Error;
+			}
+			cf_info(AS_INFO, "Changing value of memory-accounting-sample-rate from %u to %d ", g_config.memory_accounting_sample_rate, val);
+			g_config.memory_accounting_sample_rate = (uint32_t)val;
+			mem_count_set_sample_rate(g_config.memory_accounting_sample_rate);
+		}
 #endif
 		else if (0 == as_info_parameter_get(params, "query-buf-size", context, &context_len)) {
 			uint64_t val = atoll(context);
@@ -5834,6 +5991,8 @@ info_get_namespace_info(as_namespace *ns, cf_dyn_buf *db)
 	info_append_uint64(db, "expired_objects", ns->n_expired_objects);
 	info_append_uint64(db, "evicted_objects", ns->n_evicted_objects);
 	info_append_uint64(db, "set_deleted_objects", ns->n_deleted_set_objects);
+	info_append_uint64(db, "truncated_objects", ns->n_truncated_objects);
+	info_append_uint64(db, "truncate_lut", ns->truncate_lut);
 	info_append_uint64(db, "evict_ttl", ns->evict_ttl);
 	info_append_uint32(db, "nsup_cycle_duration", ns->nsup_cycle_duration);
 	info_append_uint32(db, "nsup_cycle_sleep_pct", ns->nsup_cycle_sleep_pct);
@@ -5841,7 +6000,8 @@ info_get_namespace_info(as_namespace *ns, cf_dyn_buf *db)
 	// Memory usage stats.
 
 	uint64_t data_memory = ns->n_bytes_memory;
-	uint64_t index_memory = as_index_size_get(ns) * (ns->n_objects + ns->n_sub_objects + ns->n_tombstones);
+	uint64_t index_bytes = as_index_size_get(ns) * (ns->n_objects + ns->n_sub_objects + ns->n_tombstones);
+	uint64_t index_memory = ns->index_on_device ? 0 : index_bytes;
 	uint64_t sindex_memory = ns->n_bytes_sindex_memory;
 	uint64_t used_memory = data_memory + index_memory + sindex_memory;
 
@@ -5855,6 +6015,19 @@ info_get_namespace_info(as_namespace *ns, cf_dyn_buf *db)
 
 	info_append_uint64(db, "memory_free_pct", free_pct);
 
+	if (ns->index_on_device) {
+		info_append_uint64(db, "index_device_used_bytes", index_bytes);
+	}
+
+	// Bin slab stats - pages never shrink, so pages minus used is what
+	// fragmentation costs.
+
+	if (ns->bin_slab) {
+		info_append_uint64(db, "bin_slab_page_bytes", cf_slab_page_bytes(ns->bin_slab));
+		info_append_uint64(db, "bin_slab_used_bytes", cf_slab_used_bytes(ns->bin_slab));
+		info_append_uint64(db, "bin_slab_heap_bytes", cf_slab_heap_bytes(ns->bin_slab));
+	}
+
 	// Persistent memory block keys' namespace ID (enterprise only).
 	info_append_uint32(db, "xmem_id", ns->xmem_id);
 
@@ -6059,6 +6232,7 @@ info_get_namespace_info(as_namespace *ns, cf_dyn_buf *db)
 	// Special non-error counters:
 
 	info_append_uint64(db, "deleted_last_bin", ns->n_deleted_last_bin);
+	info_append_uint64(db, "hot_key_combined", ns->n_hot_key_combined);
 
 	// LDT stats.
 
@@ -7058,6 +7232,7 @@ as_info_init()
 	as_info_set_dynamic("peers-generation", info_get_services_generation, false);     // Returns the generation of the peers-*-* services lists.
 	as_info_set_dynamic("peers-tls-alt", info_get_services_tls_alt, false);           // Supersedes "services-alternate" for TLS, alternate addresses.
 	as_info_set_dynamic("peers-tls-std", info_get_services_tls_std, false);           // Supersedes "services" for TLS, standard addresses.
+	as_info_set_dynamic("profile", info_get_profile, false);                          // Returns hot path phase timings of transactions sampled per profile-sample-rate.
 	as_info_set_dynamic("replicas-all", info_get_replicas_all, false);                // Base 64 encoded binary representation of partitions this node is replica for.
 	as_info_set_dynamic("replicas-master", info_get_replicas_master, false);          // Base 64 encoded binary representation of partitions this node is master (replica) for.
 	as_info_set_dynamic("replicas-prole", info_get_replicas_prole, false);            // Base 64 encoded binary representation of partitions this node is prole (replica) for.
@@ -7128,6 +7303,8 @@ as_info_init()
 	as_info_set_command("throughput", info_command_hist_track, PERM_NONE);                    // Returns throughput info.
 	as_info_set_command("tip", info_command_tip, PERM_SERVICE_CTRL);                          // Add external IP to mesh-mode heartbeats.
 	as_info_set_command("tip-clear", info_command_tip_clear, PERM_SERVICE_CTRL);              // Clear tip list from mesh-mode heartbeats.
+	as_info_set_command("trim-index", info_command_trim_index, PERM_SERVICE_CTRL);            // Release trailing index arena stages with nothing allocated.
+	as_info_set_command("truncate", info_command_truncate, PERM_SET_CONFIG);                  // Truncate a namespace or set - older records are deleted lazily.
 	as_info_set_command("xdr-command", as_info_command_xdr, PERM_SERVICE_CTRL);               // Command to XDR module.
 
 	// SINDEX
@@ -736,9 +736,28 @@ add_to_ttl_histograms(as_namespace* ns, as_index* r)
 	}
 }
 
+//------------------------------------------------
+// Truncated records are already invisible - each
+// nsup lap's first reduce deletes them for real.
+// Returns true if the record was queued for delete.
+//
+static bool
+delete_if_truncated(as_namespace* ns, as_index* r, uint32_t* p_num_truncated)
+{
+	if (! as_record_is_truncated(r, ns)) {
+		return false;
+	}
+
+	queue_for_delete(ns, &r->key);
+	(*p_num_truncated)++;
+
+	return true;
+}
+
 //------------------------------------------------
 // Reduce callback deletes sets.
 // - does set deletion
+// - does truncation
 // - does expiration
 // - builds object size & TTL histograms
 // - counts 0-void-time records
@@ -748,6 +767,7 @@ typedef struct sets_delete_info_s {
 	uint32_t		now;
 	bool*			sets_deleting;
 	uint32_t		num_deleted;
+	uint32_t		num_truncated;
 	uint32_t		num_expired;
 	uint32_t		num_0_void_time;
 } sets_delete_info;
@@ -768,6 +788,11 @@ sets_delete_reduce_cb(as_index_ref* r_ref, void* udata)
 		return;
 	}
 
+	if (delete_if_truncated(ns, r, &p_info->num_truncated)) {
+		as_record_done(r_ref, ns);
+		return;
+	}
+
 	uint32_t void_time = r->void_time;
 
 	if (void_time != 0) {
@@ -790,12 +815,14 @@ sets_delete_reduce_cb(as_index_ref* r_ref, void* udata)
 
 //------------------------------------------------
 // Reduce callback prepares for eviction.
+// - does truncation
 // - builds object size, eviction & TTL histograms
 // - counts 0-void-time records
 //
 typedef struct evict_prep_info_s {
 	as_namespace*	ns;
 	bool*			sets_not_evicting;
+	uint32_t		num_truncated;
 	uint32_t		num_0_void_time;
 } evict_prep_info;
 
@@ -808,6 +835,11 @@ evict_prep_reduce_cb(as_index_ref* r_ref, void* udata)
 	uint32_t set_id = as_index_get_set_id(r);
 	uint32_t void_time = r->void_time;
 
+	if (delete_if_truncated(ns, r, &p_info->num_truncated)) {
+		as_record_done(r_ref, ns);
+		return;
+	}
+
 	add_to_obj_size_histograms(ns, r);
 
 	if (void_time != 0) {
@@ -864,6 +896,7 @@ evict_reduce_cb(as_index_ref* r_ref, void* udata)
 
 //------------------------------------------------
 // Reduce callback expires records.
+// - does truncation
 // - does expiration
 // - builds object size & TTL histograms
 // - counts 0-void-time records
@@ -871,6 +904,7 @@ evict_reduce_cb(as_index_ref* r_ref, void* udata)
 typedef struct expire_info_s {
 	as_namespace*	ns;
 	uint32_t		now;
+	uint32_t		num_truncated;
 	uint32_t		num_expired;
 	uint32_t		num_0_void_time;
 } expire_info;
@@ -883,6 +917,11 @@ expire_reduce_cb(as_index_ref* r_ref, void* udata)
 	as_namespace* ns = p_info->ns;
 	uint32_t void_time = r->void_time;
 
+	if (delete_if_truncated(ns, r, &p_info->num_truncated)) {
+		as_record_done(r_ref, ns);
+		return;
+	}
+
 	if (void_time != 0) {
 		if (p_info->now > void_time) {
 			queue_for_delete(ns, &r->key);
@@ -1065,7 +1104,7 @@ get_threshold(as_namespace* ns, uint32_t* p_evict_void_time)
 static void
 update_stats(as_namespace* ns, uint32_t n_master, uint32_t n_0_void_time,
 		uint32_t n_expired_records, uint32_t n_evicted_records, uint32_t n_deleted_set_records,
-		uint32_t evict_ttl, uint32_t n_set_waits, uint32_t n_clear_waits, uint32_t n_general_waits,
+		uint32_t n_truncated_records, uint32_t evict_ttl, uint32_t n_set_waits, uint32_t n_clear_waits, uint32_t n_general_waits,
 		uint64_t start_ms)
 {
 	if (n_expired_records != 0) {
@@ -1081,6 +1120,10 @@ update_stats(as_namespace* ns, uint32_t n_master, uint32_t n_0_void_time,
 		cf_atomic64_add(&ns->n_deleted_set_objects, n_deleted_set_records);
 	}
 
+	if (n_truncated_records != 0) {
+		cf_atomic64_add(&ns->n_truncated_objects, n_truncated_records);
+	}
+
 	ns->non_expirable_objects = n_0_void_time;
 
 	uint64_t total_duration_ms = cf_getms() - start_ms;
@@ -1090,11 +1133,12 @@ update_stats(as_namespace* ns, uint32_t n_master, uint32_t n_0_void_time,
 
 	cf_info(AS_NSUP, "{%s} Records: %u, %u 0-vt, "
 			"%u(%"PRIu64") expired, %u(%"PRIu64") evicted, "
-			"%u(%"PRIu64") set deletes. "
+			"%u(%"PRIu64") set deletes, %u(%"PRIu64") truncated. "
 			"Evict ttl: %d. Waits: %u,%u,%u. Total time: %"PRIu64" ms",
 			ns->name, n_master, n_0_void_time,
 			n_expired_records, ns->n_expired_objects, n_evicted_records, ns->n_evicted_objects,
 			n_deleted_set_records, ns->n_deleted_set_objects,
+			n_truncated_records, ns->n_truncated_objects,
 			evict_ttl, n_set_waits, n_clear_waits, n_general_waits, total_duration_ms);
 }
 
@@ -1182,6 +1226,7 @@ thr_nsup(void *arg)
 			uint32_t n_expired_records = 0;
 			uint32_t n_0_void_time_records = 0;
 			uint32_t n_deleted_set_records = 0;
+			uint32_t n_truncated_records = 0;
 			uint32_t n_set_waits = 0;
 
 			uint32_t num_sets = cf_vmapx_count(ns->p_sets_vmap);
@@ -1242,6 +1287,7 @@ thr_nsup(void *arg)
 				reduce_master_partitions(ns, sets_delete_reduce_cb, &cb_info, &n_set_waits, "sets-delete");
 
 				n_deleted_set_records = cb_info.num_deleted;
+				n_truncated_records = cb_info.num_truncated;
 				n_expired_records = cb_info.num_expired;
 				n_0_void_time_records = cb_info.num_0_void_time;
 			}
@@ -1294,6 +1340,7 @@ thr_nsup(void *arg)
 				// general eviction threshold.
 				reduce_master_partitions(ns, evict_prep_reduce_cb, &cb_info1, &n_general_waits, "evict-prep");
 
+				n_truncated_records += cb_info1.num_truncated;
 				n_0_void_time_records = cb_info1.num_0_void_time;
 
 				evict_info cb_info2;
@@ -1344,6 +1391,7 @@ thr_nsup(void *arg)
 				// Reduce master partitions, deleting expired records.
 				reduce_master_partitions(ns, expire_reduce_cb, &cb_info, &n_general_waits, "expire");
 
+				n_truncated_records = cb_info.num_truncated;
 				n_expired_records = cb_info.num_expired;
 				n_0_void_time_records = cb_info.num_0_void_time;
 			}
@@ -1364,7 +1412,7 @@ thr_nsup(void *arg)
 
 			update_stats(ns, linear_hist_get_total(ns->ttl_hist) + n_0_void_time_records, n_0_void_time_records,
 					n_expired_records, n_evicted_records, n_deleted_set_records,
-					evict_ttl, n_set_waits, n_clear_waits, n_general_waits,
+					n_truncated_records, evict_ttl, n_set_waits, n_clear_waits, n_general_waits,
 					start_ms);
 
 			// Delete non-master records from set(s) being deleted.
@@ -174,6 +174,7 @@ typedef struct as_query_transaction_s {
 	as_sindex_range        * srange;
 	query_type               job_type;  // Job type [LOOKUP/AGG/UDF]
 	cf_vector              * binlist;
+	bool                     covering;  // Projection is just the covered indexed bin
 	as_file_handle         * fd_h;      // ref counted nonetheless
 	/************************** Run Time Data *********************************/
 	bool                     blocking;
@@ -482,6 +483,9 @@ bb_poolrequest()
 		cf_warning(AS_QUERY, "Failed to find response buffer in the pool%d", rv);
 		return NULL;
 	}
+	// Clear the header - as_netio_send_packet() uses it to tell a packet it
+	// already prepared (and maybe compressed) from a new one.
+	memset(bb_r->buf, 0, sizeof(as_proto));
 	return bb_r;
 };
 // **************************************************************************************************
@@ -987,7 +991,7 @@ query_netio(as_query_transaction *qtr)
 	io.seq         = cf_atomic32_incr(&qtr->netio_push_seq);
 	io.start_time  = cf_getns();
 
-	int ret        = as_netio_send(&io, NULL, qtr->blocking);
+	int ret        = as_netio_send(&io, qtr->blocking);
 	qtr->bb_r      = bb_poolrequest();
    	cf_buf_builder_reserve(&qtr->bb_r, 8, NULL);
 
@@ -1559,6 +1563,32 @@ query_record_matches(as_query_transaction *qtr, as_storage_rd *rd, as_sindex_key
 
 
 
+/*
+ * Builds the response for a record from the covering map instead of storage -
+ * the only projected bin is the indexed one, whose value is known.
+ */
+static int
+query_add_covered_response(as_query_transaction *qtr, as_index_ref *r_ref,
+		cf_digest *dig, int64_t value)
+{
+	as_bin bin;
+
+	bin.particle = (as_particle *)value;
+	as_bin_state_set_from_type(&bin, AS_PARTICLE_TYPE_INTEGER);
+	bin.id = (uint16_t)qtr->si->imd->binid;
+
+	as_storage_rd rd;
+
+	memset(&rd, 0, sizeof(as_storage_rd));
+	rd.r      = r_ref->r;
+	rd.ns     = qtr->ns;
+	rd.bins   = &bin;
+	rd.n_bins = 1;
+	rd.keyd   = *dig;
+
+	return query_add_response(qtr, r_ref, &rd);
+}
+
 static int
 query_io(as_query_transaction *qtr, cf_digest *dig, as_sindex_key * skey)
 {
@@ -1589,14 +1619,50 @@ query_io(as_query_transaction *qtr, cf_digest *dig, as_sindex_key * skey)
 	if (rec_rv == 0) {
 		as_index *r = r_ref.r;
 		// check to see this isn't an expired record waiting to die
-		if (as_record_is_expired(r)) {
+		if (as_record_is_doomed(r, ns)) {
 			as_record_done(&r_ref, ns);
 			cf_debug(AS_QUERY,
 					"build_response: record expired. treat as not found");
+
+			if (qtr->covering) {
+				as_sindex_covering_drop(qtr->si, dig);
+			}
+
 			// Not sending error message to client as per the agreement
 			// that server will never send a error result code to the query client.
 			goto CLEANUP;
 		}
+
+		// Covering sindex - if the entry was stamped by this version of the
+		// record it holds the bin's current value, no need to go to storage.
+		// Stored keys still need a read to be returned.
+		int64_t covered_value;
+
+		if (qtr->covering && ! as_index_is_flag_set(r, AS_INDEX_FLAG_KEY_STORED)
+				&& as_sindex_covering_get(qtr->si, dig, r, &covered_value)) {
+			if ((int64_t)skey->key.int_key != covered_value) {
+				as_record_done(&r_ref, ns);
+				query_release_partition(qtr, rsv);
+				cf_atomic64_incr(&g_stats.query_false_positives);
+				ASD_QUERY_IO_NOTMATCH(nodeid, qtr->trid);
+				return AS_QUERY_OK;
+			}
+
+			int ret = query_add_covered_response(qtr, &r_ref, dig, covered_value);
+
+			as_record_done(&r_ref, ns);
+
+			if (ret != 0) {
+				qtr_set_err(qtr, AS_PROTO_RESULT_FAIL_QUERY_CBERROR, __FILE__, __LINE__);
+				query_release_partition(qtr, rsv);
+				ASD_QUERY_IO_ERROR(nodeid, qtr->trid);
+				return AS_QUERY_ERR;
+			}
+
+			cf_atomic64_incr(&qtr->si->stats.lookup_covered);
+			goto CLEANUP;
+		}
+
 		// make sure it's brought in from storage if necessary
 		as_storage_rd rd;
 		as_storage_record_open(ns, r, &rd, &r->key);
@@ -1640,6 +1706,11 @@ query_io(as_query_transaction *qtr, cf_digest *dig, as_sindex_key * skey)
 		cf_detail(AS_QUERY, "query_generator: "
 				"as_record_get returned %d : key %"PRIx64, rec_rv,
 				*(uint64_t *)dig);
+
+		// Record is gone - don't keep its covering entry until sindex gc.
+		if (qtr->covering) {
+			as_sindex_covering_drop(qtr->si, dig);
+		}
 	}
 CLEANUP :
 	query_release_partition(qtr, rsv);
@@ -1898,6 +1969,35 @@ Cleanup:
 
 
 
+/*
+ * Function query_flush_response
+ *
+ * Notes -
+ *	Sends out whatever results are buffered so far, so long running queries
+ *	stream each batch to the client as soon as its I/O is done, instead of
+ *	waiting for the response buffer to fill up.
+ *
+ * Synchronization -
+ * 		Takes a lock over qtr->buf
+ */
+static void
+query_flush_response(as_query_transaction *qtr)
+{
+	pthread_mutex_lock(&qtr->buf_mutex);
+	// Buffer starts with 8 bytes reserved for the proto header
+	if (qtr->bb_r && qtr->bb_r->used_sz > 8) {
+		query_netio(qtr);
+	}
+	pthread_mutex_unlock(&qtr->buf_mutex);
+}
+
+/*
+ * Function query_process_ioreq
+ *
+ * Notes -
+ *	Reads the records of a batch and adds them to the response. Long running
+ *	queries flush the response at the end of each batch.
+ */
 static int
 query_process_ioreq(query_work *qio)
 {
@@ -1953,6 +2053,12 @@ query_process_ioreq(query_work *qio)
 		}
 		as_index_keys_release_arr_to_queue(keys_arr);
 	}
+
+	// Short running queries are done inline - the fin carries their results.
+	if (!qtr->short_running && !qtr_failed(qtr)) {
+		query_flush_response(qtr);
+	}
+
 Cleanup:
 
 	if (iter) {
@@ -2671,6 +2777,23 @@ query_setup_fd(as_query_transaction *qtr, as_transaction *tr)
 			break;
 	}
 }
+
+// A lookup can be served from a covering sindex only if the client asked for
+// nothing but the indexed bin.
+static bool
+query_binlist_is_covered(as_sindex *si, cf_vector *binlist)
+{
+	if (! si->covering_hash || ! binlist || cf_vector_size(binlist) != 1) {
+		return false;
+	}
+
+	char binname[AS_ID_BIN_SZ];
+
+	cf_vector_get(binlist, 0, (void*)&binname);
+
+	return strcmp(binname, si->imd->bname) == 0;
+}
+
 /*
  * Phase I query setup which happens just before query is queued for generator
  * Populates valid qtrp in case of success and NULL in case of failure.
@@ -2825,6 +2948,8 @@ query_setup(as_transaction *tr, as_namespace *ns, as_query_transaction **qtrp)
 	qtr->si                  = si;
 	qtr->srange              = srange;
 	qtr->binlist             = binlist;
+	qtr->covering            = qtr->job_type == QUERY_TYPE_LOOKUP &&
+									query_binlist_is_covered(si, binlist);
 	qtr->start_time          = start_time;
 	qtr->end_time            = tr->end_time;
 	qtr->rsv                 = NULL;
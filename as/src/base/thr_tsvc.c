@@ -45,6 +45,7 @@
 
 #include "base/cfg.h"
 #include "base/datamodel.h"
+#include "base/profile.h"
 #include "base/proto.h"
 #include "base/scan.h"
 #include "base/secondary_index.h"
@@ -235,6 +236,11 @@ as_tsvc_process_transaction(as_transaction *tr)
 	//
 
 	if (as_transaction_is_multi_record(tr)) {
+		// Scans, queries and old batch write to the socket directly.
+		if (tr->origin == FROM_CLIENT) {
+			as_msg_flush_replies(tr->from.proto_fd_h);
+		}
+
 		if (m->transaction_ttl != 0) {
 			// Old batch and queries may specify transaction_ttl, but don't use
 			// g_config.transaction_max_ns as a default. Assuming specified TTL
@@ -559,6 +565,10 @@ run_tsvc(void *arg)
 					tr.benchmark_time);
 		}
 
+		if (! as_transaction_is_restart(&tr)) {
+			AS_PROFILE_MARK((&tr), AS_PROFILE_QUEUE_WAIT);
+		}
+
 		as_tsvc_process_transaction(&tr);
 	}
 
@@ -188,7 +188,7 @@ log_ticker_frame(uint64_t delta_time)
 		uint64_t n_sub_objects = ns->n_sub_objects;
 		uint64_t n_tombstones = ns->n_tombstones;
 
-		size_t index_mem = as_index_size_get(ns) *
+		size_t index_mem = ns->index_on_device ? 0 : as_index_size_get(ns) *
 				(n_objects + n_sub_objects + n_tombstones);
 		size_t sindex_mem = ns->n_bytes_sindex_memory;
 		size_t data_mem = ns->n_bytes_memory;
@@ -743,6 +743,10 @@ dump_global_histograms()
 		histogram_dump(g_stats.batch_index_hist);
 	}
 
+	if (g_stats.batch_index_small_hist_active) {
+		histogram_dump(g_stats.batch_index_small_hist);
+	}
+
 	if (g_config.info_hist_enabled) {
 		histogram_dump(g_stats.info_hist);
 	}
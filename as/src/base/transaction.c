@@ -470,6 +470,18 @@ as_release_file_handle(as_file_handle *proto_fd_h)
 		}
 	}
 
+	if (proto_fd_h->out) {
+		cf_free(proto_fd_h->out);
+		proto_fd_h->out = NULL;
+		proto_fd_h->out_sz = 0;
+	}
+
+	if (proto_fd_h->pending) {
+		cf_free(proto_fd_h->pending);
+		proto_fd_h->pending = NULL;
+		proto_fd_h->pending_sz = 0;
+	}
+
 	if (proto_fd_h->security_filter) {
 		as_security_filter_destroy(proto_fd_h->security_filter);
 		proto_fd_h->security_filter = NULL;
@@ -482,6 +494,12 @@ as_release_file_handle(as_file_handle *proto_fd_h)
 void
 as_end_of_transaction(as_file_handle *proto_fd_h, bool force_close)
 {
+	// Paranoia - every reply path should have taken care of these.
+	if (proto_fd_h->riders) {
+		cf_warning(AS_PROTO, "end of transaction with combined writes unanswered");
+		as_msg_reply_riders(proto_fd_h, AS_PROTO_RESULT_FAIL_UNKNOWN, 0, 0);
+	}
+
 	thr_demarshal_rearm(proto_fd_h);
 
 	if (force_close) {
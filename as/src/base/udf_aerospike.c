@@ -136,7 +136,7 @@ udf_aerospike_delbin(udf_record * urecord, const char * bname)
 		if (has_sindex) {
 			if (sbins_populated > 0) {	
 				tr->flags |= AS_TRANSACTION_FLAG_SINDEX_TOUCHED;
-				as_sindex_update_by_sbin(rd->ns, as_index_get_set_name(rd->r, rd->ns), sbins, sbins_populated, &rd->keyd);
+				as_sindex_update_by_sbin(rd->ns, as_index_get_set_name(rd->r, rd->ns), sbins, sbins_populated, &rd->keyd, NULL);
 			}
 		}
 		as_bin_destroy(rd, i);
@@ -343,7 +343,7 @@ udf_aerospike_setbin(udf_record * urecord, int offset, const char * bname, const
 		SINDEX_GUNLOCK();
 		if (sbins_populated > 0) {
 			tr->flags |= AS_TRANSACTION_FLAG_SINDEX_TOUCHED;
-			as_sindex_update_by_sbin(rd->ns, as_index_get_set_name(rd->r, rd->ns), sbins, sbins_populated, &rd->keyd);	
+			as_sindex_update_by_sbin(rd->ns, as_index_get_set_name(rd->r, rd->ns), sbins, sbins_populated, &rd->keyd, NULL);	
 			as_sindex_sbin_freeall(sbins, sbins_populated);
 		}
 		as_sindex_release_arr(si_arr, si_arr_index);
@@ -834,8 +834,8 @@ udf_aerospike_rec_create(const as_aerospike * as, const as_rec * rec)
 	if (rv == 1) {
 		// Record created.
 	} else if (rv == 0) {
-		// If it's an expired record, pretend it's a fresh create.
-		if (as_record_is_expired(r_ref->r)) {
+		// If it's an expired or truncated record, pretend it's a fresh create.
+		if (as_record_is_doomed(r_ref->r, tr->rsv.ns)) {
 			as_record_destroy(r_ref->r, tr->rsv.ns);
 			as_record_reinitialize(r_ref, tr->rsv.ns);
 			cf_atomic64_incr(&tr->rsv.ns->n_objects);
@@ -1017,7 +1017,7 @@ udf_aerospike_rec_remove(const as_aerospike * as, const as_rec * rec)
 	as_record_clean_bins(rd);
 
 	if (rd->ns->storage_data_in_memory && ! rd->ns->single_bin) {
-		as_record_free_bin_space(rd->r);
+		as_record_free_bin_space(rd->r, rd->ns);
 		rd->bins = NULL;
 		rd->n_bins = 0;
 	}
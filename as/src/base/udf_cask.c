@@ -25,6 +25,7 @@
 #include <dirent.h>
 #include <errno.h>
 #include <pthread.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -54,6 +55,7 @@ char *as_udf_type_name[] = {"LUA", 0};
 
 static int file_read(char *, uint8_t **, size_t *, unsigned char *);
 static int file_write(char *, uint8_t *, size_t, unsigned char *);
+static bool file_matches(char *, uint8_t *, size_t);
 static int file_remove(char *);
 static int file_generation(char *, uint8_t *, size_t, unsigned char *);
 
@@ -135,33 +137,72 @@ static int file_read(char * filename, uint8_t ** content, size_t * content_len,
 	return 1;
 }
 
+// Writes to a temporary file and renames it into place, so mod-lua loading the
+// module concurrently sees either the old or the new script, never a partial
+// one. This lets callers write without holding the mod-lua write lock.
 static int file_write(char * filename, uint8_t * content, size_t content_len, unsigned char * hash) {
 
 	FILE *  file            = NULL;
 	char    filepath[256]   = {0};
+	char    tmppath[256]    = {0};
 
 	file_resolve(filepath, filename, NULL);
+	file_resolve(tmppath, filename, ".tmp");
 
-	file = fopen(filepath, "w");
+	file = fopen(tmppath, "w");
 	if (file == NULL) {
-		cf_warning(AS_UDF, "could not open udf put to %s: %s", filepath, cf_strerror(errno));
+		cf_warning(AS_UDF, "could not open udf put to %s: %s", tmppath, cf_strerror(errno));
 		return -1;
 	}
 	int r = fwrite(content, sizeof(char), content_len, file);
 	if (r <= 0) {
-		cf_warning(AS_UDF, "could not write file %s: %d", filepath, r);
+		cf_warning(AS_UDF, "could not write file %s: %d", tmppath, r);
 		fclose(file);
+		unlink(tmppath);
 		return -1;
 	}
 
 	fclose(file);
 	file = NULL;
 
+	if (rename(tmppath, filepath) != 0) {
+		cf_warning(AS_UDF, "could not rename %s to %s: %s", tmppath, filepath, cf_strerror(errno));
+		unlink(tmppath);
+		return -1;
+	}
+
 	file_generation(filepath, content, content_len, hash);
 
 	return 0;
 }
 
+// Returns true if the file on disk already holds exactly this content.
+static bool file_matches(char * filename, uint8_t * content, size_t content_len) {
+
+	char        filepath[256]   = {0};
+	struct stat st;
+
+	file_resolve(filepath, filename, NULL);
+
+	if (stat(filepath, &st) != 0 || (size_t)st.st_size != content_len) {
+		return false;
+	}
+
+	FILE * file = fopen(filepath, "r");
+	if (file == NULL) {
+		return false;
+	}
+
+	uint8_t * buf = cf_malloc(content_len);
+	bool matches = fread(buf, sizeof(char), content_len, file) == content_len &&
+			memcmp(buf, content, content_len) == 0;
+
+	cf_free(buf);
+	fclose(file);
+
+	return matches;
+}
+
 static int file_remove(char * filename) {
 	char filepath[256] = {0};
 	file_resolve(filepath, filename, NULL);
@@ -660,8 +701,16 @@ udf_cask_smd_accept_fn(char *module, as_smd_item_list_t *items, void *udata, uin
 
 			content_str[decoded_len] = 0;
 
+			// SMD re-delivers every item on cluster changes - an unchanged
+			// script must not flush the module's cached Lua states.
+			if (file_matches(item->key, (uint8_t *) content_str, decoded_len)) {
+				cf_debug(AS_UDF, "%s unchanged, keeping cached states", item->key);
+				cf_free(content_str);
+				json_decref(item_obj);
+				continue;
+			}
+
 			cf_debug(AS_UDF, "pushing to %s, %d bytes [%s]", item->key, decoded_len, content_str);
-			mod_lua_wrlock(&mod_lua);
 
 			// content_gen is actually a hash. Not sure if it's filled out or what.
 			unsigned char       content_gen[256]    = {0};
@@ -669,11 +718,13 @@ udf_cask_smd_accept_fn(char *module, as_smd_item_list_t *items, void *udata, uin
 			cf_free(content_str);
 			json_decref(item_obj);
 			if ( e ) {
-				mod_lua_unlock(&mod_lua);
 				cf_info(AS_UDF, "invalid script on accept, will not register %s", item->key);
 				continue;
 			}
-			// Update the cache
+
+			// Update the cache - file is already in place, so the write lock
+			// (which stalls every running UDF) covers only the cache update.
+			mod_lua_wrlock(&mod_lua);
 			as_module_event ame = {
 				.type           = AS_MODULE_EVENT_FILE_ADD,
 				.data.filename  = item->key
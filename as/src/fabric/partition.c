@@ -116,6 +116,11 @@ as_partition_shutdown(as_namespace* ns, uint32_t pid)
 
 	pthread_mutex_lock(&p->lock);
 
+	// Nowhere to save tree roots - namespace won't warm restart.
+	if (! ns->xmem_roots) {
+		return;
+	}
+
 	as_index_tree_shutdown(p->vp,
 			&ns->xmem_roots[pid * ns->tree_shared.n_sprigs]);
 
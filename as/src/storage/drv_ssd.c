@@ -2722,6 +2722,40 @@ is_record_expired(as_namespace* ns, const drv_ssd_block* block,
 }
 
 
+bool
+is_record_truncated(as_namespace* ns, const drv_ssd_block* block,
+		const as_rec_props* p_props)
+{
+	uint64_t ns_truncate_lut = cf_atomic64_get(ns->truncate_lut);
+
+	if (ns_truncate_lut != 0 && block->last_update_time <= ns_truncate_lut) {
+		return true;
+	}
+
+	if (p_props->size == 0) {
+		return false;
+	}
+
+	const char* set_name;
+
+	if (as_rec_props_get_value(p_props, CL_REC_PROPS_FIELD_SET_NAME, NULL,
+			(uint8_t**)&set_name) != 0) {
+		return false;
+	}
+
+	as_set *p_set;
+
+	if (cf_vmapx_get_by_name(ns->p_sets_vmap, set_name, (void**)&p_set) !=
+			CF_VMAPX_OK) {
+		return false;
+	}
+
+	uint64_t set_truncate_lut = cf_atomic64_get(p_set->truncate_lut);
+
+	return set_truncate_lut != 0 && block->last_update_time <= set_truncate_lut;
+}
+
+
 // Add a record just read from drive to the index, if all is well.
 // Return values:
 //  0 - success, record added or updated
@@ -2824,6 +2858,15 @@ ssd_record_add(drv_ssds* ssds, drv_ssd* ssd, drv_ssd_block* block,
 		return -1;
 	}
 
+	// Skip records that were truncated. (LDT subrecords are truncated via
+	// their parent record.)
+	if (! is_ldt_sub && is_record_truncated(ns, block, &props)) {
+		as_index_delete(p_partition->vp, &block->keyd);
+		as_record_done(&r_ref, ns);
+		ssd->record_add_truncated_counter++;
+		return -1;
+	}
+
 	// We'll keep the record we're now reading ...
 
 	// Set/reset the record's last-update-time and generation.
@@ -2939,7 +2982,7 @@ ssd_record_add(drv_ssds* ssds, drv_ssd* ssd, drv_ssd_block* block,
 			SINDEX_GUNLOCK();
 
 			if (sbins_populated > 0) {
-				as_sindex_update_by_sbin(ns, as_index_get_set_name(r, ns), sbins, sbins_populated, &rd.keyd);
+				as_sindex_update_by_sbin(ns, as_index_get_set_name(r, ns), sbins, sbins_populated, &rd.keyd, r);
 				as_sindex_sbin_freeall(sbins, sbins_populated);
 			}
 
@@ -3139,6 +3182,191 @@ Finished:
 }
 
 
+// Populate secondary indexes from a record just read from drive, if the index
+// still refers to this copy of the record.
+// Return values:
+//  0 - record is current, added to secondary indexes
+// -1 - record was overwritten, deleted, expired or truncated - ignored
+int
+ssd_record_add_sindex(drv_ssd *ssd, drv_ssd_block *block, uint64_t rblock_id)
+{
+	as_namespace *ns = ssd->ns;
+
+	// Don't bother with reservations - partition trees aren't going anywhere.
+	as_partition *p_partition = &ns->partitions[as_partition_getid(block->keyd)];
+
+	as_index_ref r_ref;
+	r_ref.skip_lock = false;
+
+	// Secondary indexes don't cover LDT subrecords - only look in main tree.
+	if (as_record_get(p_partition->vp, &block->keyd, &r_ref, ns) != 0) {
+		return -1;
+	}
+
+	as_index *r = r_ref.r;
+
+	if (r->storage_key.ssd.file_id != ssd->file_id ||
+			r->storage_key.ssd.rblock_id != rblock_id ||
+			as_record_is_doomed(r, ns)) {
+		as_record_done(&r_ref, ns);
+		return -1;
+	}
+
+	as_storage_rd rd;
+
+	as_storage_record_open(ns, r, &rd, &r->key);
+
+	// Point at the block in the sweep buffer - no need to read it again.
+	rd.u.ssd.block = block;
+
+	as_storage_rd_load_n_bins(&rd);
+
+	as_bin stack_bins[rd.n_bins];
+
+	as_storage_rd_load_bins(&rd, stack_bins);
+
+	as_sindex_putall_rd(ns, &rd);
+
+	as_storage_record_close(&rd);
+	as_record_done(&r_ref, ns);
+
+	return 0;
+}
+
+
+typedef struct ssd_load_sindex_data_s {
+	drv_ssd *ssd;
+	cf_atomic64 *p_n_added;
+	uint64_t start_ms;
+} ssd_load_sindex_data;
+
+// Thread "run" function to sweep a device's in-use wblocks in device order and
+// populate secondary indexes. Only done after a cold start with data not in
+// memory, after all devices' index loading is complete, so that the index
+// identifies which copy of each record is current.
+void *
+run_load_sindexes(void *pv_data)
+{
+	ssd_load_sindex_data *lsd = (ssd_load_sindex_data*)pv_data;
+	drv_ssd *ssd = lsd->ssd;
+	as_namespace *ns = ssd->ns;
+
+	uint8_t *read_buf = cf_valloc(ssd->write_block_size);
+
+	if (! read_buf) {
+		cf_crash(AS_DRV_SSD, "device %s: sindex load valloc failed", ssd->name);
+	}
+
+	int fd = ssd_fd_get(ssd);
+
+	ssd_alloc_table *at = ssd->alloc_table;
+	uint32_t first_id = BYTES_TO_WBLOCK_ID(ssd, ssd->header_size);
+	uint32_t last_id = at->n_wblocks;
+
+	for (uint32_t wblock_id = first_id; wblock_id < last_id; wblock_id++) {
+		// Skip wblocks holding only stale copies of records.
+		if (at->wblock_state[wblock_id].inuse_sz == 0) {
+			continue;
+		}
+
+		uint64_t file_offset = WBLOCK_ID_TO_BYTES(ssd, wblock_id);
+
+		if (lseek(fd, (off_t)file_offset, SEEK_SET) != (off_t)file_offset) {
+			cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED seek: offset %lu: errno %d (%s)",
+					ssd->name, file_offset, errno, cf_strerror(errno));
+		}
+
+		ssize_t rlen = read(fd, read_buf, ssd->write_block_size);
+
+		if (rlen != (ssize_t)ssd->write_block_size) {
+			cf_crash(AS_DRV_SSD, "%s: DEVICE FAILED read (%ld): errno %d (%s)",
+					ssd->name, rlen, errno, cf_strerror(errno));
+		}
+
+		size_t wblock_offset = 0; // current offset within the wblock, in bytes
+
+		while (wblock_offset < ssd->write_block_size) {
+			drv_ssd_block *block = (drv_ssd_block*)&read_buf[wblock_offset];
+
+			if (block->magic != SSD_BLOCK_MAGIC) {
+				// Cold start sweep already dealt with bad first blocks.
+				wblock_offset += RBLOCK_SIZE;
+				continue;
+			}
+
+			size_t next_wblock_offset = wblock_offset +
+					BYTES_TO_RBLOCK_BYTES(block->length + LENGTH_BASE);
+
+			if (next_wblock_offset > ssd->write_block_size) {
+				break;
+			}
+
+			if (ssd_record_add_sindex(ssd, block,
+					BYTES_TO_RBLOCKS(file_offset + wblock_offset)) == 0) {
+				ssd->sindex_load_counter++;
+				as_sindex_ticker(ns, NULL, cf_atomic64_incr(lsd->p_n_added),
+						lsd->start_ms);
+			}
+
+			wblock_offset = next_wblock_offset;
+		}
+	}
+
+	ssd_fd_put(ssd, fd);
+	cf_free(read_buf);
+
+	return NULL;
+}
+
+
+// Populate all secondary indexes from the devices, so they needn't be built by
+// a primary index scan reading every record a second time.
+void
+ssd_load_sindexes(drv_ssds *ssds)
+{
+	as_namespace *ns = ssds->ns;
+
+	cf_info(AS_DRV_SSD, "{%s} loading secondary indexes from devices", ns->name);
+
+	cf_atomic64 n_added = 0;
+	uint64_t start_ms = cf_getms();
+
+	as_sindex_ticker_start(ns, NULL);
+
+	// Split this task across multiple threads.
+	pthread_t sindex_load_threads[ssds->n_ssds];
+	ssd_load_sindex_data lsds[ssds->n_ssds];
+
+	for (int i = 0; i < ssds->n_ssds; i++) {
+		lsds[i].ssd = &ssds->ssds[i];
+		lsds[i].p_n_added = &n_added;
+		lsds[i].start_ms = start_ms;
+
+		if (pthread_create(&sindex_load_threads[i], NULL, run_load_sindexes,
+				(void*)&lsds[i]) != 0) {
+			cf_crash(AS_DRV_SSD, "%s sindex load thread failed",
+					ssds->ssds[i].name);
+		}
+	}
+
+	for (int i = 0; i < ssds->n_ssds; i++) {
+		pthread_join(sindex_load_threads[i], NULL);
+	}
+	// Now we're single-threaded again.
+
+	for (int i = 0; i < ssds->n_ssds; i++) {
+		drv_ssd *ssd = &ssds->ssds[i];
+
+		cf_info(AS_DRV_SSD, "device %s: sindex load complete: %"PRIu64" records",
+				ssd->name, ssd->sindex_load_counter);
+	}
+
+	as_sindex_ticker_done(ns, NULL, start_ms);
+
+	ns->cold_start_sindex_loaded = true;
+}
+
+
 typedef struct {
 	drv_ssds *ssds;
 	drv_ssd *ssd;
@@ -3177,10 +3405,11 @@ ssd_load_devices_fn(void *udata)
 		ssd_load_device_sweep(ssds, ssd);
 	}
 
-	cf_info(AS_DRV_SSD, "device %s: read complete: UNIQUE %"PRIu64" (REPLACED %"PRIu64") (OLDER %"PRIu64") (EXPIRED %"PRIu64") (MAX-TTL %"PRIu64") records",
+	cf_info(AS_DRV_SSD, "device %s: read complete: UNIQUE %"PRIu64" (REPLACED %"PRIu64") (OLDER %"PRIu64") (EXPIRED %"PRIu64") (TRUNCATED %"PRIu64") (MAX-TTL %"PRIu64") records",
 		ssd->name, ssd->record_add_unique_counter,
 		ssd->record_add_replace_counter, ssd->record_add_older_counter,
-		ssd->record_add_expired_counter, ssd->record_add_max_ttl_counter);
+		ssd->record_add_expired_counter, ssd->record_add_truncated_counter,
+		ssd->record_add_max_ttl_counter);
 
 	if (ssd->record_add_sigfail_counter) {
 		cf_warning(AS_DRV_SSD, "device %s: WARNING: %"PRIu64" elements could not be read due to signature failure. Possible hardware errors.",
@@ -3192,6 +3421,14 @@ ssd_load_devices_fn(void *udata)
 
 		ssds->ns->cold_start_loading = false;
 		ssd_cold_start_drop_cenotaphs(ssds->ns);
+
+		// With data in memory, secondary indexes were populated as records
+		// were added. Otherwise do it now, while devices are quiescent.
+		if (! ssds->ns->storage_data_in_memory &&
+				as_sindex_ns_has_sindex(ssds->ns)) {
+			ssd_load_sindexes(ssds);
+		}
+
 		ssd_load_wblock_queues(ssds);
 
 		pthread_mutex_destroy(&ssds->ns->cold_start_evict_lock);
@@ -23,16 +23,116 @@
 #include "storage/drv_ssd.h"
 #include <stdbool.h>
 #include <stdint.h>
+#include "citrusleaf/cf_atomic.h"
 #include "fault.h"
+#include "vmapx.h"
 #include "base/datamodel.h"
+#include "base/index.h"
+#include "fabric/partition.h"
 #include "storage/storage.h"
 
 
+typedef struct resume_devices_info_s {
+	drv_ssds*		ssds;
+	as_partition*	p_partition;
+	as_index_tree*	tree;
+	bool			is_subrec;
+	uint64_t		n_records;
+	uint64_t		n_dropped;
+} resume_devices_info;
+
+
+// Account for a record in a resumed (file-backed) index as device loading
+// would have, or drop it if it doesn't fit the devices.
+static void
+resume_devices_reduce_cb(as_index_ref* r_ref, void* udata)
+{
+	resume_devices_info* rdi = (resume_devices_info*)udata;
+	drv_ssds* ssds = rdi->ssds;
+	as_namespace* ns = ssds->ns;
+	as_record* r = r_ref->r;
+
+	// Balanced by as_record_drop_stats() if the record is dropped below.
+	if (rdi->is_subrec) {
+		cf_atomic64_incr(&ns->n_sub_objects);
+	}
+	else {
+		cf_atomic64_incr(&ns->n_objects);
+	}
+
+	uint16_t set_id = as_index_get_set_id(r);
+	as_set* p_set;
+
+	if (set_id != INVALID_SET_ID && cf_vmapx_get_by_index(ns->p_sets_vmap,
+			set_id - 1, (void**)&p_set) == CF_VMAPX_OK) {
+		cf_atomic64_incr(&p_set->n_objects);
+	}
+
+	uint32_t file_id = r->storage_key.ssd.file_id;
+	uint64_t rblock_id = r->storage_key.ssd.rblock_id;
+	uint32_t n_rblocks = r->storage_key.ssd.n_rblocks;
+
+	drv_ssd* ssd = (int)file_id < ssds->n_ssds ? &ssds->ssds[file_id] : NULL;
+	uint32_t wblock_id = ssd ? RBLOCK_ID_TO_WBLOCK_ID(ssd, rblock_id) : 0;
+
+	if (! ssd || ssd->started_fresh || STORAGE_RBLOCK_IS_INVALID(rblock_id) ||
+			n_rblocks == 0 || wblock_id >= ssd->alloc_table->n_wblocks ||
+			RBLOCKS_TO_BYTES(rblock_id) < ssd->header_size) {
+		// Don't give back storage that was never accounted for.
+		r->storage_key.ssd.rblock_id = STORAGE_INVALID_RBLOCK;
+		r->storage_key.ssd.n_rblocks = 0;
+
+		as_index_delete(rdi->tree, &r->key);
+		as_record_done(r_ref, ns);
+		rdi->n_dropped++;
+		return;
+	}
+
+	uint32_t size = (uint32_t)RBLOCKS_TO_BYTES(n_rblocks);
+
+	cf_atomic64_add(&ssd->inuse_size, (int64_t)size);
+	cf_atomic32_add(&ssd->alloc_table->wblock_state[wblock_id].inuse_sz,
+			(int32_t)size);
+
+	cf_atomic64_setmax(&rdi->p_partition->max_void_time, r->void_time);
+
+	as_record_done(r_ref, ns);
+	rdi->n_records++;
+}
+
+
+// Warm restart from a file-backed index - imitate device loading by reducing
+// the resumed index. (Caller then loads wblock queues and starts threads.)
 void
 ssd_resume_devices(drv_ssds* ssds)
 {
-	// Should not get here - for enterprise version only.
-	cf_crash(AS_DRV_SSD, "cold start called ssd_resume_devices()");
+	as_namespace* ns = ssds->ns;
+	resume_devices_info rdi = { .ssds = ssds };
+
+	cf_info(AS_DRV_SSD, "{%s} resuming devices from index", ns->name);
+
+	for (uint32_t pid = 0; pid < AS_PARTITIONS; pid++) {
+		as_partition* p = &ns->partitions[pid];
+
+		rdi.p_partition = p;
+
+		rdi.tree = p->vp;
+		rdi.is_subrec = false;
+		as_index_reduce(p->vp, resume_devices_reduce_cb, &rdi);
+
+		if (ns->ldt_enabled) {
+			rdi.tree = p->sub_vp;
+			rdi.is_subrec = true;
+			as_index_reduce(p->sub_vp, resume_devices_reduce_cb, &rdi);
+		}
+	}
+
+	if (rdi.n_dropped != 0) {
+		cf_warning(AS_DRV_SSD, "{%s} dropped %lu index entries not matching devices",
+				ns->name, rdi.n_dropped);
+	}
+
+	cf_info(AS_DRV_SSD, "{%s} resumed %lu records", ns->name, rdi.n_records);
 }
 
 
@@ -708,6 +708,24 @@ as_storage_record_get_key(as_storage_rd *rd)
 	return false;
 }
 
+// Take over the buffer a data-not-in-memory record was read into, so bins
+// loaded from it stay valid after the record is closed. Caller must free it.
+// Returns NULL if there's no such buffer.
+uint8_t *
+as_storage_record_detach_read_buf(as_storage_rd *rd)
+{
+	if (rd->storage_type != AS_STORAGE_ENGINE_SSD ||
+			rd->ns->storage_data_in_memory) {
+		return NULL;
+	}
+
+	uint8_t *buf = rd->u.ssd.must_free_block;
+
+	rd->u.ssd.must_free_block = NULL;
+
+	return buf;
+}
+
 size_t
 as_storage_record_rec_props_size(as_storage_rd *rd)
 {
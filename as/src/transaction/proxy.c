@@ -535,6 +535,9 @@ proxyer_handle_client_response(msg* m, proxy_request* pr)
 
 	as_file_handle* fd_h = pr->from.proto_fd_h;
 
+	as_msg_reply_riders_from_msg(fd_h, proto, proto_sz);
+	as_msg_flush_replies(fd_h);
+
 	if (cf_socket_send_all(&fd_h->sock, proto, proto_sz, MSG_NOSIGNAL,
 			CF_SOCKET_TIMEOUT) < 0) {
 		// Common when a client aborts.
@@ -996,6 +999,9 @@ shipop_handle_client_response(msg* m, rw_request* rw)
 
 	as_file_handle* fd_h = rw->from.proto_fd_h;
 
+	as_msg_reply_riders_from_msg(fd_h, proto, proto_sz);
+	as_msg_flush_replies(fd_h);
+
 	if (cf_socket_send_all(&fd_h->sock, proto, proto_sz, MSG_NOSIGNAL,
 			CF_SOCKET_TIMEOUT) < 0) {
 		// Common when a client aborts.
@@ -42,6 +42,7 @@
 #include "base/cfg.h"
 #include "base/datamodel.h"
 #include "base/index.h"
+#include "base/profile.h"
 #include "base/proto.h"
 #include "base/transaction.h"
 #include "base/transaction_policy.h"
@@ -224,6 +225,7 @@ send_read_response(as_transaction* tr, as_msg_op** ops, as_bin** response_bins,
 					tr->rsv.ns, as_transaction_trid(tr), set_name);
 		}
 		BENCHMARK_NEXT_DATA_POINT(tr, read, response);
+		AS_PROFILE_MARK(tr, AS_PROFILE_RESPONSE);
 		HIST_TRACK_ACTIVATE_INSERT_DATA_POINT(tr, read_hist);
 		client_read_update_stats(tr->rsv.ns, tr->result_code);
 		break;
@@ -310,6 +312,8 @@ read_local(as_transaction* tr)
 		return TRANS_DONE_ERROR;
 	}
 
+	AS_PROFILE_MARK(tr, AS_PROFILE_INDEX);
+
 	as_record* r = r_ref.r;
 
 	if (! as_record_is_live(r)) {
@@ -317,8 +321,8 @@ read_local(as_transaction* tr)
 		return TRANS_DONE_ERROR;
 	}
 
-	// Check if it's an expired record.
-	if (as_record_is_expired(r)) {
+	// Check if it's an expired or truncated record.
+	if (as_record_is_doomed(r, ns)) {
 		read_local_done(tr, &r_ref, NULL, AS_PROTO_RESULT_FAIL_NOTFOUND);
 		return TRANS_DONE_ERROR;
 	}
@@ -350,6 +354,8 @@ read_local(as_transaction* tr)
 
 	as_storage_rd_load_bins(&rd, stack_bins); // TODO - handle error returned
 
+	AS_PROFILE_MARK(tr, AS_PROFILE_STORAGE_READ);
+
 	if (! as_bin_inuse_has(&rd)) {
 		cf_warning_digest(AS_RW, &tr->keyd, "{%s} read_local: found record with no bins ", ns->name);
 		read_local_done(tr, &r_ref, &rd, AS_PROTO_RESULT_FAIL_UNKNOWN);
@@ -437,7 +443,17 @@ read_local(as_transaction* tr)
 
 	cf_dyn_buf_define_size(db, 16 * 1024);
 
-	if (tr->origin != FROM_BATCH) {
+	// Data-not-in-memory client replies send big bin values straight from the
+	// storage read buffer - take it over so it outlives the record close.
+	uint8_t* read_buf = tr->origin == FROM_CLIENT ?
+			as_storage_record_detach_read_buf(&rd) : NULL;
+
+	if (read_buf) {
+		tr->generation = r->generation;
+		tr->void_time = r->void_time;
+		tr->last_update_time = r->last_update_time;
+	}
+	else if (tr->origin != FROM_BATCH) {
 		db.used_sz = db.alloc_sz;
 		db.buf = (uint8_t*)as_msg_make_response_msg(tr->result_code,
 				r->generation, r->void_time, p_ops, response_bins, n_bins, ns,
@@ -464,18 +480,24 @@ read_local(as_transaction* tr)
 		send_read_response(tr, p_ops, response_bins, n_bins, set_name, NULL);
 	}
 
-	destroy_stack_bins(result_bins, n_result_bins);
 	as_storage_record_close(&rd);
 	as_record_done(&r_ref, ns);
 
-	// Now that we're not under the record lock, send the message we just built.
-	if (db.used_sz != 0) {
+	// Now that we're not under the record lock, send the response - either
+	// built from the bins, which still point into read_buf, or built above.
+	if (read_buf) {
+		send_read_response(tr, p_ops, response_bins, n_bins, set_name, NULL);
+		cf_free(read_buf);
+	}
+	else if (db.used_sz != 0) {
 		send_read_response(tr, NULL, NULL, 0, NULL, &db);
 
 		cf_dyn_buf_free(&db);
 		tr->from.proto_fd_h = NULL;
 	}
 
+	destroy_stack_bins(result_bins, n_result_bins);
+
 	return TRANS_DONE_SUCCESS;
 }
 
@@ -35,6 +35,7 @@
 
 #include "citrusleaf/alloc.h"
 #include "citrusleaf/cf_atomic.h"
+#include "citrusleaf/cf_byte_order.h"
 #include "citrusleaf/cf_clock.h"
 
 #include "fault.h"
@@ -82,6 +83,9 @@ COMPILER_ASSERT(sizeof(rw_mt) / sizeof(msg_template) == NUM_RW_FIELDS);
 
 #define RW_MSG_SCRATCH_SIZE 128
 
+// Most increments combined into one write.
+#define MAX_COMBINE_OPS 32
+
 
 //==========================================================
 // Forward Declarations.
@@ -89,6 +93,8 @@ COMPILER_ASSERT(sizeof(rw_mt) / sizeof(msg_template) == NUM_RW_FIELDS);
 
 uint32_t rw_request_hash_fn(void* value, uint32_t value_len);
 transaction_status handle_hot_key(rw_request* rw0, as_transaction* tr);
+bool combine_increments(as_transaction* waiter, as_transaction* tr);
+bool is_combinable_increment(const as_transaction* tr);
 
 void* run_retransmit(void* arg);
 int retransmit_reduce_fn(void* key, uint32_t keylen, void* data, void* udata);
@@ -239,6 +245,15 @@ handle_hot_key(rw_request* rw0, as_transaction* tr)
 
 		return TRANS_DONE_ERROR;
 	}
+	else if (g_config.transaction_combine_increments &&
+			rw0->wait_queue_head &&
+			combine_increments(&rw0->wait_queue_head->tr, tr)) {
+		// This transaction's increments were folded into the newest waiter,
+		// which will reply to it - nothing left to queue.
+		cf_atomic64_incr(&tr->rsv.ns->n_hot_key_combined);
+
+		return TRANS_WAITING;
+	}
 	else {
 		// Queue this transaction on the original rw_request - it will be
 		// retried when the original is complete.
@@ -252,12 +267,124 @@ handle_hot_key(rw_request* rw0, as_transaction* tr)
 
 		e->next = rw0->wait_queue_head;
 		rw0->wait_queue_head = e;
+		rw0->wait_queue_depth++;
 
 		return TRANS_WAITING;
 	}
 }
 
 
+// Fold tr's increments into a queued transaction that increments the same bins
+// with the same policy. On success, the waiter's client also gets tr's reply,
+// and tr's msgp and file handle are consumed.
+bool
+combine_increments(as_transaction* waiter, as_transaction* tr)
+{
+	if (! is_combinable_increment(waiter) || ! is_combinable_increment(tr)) {
+		return false;
+	}
+
+	as_msg* wm = &waiter->msgp->msg;
+	as_msg* m = &tr->msgp->msg;
+
+	if (wm->info3 != m->info3 || wm->record_ttl != m->record_ttl ||
+			wm->n_ops != m->n_ops || waiter->msg_fields != tr->msg_fields ||
+			tr->from.proto_fd_h->riders) {
+		return false;
+	}
+
+	int64_t sums[MAX_COMBINE_OPS];
+	as_msg_op* wop = NULL;
+	as_msg_op* op = NULL;
+	int wi = 0;
+	int i = 0;
+
+	// First pass - match bins and check for overflow, changing nothing.
+	for (uint16_t n = 0; n < wm->n_ops; n++) {
+		wop = as_msg_op_iterate(wm, wop, &wi);
+		op = as_msg_op_iterate(m, op, &i);
+
+		if (wop->name_sz != op->name_sz ||
+				memcmp(wop->name, op->name, op->name_sz) != 0) {
+			return false;
+		}
+
+		uint64_t wv;
+		uint64_t v;
+
+		memcpy(&wv, as_msg_op_get_value_p(wop), sizeof(wv));
+		memcpy(&v, as_msg_op_get_value_p(op), sizeof(v));
+
+		if (__builtin_add_overflow((int64_t)cf_swap_from_be64(wv),
+				(int64_t)cf_swap_from_be64(v), &sums[n])) {
+			return false;
+		}
+	}
+
+	wop = NULL;
+	wi = 0;
+
+	for (uint16_t n = 0; n < wm->n_ops; n++) {
+		wop = as_msg_op_iterate(wm, wop, &wi);
+
+		uint64_t wv = cf_swap_to_be64((uint64_t)sums[n]);
+
+		memcpy(as_msg_op_get_value_p(wop), &wv, sizeof(wv));
+	}
+
+	as_reply_rider* rider = cf_malloc(sizeof(as_reply_rider));
+	cf_assert(rider, AS_RW, "alloc as_reply_rider");
+
+	as_file_handle* fd_h = waiter->from.proto_fd_h;
+
+	rider->fd_h = tr->from.proto_fd_h;
+	rider->trid = as_transaction_trid(tr);
+	rider->next = fd_h->riders;
+	fd_h->riders = rider;
+
+	cf_free(tr->msgp);
+	tr->msgp = NULL;
+	tr->from.any = NULL;
+
+	return true;
+}
+
+
+// Only plain client writes made entirely of 8-byte integer increments qualify -
+// anything conditional or with a per-op result is left to queue as usual.
+bool
+is_combinable_increment(const as_transaction* tr)
+{
+	if (tr->origin != FROM_CLIENT || ! tr->from.any || ! tr->msgp ||
+			(tr->msg_fields & (AS_MSG_FIELD_BIT_UDF_FILENAME |
+					AS_MSG_FIELD_BIT_UDF_FUNCTION |
+					AS_MSG_FIELD_BIT_UDF_ARGLIST |
+					AS_MSG_FIELD_BIT_UDF_OP)) != 0) {
+		return false;
+	}
+
+	as_msg* m = &tr->msgp->msg;
+
+	if (m->info1 != 0 || m->info2 != AS_MSG_INFO2_WRITE || m->n_ops == 0 ||
+			m->n_ops > MAX_COMBINE_OPS) {
+		return false;
+	}
+
+	as_msg_op* op = NULL;
+	int i = 0;
+
+	while ((op = as_msg_op_iterate(m, op, &i)) != NULL) {
+		if (op->op != AS_MSG_OP_INCR ||
+				op->particle_type != AS_PARTICLE_TYPE_INTEGER ||
+				as_msg_op_get_value_sz(op) != sizeof(uint64_t)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+
 //==========================================================
 // Local helpers - retransmit.
 //
@@ -324,7 +324,7 @@ remove_from_sindex(as_namespace* ns, const char* set_name, cf_digest* keyd,
 	SINDEX_GUNLOCK();
 
 	if (sbins_populated) {
-		as_sindex_update_by_sbin(ns, set_name, sbins, sbins_populated, keyd);
+		as_sindex_update_by_sbin(ns, set_name, sbins, sbins_populated, keyd, NULL);
 		as_sindex_sbin_freeall(sbins, sbins_populated);
 	}
 
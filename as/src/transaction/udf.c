@@ -701,8 +701,8 @@ udf_master_apply(udf_call* call, rw_request* rw)
 
 	int get_rv = as_record_get(tr->rsv.tree, &tr->keyd, &r_ref, ns);
 
-	if (get_rv == 0 && as_record_is_expired(r_ref.r)) {
-		// If record is expired, pretend it was not found.
+	if (get_rv == 0 && as_record_is_doomed(r_ref.r, ns)) {
+		// If record is expired or truncated, pretend it was not found.
 		as_record_done(&r_ref, ns);
 		get_rv = -1;
 	}
@@ -1022,7 +1022,8 @@ udf_post_processing(udf_record* urecord, udf_optype urecord_op, uint16_t set_id)
 		if (! as_index_is_flag_set(r_ref->r, AS_INDEX_FLAG_KEY_STORED) &&
 				rd->key) {
 			if (rd->ns->storage_data_in_memory) {
-				as_record_allocate_key(r_ref->r, rd->key, rd->key_size);
+				as_record_allocate_key(r_ref->r, rd->key, rd->key_size,
+						rd->ns);
 			}
 
 			as_index_set_flags(r_ref->r, AS_INDEX_FLAG_KEY_STORED);
@@ -1031,7 +1032,7 @@ udf_post_processing(udf_record* urecord, udf_optype urecord_op, uint16_t set_id)
 		else if (as_index_is_flag_set(r_ref->r, AS_INDEX_FLAG_KEY_STORED) &&
 				! rd->key) {
 			if (rd->ns->storage_data_in_memory) {
-				as_record_remove_key(r_ref->r);
+				as_record_remove_key(r_ref->r, rd->ns);
 			}
 
 			as_index_clear_flags(r_ref->r, AS_INDEX_FLAG_KEY_STORED);
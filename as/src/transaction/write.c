@@ -42,6 +42,7 @@
 #include "base/datamodel.h"
 #include "base/index.h"
 #include "base/ldt.h"
+#include "base/profile.h"
 #include "base/proto.h"
 #include "base/secondary_index.h"
 #include "base/transaction.h"
@@ -120,7 +121,7 @@ int write_master_bin_ops_loop(as_transaction* tr, as_storage_rd* rd,
 		uint32_t* p_n_cleanup_bins, xdr_dirty_bins* dirty_bins);
 int write_master_bin_check(as_transaction* tr, as_bin* bin);
 bool write_master_sindex_update(as_namespace* ns, const char* set_name,
-		cf_digest* keyd, as_bin* old_bins, uint32_t n_old_bins,
+		cf_digest* keyd, as_record* r, as_bin* old_bins, uint32_t n_old_bins,
 		as_bin* new_bins, uint32_t n_new_bins);
 
 void write_master_index_metadata_unwind(index_metadata* old, as_record* r);
@@ -380,6 +381,7 @@ void
 write_repl_write_cb(rw_request* rw)
 {
 	BENCHMARK_NEXT_DATA_POINT(rw, write, repl_write);
+	AS_PROFILE_MARK(rw, AS_PROFILE_REPLICATION);
 
 	as_transaction tr;
 	as_transaction_init_from_rw(&tr, rw);
@@ -417,6 +419,7 @@ send_write_response(as_transaction* tr, cf_dyn_buf* db)
 					as_transaction_trid(tr), NULL);
 		}
 		BENCHMARK_NEXT_DATA_POINT(tr, write, response);
+		AS_PROFILE_MARK(tr, AS_PROFILE_RESPONSE);
 		HIST_TRACK_ACTIVATE_INSERT_DATA_POINT(tr, write_hist);
 		client_write_update_stats(tr->rsv.ns, tr->result_code,
 				as_transaction_is_xdr(tr));
@@ -537,7 +540,7 @@ write_master(rw_request* rw, as_transaction* tr)
 
 		r = r_ref.r;
 
-		if (as_record_is_expired(r)) {
+		if (as_record_is_doomed(r, ns)) {
 			write_master_failed(tr, &r_ref, record_created, tree, 0, AS_PROTO_RESULT_FAIL_NOTFOUND);
 			return TRANS_DONE_ERROR;
 		}
@@ -554,8 +557,8 @@ write_master(rw_request* rw, as_transaction* tr)
 		r = r_ref.r;
 		record_created = rv == 1;
 
-		// If it's an expired record, pretend it's a fresh create.
-		if (! record_created && as_record_is_expired(r)) {
+		// If it's an expired or truncated record, pretend it's a fresh create.
+		if (! record_created && as_record_is_doomed(r, ns)) {
 			as_record_destroy(r, ns);
 			as_record_reinitialize(&r_ref, ns);
 			cf_atomic64_incr(&ns->n_objects);
@@ -563,6 +566,8 @@ write_master(rw_request* rw, as_transaction* tr)
 		}
 	}
 
+	AS_PROFILE_MARK(tr, AS_PROFILE_INDEX);
+
 	// Enforce record-level create-only existence policy.
 	if (! record_created && ! create_only_check(r, m)) {
 		write_master_failed(tr, &r_ref, record_created, tree, 0, AS_PROTO_RESULT_FAIL_RECORD_EXISTS);
@@ -1183,7 +1188,7 @@ write_master_dim(as_transaction* tr, const char* set_name, as_storage_rd* rd,
 	if (n_new_bins != 0) {
 		new_bins_size = n_new_bins * sizeof(as_bin);
 		new_bin_space = (as_bin_space*)
-				cf_malloc_ns(sizeof(as_bin_space) + new_bins_size);
+				as_namespace_dim_malloc(ns, sizeof(as_bin_space) + new_bins_size);
 
 		if (! new_bin_space) {
 			cf_warning(AS_RW, "write_master: failed alloc new as_bin_space");
@@ -1205,7 +1210,8 @@ write_master_dim(as_transaction* tr, const char* set_name, as_storage_rd* rd,
 	// Pickle before writing - can't fail after.
 	if (! pickle_all(rd, rw)) {
 		if (new_bin_space) {
-			cf_free(new_bin_space);
+			as_namespace_dim_free(ns, new_bin_space,
+					sizeof(as_bin_space) + new_bins_size);
 		}
 
 		write_master_index_metadata_unwind(&old_metadata, r);
@@ -1221,7 +1227,8 @@ write_master_dim(as_transaction* tr, const char* set_name, as_storage_rd* rd,
 		cf_warning_digest(AS_RW, &tr->keyd, "{%s} write_master: failed as_storage_record_write() ", ns->name);
 
 		if (new_bin_space) {
-			cf_free(new_bin_space);
+			as_namespace_dim_free(ns, new_bin_space,
+					sizeof(as_bin_space) + new_bins_size);
 		}
 
 		write_master_index_metadata_unwind(&old_metadata, r);
@@ -1234,7 +1241,7 @@ write_master_dim(as_transaction* tr, const char* set_name, as_storage_rd* rd,
 	//
 
 	if (as_sindex_ns_has_sindex(ns) &&
-			write_master_sindex_update(ns, set_name, &tr->keyd, old_bins,
+			write_master_sindex_update(ns, set_name, &tr->keyd, r, old_bins,
 					n_old_bins, new_bins, n_new_bins)) {
 		tr->flags |= AS_TRANSACTION_FLAG_SINDEX_TOUCHED;
 	}
@@ -1263,7 +1270,8 @@ write_master_dim(as_transaction* tr, const char* set_name, as_storage_rd* rd,
 	as_bin_space* old_bin_space = as_index_get_bin_space(r);
 
 	if (old_bin_space) {
-		cf_free(old_bin_space);
+		as_namespace_dim_free(ns, old_bin_space, sizeof(as_bin_space) +
+				(old_bin_space->n_bins * sizeof(as_bin)));
 	}
 
 	as_index_set_bin_space(r, new_bin_space);
@@ -1271,7 +1279,7 @@ write_master_dim(as_transaction* tr, const char* set_name, as_storage_rd* rd,
 	// Accommodate a new stored key - wasn't needed for pickling and writing.
 	if (! as_index_is_flag_set(r, AS_INDEX_FLAG_KEY_STORED) && rd->key) {
 		// TODO - should we check allocation failure?
-		as_record_allocate_key(r, rd->key, rd->key_size);
+		as_record_allocate_key(r, rd->key, rd->key_size, ns);
 		as_index_set_flags(r, AS_INDEX_FLAG_KEY_STORED);
 	}
 
@@ -1511,7 +1519,7 @@ write_master_ssd(as_transaction* tr, const char* set_name, as_storage_rd* rd,
 	//
 
 	if (has_sindex &&
-			write_master_sindex_update(ns, set_name, &tr->keyd, old_bins,
+			write_master_sindex_update(ns, set_name, &tr->keyd, r, old_bins,
 					n_old_bins, new_bins, n_new_bins)) {
 		tr->flags |= AS_TRANSACTION_FLAG_SINDEX_TOUCHED;
 	}
@@ -1864,7 +1872,7 @@ write_master_bin_check(as_transaction* tr, as_bin* bin)
 
 bool
 write_master_sindex_update(as_namespace* ns, const char* set_name,
-		cf_digest* keyd, as_bin* old_bins, uint32_t n_old_bins,
+		cf_digest* keyd, as_record* r, as_bin* old_bins, uint32_t n_old_bins,
 		as_bin* new_bins, uint32_t n_new_bins)
 {
 	int sbins_populated = 0;
@@ -1955,7 +1963,7 @@ write_master_sindex_update(as_namespace* ns, const char* set_name,
 	SINDEX_GUNLOCK();
 
 	if (sbins_populated != 0) {
-		as_sindex_update_by_sbin(ns, set_name, sbins, sbins_populated, keyd);
+		as_sindex_update_by_sbin(ns, set_name, sbins, sbins_populated, keyd, r);
 		as_sindex_sbin_freeall(sbins, sbins_populated);
 	}
 
@@ -43,6 +43,8 @@
 
 #define CF_ARENAX_BIGLOCK	(1 << 0)
 #define CF_ARENAX_CALLOC	(1 << 1)
+#define CF_ARENAX_MAGAZINES	(1 << 2) // cache free handles per thread
+#define CF_ARENAX_DEVICE	(1 << 3) // mapped stages are device-resident
 
 // Stage is indexed by 8 bits.
 #define CF_ARENAX_MAX_STAGES (1 << 8) // 256
@@ -56,6 +58,7 @@ typedef enum {
 	CF_ARENAX_ERR_STAGE_CREATE,
 	CF_ARENAX_ERR_STAGE_ATTACH,
 	CF_ARENAX_ERR_STAGE_DETACH,
+	CF_ARENAX_ERR_CHECKPOINT,
 	CF_ARENAX_ERR_UNKNOWN
 } cf_arenax_err;
 
@@ -73,6 +76,7 @@ typedef enum {
 typedef struct cf_arenax_s {
 	// Configuration (passed in constructors)
 	key_t				key_base;
+	const char*			file_base; // if set, stages are mapped files
 	uint32_t			element_size;
 	uint32_t			stage_capacity;
 	uint32_t			max_stages;
@@ -81,8 +85,11 @@ typedef struct cf_arenax_s {
 	// Configuration (derived)
 	size_t				stage_size;
 
-	// Free-element List
-	cf_arenax_handle	free_h;
+	// Free-element Lists - one per stage, with counts, so stages with
+	// nothing allocated can be found without walking the lists
+	cf_arenax_handle	free_h[CF_ARENAX_MAX_STAGES];
+	uint32_t			n_free[CF_ARENAX_MAX_STAGES];
+	uint32_t			free_stage_id; // no free elements below this stage
 
 	// Where to End-allocate
 	uint32_t			at_stage_id;
@@ -125,17 +132,38 @@ cf_arenax_err cf_arenax_create(cf_arenax* _this, key_t key_base,
 		uint32_t element_size, uint32_t stage_capacity, uint32_t max_stages,
 		uint32_t flags);
 
+//------------------------------------------------
+// File-Backed Constructor, Checkpoint & Resume
+//
+cf_arenax_err cf_arenax_create_mapped(cf_arenax* _this, const char* file_base,
+		uint32_t element_size, uint32_t stage_capacity, uint32_t max_stages,
+		uint32_t flags);
+cf_arenax_err cf_arenax_checkpoint(cf_arenax* _this, uint64_t token);
+cf_arenax_err cf_arenax_resume_mapped(cf_arenax* _this, const char* file_base,
+		uint32_t element_size, uint32_t flags, uint64_t token);
+
 //------------------------------------------------
 // Allocate/Free an Element
 //
 cf_arenax_handle cf_arenax_alloc(cf_arenax* _this);
 void cf_arenax_free(cf_arenax* _this, cf_arenax_handle h);
 
+//------------------------------------------------
+// Allocate/Free a Run of Contiguous Elements
+//
+cf_arenax_handle cf_arenax_alloc_run(cf_arenax* _this, uint32_t* p_n);
+void cf_arenax_free_run(cf_arenax* _this, cf_arenax_handle h, uint32_t n);
+
 //------------------------------------------------
 // Convert Handle to Pointer
 //
 void* cf_arenax_resolve(cf_arenax* _this, cf_arenax_handle h);
 
+//------------------------------------------------
+// Release Trailing Stages With Nothing Allocated
+//
+uint32_t cf_arenax_trim(cf_arenax* _this);
+
 
 //==========================================================
 // Private API - for enterprise separation only
@@ -149,3 +177,5 @@ cf_arenax_set_handle(cf_arenax_handle* h, uint32_t stage_id,
 }
 
 cf_arenax_err cf_arenax_add_stage(cf_arenax* _this);
+void cf_arenax_remove_stage(cf_arenax* _this);
+void cf_arenax_drain_mags(cf_arenax* _this);
@@ -31,10 +31,16 @@
 
 //==========================================================
 // Histogram with logarithmic buckets, used for all the
-// latency metrics.
+// latency metrics. Each bucket is split into linear
+// sub-buckets for percentiles. Hot-path histograms can
+// be created sharded, so threads don't share cache
+// lines - reads sum the shards.
 //
 
 #define N_BUCKETS (1 + 64)
+#define N_SUB_BUCKET_BITS 2
+#define N_SUB_BUCKETS (1 << N_SUB_BUCKET_BITS)
+#define N_HIST_SHARDS 8 // for sharded histograms - must be a power of 2
 #define HISTOGRAM_NAME_SIZE 512
 
 typedef enum {
@@ -50,18 +56,31 @@ typedef enum {
 #define HIST_TAG_SIZE			"bytes"
 #define HIST_TAG_COUNT			"count"
 
+#define HIST_SHARD_COUNTS_SZ (sizeof(cf_atomic64) * N_BUCKETS * N_SUB_BUCKETS)
+
+typedef struct histogram_shard_s {
+	cf_atomic64 counts[N_BUCKETS][N_SUB_BUCKETS];
+	uint8_t pad[64 - (HIST_SHARD_COUNTS_SZ % 64)]; // keep shards off each other's cache lines
+} histogram_shard;
+
 // DO NOT access this member data directly - use the API!
 // (Except for cf_hist_track, for which histogram is a base class.)
 typedef struct histogram_s {
 	char name[HISTOGRAM_NAME_SIZE];
 	const char* scale_tag;
 	uint32_t time_div;
-	cf_atomic64 counts[N_BUCKETS];
+	uint32_t n_shards;
+	histogram_shard* shards; // in the same allocation, after the histogram
 } histogram;
 
+extern histogram *histogram_alloc(size_t sz, const char *name, histogram_scale scale, bool sharded);
 extern histogram *histogram_create(const char *name, histogram_scale scale);
+extern histogram *histogram_create_sharded(const char *name, histogram_scale scale);
 extern void histogram_clear(histogram *h);
 extern void histogram_dump(histogram *h );
+extern void histogram_dump_percentiles(histogram *h);
+extern void histogram_get_counts(histogram *h, uint64_t counts[]);
+extern uint64_t histogram_get_percentile(histogram *h, double pct);
 
 extern uint64_t histogram_insert_data_point(histogram *h, uint64_t start_ns);
 extern void histogram_insert_raw(histogram *h, uint64_t value);
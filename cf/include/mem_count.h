@@ -45,6 +45,8 @@ typedef enum mem_count_mode_e {
 } mem_count_mode_t;
 
 int mem_count_init(mem_count_mode_t mode);
+void mem_count_set_sample_rate(uint32_t sample_rate);
+uint32_t mem_count_get_sample_rate(void);
 void mem_count_stats(void);
 int mem_count_alloc_info(char *file, int line, cf_dyn_buf *db);
 int mem_count_report(sort_field_t sort_field, int top_n, cf_dyn_buf *db);
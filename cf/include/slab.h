@@ -0,0 +1,84 @@
+/*
+ * slab.h
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+/*
+ * Size-class slab allocator, for many small, similar-size objects.
+ */
+
+#pragma once
+
+
+//==========================================================
+// Includes
+//
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "citrusleaf/cf_atomic.h"
+
+
+//==========================================================
+// Typedefs & Constants
+//
+
+#define CF_SLAB_GRANULE		16
+#define CF_SLAB_MAX_SIZE	1024 // bigger allocations go straight to the heap
+#define CF_SLAB_N_CLASSES	(CF_SLAB_MAX_SIZE / CF_SLAB_GRANULE)
+#define CF_SLAB_PAGE_SIZE	(64 * 1024)
+
+// DO NOT access this member data directly - use the API!
+typedef struct cf_slab_class_s {
+	pthread_mutex_t		lock;
+	void*				free_head; // freed slots, linked through their first bytes
+	uint8_t*			page_at; // carve new slots from here ...
+	uint8_t*			page_end; // ... up to here
+} cf_slab_class; // 64 bytes - a cache line
+
+typedef struct cf_slab_s {
+	cf_slab_class		classes[CF_SLAB_N_CLASSES];
+
+	// Each thread caches free slots per size class - see slab.c.
+	pthread_key_t		cache_key;
+
+	// Stats.
+	cf_atomic64			page_bytes; // pages carved into slots, never returned
+	cf_atomic64			used_bytes; // slots in use, rounded up to size class
+	cf_atomic64			heap_bytes; // allocations too big for slots
+} cf_slab;
+
+
+//==========================================================
+// Public API
+//
+
+cf_slab* cf_slab_create();
+
+// Callers pass the size on free and realloc - there's no per-slot header.
+void* cf_slab_malloc(cf_slab* slab, size_t size);
+void* cf_slab_realloc(cf_slab* slab, void* p, size_t old_size, size_t size);
+void cf_slab_free(cf_slab* slab, void* p, size_t size);
+
+uint64_t cf_slab_page_bytes(const cf_slab* slab);
+uint64_t cf_slab_used_bytes(const cf_slab* slab);
+uint64_t cf_slab_heap_bytes(const cf_slab* slab);
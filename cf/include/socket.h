@@ -30,6 +30,7 @@
 #include <netinet/in.h>
 #include <sys/epoll.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 
 #include "hardware.h"
 #include "msg.h"
@@ -257,6 +258,7 @@ static inline void cf_socket_copy(const cf_socket *from, cf_socket *to)
 }
 
 CF_MUST_CHECK int32_t cf_socket_init_server(cf_serv_cfg *cfg, cf_sockets *socks);
+CF_MUST_CHECK int32_t cf_socket_init_server_reuse_port(cf_serv_cfg *cfg, cf_sockets *socks);
 void cf_socket_show_server(cf_fault_context cont, const char *tag, const cf_sockets *socks);
 CF_MUST_CHECK int32_t cf_socket_init_client(cf_sock_cfg *cfg, int32_t timeout, cf_socket *sock);
 
@@ -275,6 +277,7 @@ CF_MUST_CHECK int32_t cf_socket_recv_from_all(cf_socket *sock, void *buff, size_
 CF_MUST_CHECK int32_t cf_socket_recv_all(cf_socket *sock, void *buff, size_t size, int32_t flags, int32_t timeout);
 CF_MUST_CHECK int32_t cf_socket_send_to_all(cf_socket *sock, const void *buff, size_t size, int32_t flags, const cf_sock_addr *addr, int32_t timeout);
 CF_MUST_CHECK int32_t cf_socket_send_all(cf_socket *sock, const void *buff, size_t size, int32_t flags, int32_t timeout);
+CF_MUST_CHECK int32_t cf_socket_send_iov_all(cf_socket *sock, struct iovec *iov, int32_t n_iov, int32_t flags, int32_t timeout);
 
 void cf_socket_write_shutdown(cf_socket *sock);
 void cf_socket_shutdown(cf_socket *sock);
@@ -176,6 +176,54 @@ static shash *loc2alloc_shash = NULL;
  */
 pthread_mutex_t mem_count_lock = PTHREAD_MUTEX_INITIALIZER;
 
+/*
+ * Sampled accounting - when the sample rate is greater than 1, only about one
+ * in every g_mem_count_sample_rate allocations takes the locked path above, and
+ * is attributed to its program location. All other allocations and frees are
+ * counted, without locking, in a per-thread counter summed when reporting.
+ */
+static uint32_t g_mem_count_sample_rate = 1;
+
+/*
+ * Has sampling ever been on? If so, pointers missing from mem_count_shash may
+ * be unsampled allocations, which must still be freed.
+ */
+static bool g_mem_count_ever_sampled = false;
+
+/*
+ * Counting filter over sampled pointers, so frees of pointers that were never
+ * sampled can skip mem_count_lock. A zero slot means "definitely not sampled".
+ */
+#define SAMPLED_FILTER_BITS 16
+#define SAMPLED_FILTER_SIZE (1 << SAMPLED_FILTER_BITS)
+
+static cf_atomic32 g_sampled_filter[SAMPLED_FILTER_SIZE];
+
+static inline cf_atomic32 *
+sampled_filter_slot(void *p)
+{
+	return &g_sampled_filter[((uint32_t)((uint64_t) p >> 4) * 0x9E3779B1) >> (32 - SAMPLED_FILTER_BITS)];
+}
+
+/*
+ * Per-thread unsampled counts. Each slot is written only by its owning thread,
+ * except the last one, which is shared (atomically) by any threads beyond the
+ * first MAX_THREAD_MEM_COUNTS - 1.
+ */
+typedef struct thread_mem_count_s {
+	int64_t net_sz;               // Net unsampled bytes allocated by this thread.
+	uint64_t n_allocs;            // Number of unsampled allocations.
+	uint64_t n_frees;             // Number of unsampled frees.
+} __attribute__ ((aligned(64))) thread_mem_count;
+
+#define MAX_THREAD_MEM_COUNTS 1024
+
+static thread_mem_count g_thread_mem_counts[MAX_THREAD_MEM_COUNTS];
+static cf_atomic32 g_n_thread_mem_counts = 0;
+
+static __thread thread_mem_count *t_mem_count = NULL;
+static __thread uint32_t t_sample_countdown = 0;
+
 /*
  * The JEM arena to be used by cf_malloc_ns() and friends. -1 indicates a
  * thread's default arena.
@@ -189,6 +237,7 @@ __thread int jem_ns_arena = -1;
  */
 static void make_location(location_t *loc, char *file, int line);
 static void copy_location(location_t *loc_out, location_t *loc_in);
+static void sum_unsampled(int64_t *net_sz, uint64_t *n_allocs, uint64_t *n_frees);
 
 /********************************************************************************/
 
@@ -1137,6 +1186,20 @@ mem_count_stats()
 	cf_info(CF_ALLOC, "mem_count_vallocs: %ld (%ld)", mcv, cf_atomic64_get(mem_count_valloc_total));
 	cf_info(CF_ALLOC, "=============================================");
 
+	if (g_mem_count_sample_rate > 1) {
+		int64_t unsampled_sz;
+		uint64_t unsampled_allocs;
+		uint64_t unsampled_frees;
+
+		sum_unsampled(&unsampled_sz, &unsampled_allocs, &unsampled_frees);
+		get_human_readable_memory_size(mc + unsampled_sz, &quantity, &scale);
+
+		cf_info(CF_ALLOC, "sample rate: 1 in %u (counts above are sampled only)", g_mem_count_sample_rate);
+		cf_info(CF_ALLOC, "unsampled: net bytes %ld allocs %lu frees %lu", unsampled_sz, unsampled_allocs, unsampled_frees);
+		cf_info(CF_ALLOC, "total mem_count: %ld (%.3f %s)", mc + unsampled_sz, quantity, scale);
+		cf_info(CF_ALLOC, "=============================================");
+	}
+
 #ifdef USE_MALLINFO
 	// Note: -- This only describes the main GLibC arena.
 	log_mallinfo();
@@ -1401,6 +1464,9 @@ mem_count_report(sort_field_t sort_field, int top_n, cf_dyn_buf *db)
 																 (CF_ALLOC_SORT_NET_ALLOC_COUNT == sort_field ? "net_count" :
 																  (CF_ALLOC_SORT_TOTAL_ALLOC_COUNT == sort_field ? "total_count" :
 																   (CF_ALLOC_SORT_TIME_LAST_MODIFIED == sort_field ? "time" : "???"))))));
+	if (g_mem_count_sample_rate > 1) {
+		cf_info(CF_ALLOC, "(sampled 1 in %u allocations - scale sizes and counts accordingly)", g_mem_count_sample_rate);
+	}
 	cf_info(CF_ALLOC, "---------------------");
 	for (int i = 0; i < MIN(report.num_records, report.top_n); i++) {
 		alloc_info_t *rec = &(report.u.l2a_output[i]);
@@ -1480,6 +1546,12 @@ update_alloc_at_location(void *p, size_t sz, alloc_type type, char *file, int li
 
 	cf_atomic64_add(&mem_count, (CF_ALLOC_TYPE_FREE != type ? sz : - sz));
 
+	if (CF_ALLOC_TYPE_FREE != type) {
+		cf_atomic32_incr(sampled_filter_slot(p));
+	} else {
+		cf_atomic32_decr(sampled_filter_slot(p));
+	}
+
 	location_t *loc = &alloc_loc.loc;
 	make_location(loc, file, line);
 	alloc_loc.sz = sz;
@@ -1530,6 +1602,122 @@ update_alloc_at_location(void *p, size_t sz, alloc_type type, char *file, int li
 	}
 }
 
+/* mem_count_sample
+ * Should the allocation about to be counted take the locked (sampled) path? */
+static inline bool
+mem_count_sample()
+{
+	if (g_mem_count_sample_rate <= 1) {
+		return true;
+	}
+
+	if (t_sample_countdown != 0) {
+		t_sample_countdown--;
+		return false;
+	}
+
+	t_sample_countdown = g_mem_count_sample_rate - 1;
+	return true;
+}
+
+/* sampled_size
+ * The size to account for a sampled allocation. While sampling, this is the
+ * usable size, as on the unsampled path, so the two sum to a consistent total. */
+static inline size_t
+sampled_size(void *p, size_t sz)
+{
+	return g_mem_count_sample_rate > 1 ? malloc_usable_size(p) : sz;
+}
+
+/* get_thread_mem_count
+ * Get (registering on first use) the calling thread's unsampled counts. */
+static inline thread_mem_count *
+get_thread_mem_count()
+{
+	if (!t_mem_count) {
+		uint32_t ix = cf_atomic32_incr(&g_n_thread_mem_counts) - 1;
+
+		t_mem_count = &g_thread_mem_counts[MIN(ix, MAX_THREAD_MEM_COUNTS - 1)];
+	}
+
+	return t_mem_count;
+}
+
+/* count_unsampled
+ * Lock-free accounting of an allocation (sz > 0) or free (sz < 0) that was not sampled. */
+static void
+count_unsampled(int64_t sz)
+{
+	thread_mem_count *tmc = get_thread_mem_count();
+
+	if (tmc != &g_thread_mem_counts[MAX_THREAD_MEM_COUNTS - 1]) {
+		tmc->net_sz += sz;
+		if (sz >= 0) {
+			tmc->n_allocs++;
+		} else {
+			tmc->n_frees++;
+		}
+	} else {
+		cf_atomic64_add((cf_atomic64 *) &tmc->net_sz, sz);
+		cf_atomic64_incr((cf_atomic64 *) (sz >= 0 ? &tmc->n_allocs : &tmc->n_frees));
+	}
+}
+
+/* sum_unsampled
+ * Sum the unsampled counts over all threads. */
+static void
+sum_unsampled(int64_t *net_sz, uint64_t *n_allocs, uint64_t *n_frees)
+{
+	uint32_t n = MIN(cf_atomic32_get(g_n_thread_mem_counts), MAX_THREAD_MEM_COUNTS);
+
+	*net_sz = 0;
+	*n_allocs = 0;
+	*n_frees = 0;
+
+	for (uint32_t i = 0; i < n; i++) {
+		*net_sz += g_thread_mem_counts[i].net_sz;
+		*n_allocs += g_thread_mem_counts[i].n_allocs;
+		*n_frees += g_thread_mem_counts[i].n_frees;
+	}
+}
+
+/* free_unsampled
+ * Free a pointer whose allocation was not sampled. Return true if freed, or
+ * false if the pointer may have been sampled and must take the locked path. */
+static bool
+free_unsampled(void *p)
+{
+	if (g_mem_count_sample_rate <= 1 || cf_atomic32_get(*sampled_filter_slot(p)) != 0) {
+		return false;
+	}
+
+	count_unsampled(- (int64_t) malloc_usable_size(p));
+	free(p);
+
+	return true;
+}
+
+/* mem_count_set_sample_rate
+ * Account for (and attribute) only about one in every sample_rate allocations
+ * under mem_count_lock. A sample rate of 0 or 1 accounts for every allocation. */
+void
+mem_count_set_sample_rate(uint32_t sample_rate)
+{
+	if (sample_rate > 1) {
+		g_mem_count_ever_sampled = true;
+	}
+
+	g_mem_count_sample_rate = sample_rate == 0 ? 1 : sample_rate;
+}
+
+/* mem_count_get_sample_rate
+ * Get the current memory accounting sample rate. */
+uint32_t
+mem_count_get_sample_rate()
+{
+	return g_mem_count_sample_rate;
+}
+
 void *
 cf_malloc_at(size_t sz, int arena, char *file, int line)
 {
@@ -1543,11 +1731,19 @@ cf_malloc_at(size_t sz, int arena, char *file, int line)
 		return(p);
 	}
 
+	if (!mem_count_sample()) {
+		if (p) {
+			count_unsampled(malloc_usable_size(p));
+		}
+		return(p);
+	}
+
 	pthread_mutex_lock(&mem_count_lock);
 	cf_atomic64_incr(&mem_count_mallocs);
 
 	if (p) {
 		int rv;
+		sz = sampled_size(p, sz);
 		if (SHASH_OK == (rv = shash_put_unique(mem_count_shash, &p, &sz))) {
 			update_alloc_at_location(p, sz, CF_ALLOC_TYPE_MALLOC, file, line);
 		} else {
@@ -1584,6 +1780,10 @@ cf_free_at(void *p, char *file, int line)
 		return;
 	}
 
+	if (free_unsampled(p)) {
+		return;
+	}
+
 	pthread_mutex_lock(&mem_count_lock);
 
 	size_t sz = 0;
@@ -1592,6 +1792,10 @@ cf_free_at(void *p, char *file, int line)
 		cf_atomic64_incr(&mem_count_frees);
 		update_alloc_at_location(p, sz, CF_ALLOC_TYPE_FREE, file, line);
 		free(p);
+	} else if (g_mem_count_ever_sampled) {
+		// Not sampled - either a filter false positive or sampling was since turned off.
+		count_unsampled(- (int64_t) malloc_usable_size(p));
+		free(p);
 	} else {
 #ifdef STRICT_MEMORY_ACCOUNTING
 		cf_crash(CF_ALLOC, "Could not find pointer %p in mem_count_shash @ %s:%d", p, file, line);
@@ -1620,10 +1824,18 @@ cf_calloc_at(size_t nmemb, size_t sz, int arena, char *file, int line)
 		return(p);
 	}
 
+	if (!mem_count_sample()) {
+		if (p) {
+			count_unsampled(malloc_usable_size(p));
+		}
+		return(p);
+	}
+
 	pthread_mutex_lock(&mem_count_lock);
 	cf_atomic64_incr(&mem_count_callocs);
 
 	if (p) {
+		sz = sampled_size(p, sz);
 		if (SHASH_OK == shash_put_unique(mem_count_shash, &p, &sz)) {
 			update_alloc_at_location(p, sz, CF_ALLOC_TYPE_CALLOC, file, line);
 		} else {
@@ -1639,9 +1851,76 @@ cf_calloc_at(size_t nmemb, size_t sz, int arena, char *file, int line)
 	return(p);
 }
 
+/* realloc_sampled
+ * Sampled accounting version of cf_realloc_at(). Takes mem_count_lock only if
+ * the old block may have been sampled, or the new block is to be sampled. */
+static void *
+realloc_sampled(void *ptr, size_t sz, int arena, char *file, int line)
+{
+	size_t old_sz = ptr ? malloc_usable_size(ptr) : 0;
+	bool old_maybe_sampled = ptr && cf_atomic32_get(*sampled_filter_slot(ptr)) != 0;
+
+#ifdef USE_JEM
+	void *p = arena_realloc(ptr, sz, arena);
+#else
+	void *p = realloc(ptr, sz);
+#endif
+
+	// The old block is gone unless realloc() failed.
+	bool old_released = ptr && (p || !sz);
+	bool new_sampled = p && mem_count_sample();
+
+	if (!(old_released && old_maybe_sampled) && !new_sampled) {
+		if (old_released) {
+			count_unsampled(- (int64_t) old_sz);
+		}
+		if (p) {
+			count_unsampled(malloc_usable_size(p));
+		}
+		return(p);
+	}
+
+	pthread_mutex_lock(&mem_count_lock);
+	cf_atomic64_incr(&mem_count_reallocs);
+
+	if (old_released) {
+		size_t sampled_sz = 0;
+
+		if (old_maybe_sampled && SHASH_OK == shash_get_and_delete(mem_count_shash, &ptr, &sampled_sz)) {
+			cf_atomic64_incr(&mem_count_frees);
+			update_alloc_at_location(ptr, sampled_sz, CF_ALLOC_TYPE_FREE, file, line);
+		} else {
+			count_unsampled(- (int64_t) old_sz);
+		}
+	}
+
+	if (new_sampled) {
+		sz = sampled_size(p, sz);
+		if (SHASH_OK == shash_put_unique(mem_count_shash, &p, &sz)) {
+			cf_atomic64_incr(&mem_count_mallocs);
+			update_alloc_at_location(p, sz, ptr ? CF_ALLOC_TYPE_REALLOC : CF_ALLOC_TYPE_MALLOC, file, line);
+		} else {
+#ifdef STRICT_MEMORY_ACCOUNTING
+			cf_crash(CF_ALLOC, "Could not add ptr: %p sz: %zu to mem_count_shash @ %s:%d", p, sz, file, line);
+#else
+			cf_warning(CF_ALLOC, "Could not add ptr: %p sz: %zu to mem_count_shash @ %s:%d [IGNORED]", p, sz, file, line);
+#endif
+		}
+	} else if (p) {
+		count_unsampled(malloc_usable_size(p));
+	}
+
+	pthread_mutex_unlock(&mem_count_lock);
+	return(p);
+}
+
 void *
 cf_realloc_at(void *ptr, size_t sz, int arena, char *file, int line)
 {
+	if (g_memory_accounting_enabled && g_mem_count_sample_rate > 1) {
+		return realloc_sampled(ptr, sz, arena, file, line);
+	}
+
 #ifdef USE_JEM
 	void *p = arena_realloc(ptr, sz, arena);
 #else
@@ -1744,6 +2023,13 @@ cf_strdup_at(const char *s, char *file, int line)
 		return(p);
 	}
 
+	if (!mem_count_sample()) {
+		if (p) {
+			count_unsampled(malloc_usable_size(p));
+		}
+		return(p);
+	}
+
 	pthread_mutex_lock(&mem_count_lock);
 
 	size_t sz = strlen(s) + 1;
@@ -1751,6 +2037,7 @@ cf_strdup_at(const char *s, char *file, int line)
 	cf_atomic64_incr(&mem_count_strdups);
 
 	if (p) {
+		sz = sampled_size(p, sz);
 		if (SHASH_OK == shash_put_unique(mem_count_shash, &p, &sz)) {
 			update_alloc_at_location(p, sz, CF_ALLOC_TYPE_STRDUP, file, line);
 		} else {
@@ -1783,6 +2070,13 @@ cf_strndup_at(const char *s, size_t n, char *file, int line)
 		return(p);
 	}
 
+	if (!mem_count_sample()) {
+		if (p) {
+			count_unsampled(malloc_usable_size(p));
+		}
+		return(p);
+	}
+
 	pthread_mutex_lock(&mem_count_lock);
 
 	size_t sz = MIN(n, strlen(s)) + 1;
@@ -1790,6 +2084,7 @@ cf_strndup_at(const char *s, size_t n, char *file, int line)
 	cf_atomic64_incr(&mem_count_strndups);
 
 	if (p) {
+		sz = sampled_size(p, sz);
 		if (SHASH_OK == shash_put_unique(mem_count_shash, &p, &sz)) {
 			update_alloc_at_location(p, sz, CF_ALLOC_TYPE_STRNDUP, file, line);
 		} else {
@@ -1818,10 +2113,20 @@ cf_valloc_at(size_t sz, char *file, int line)
 		}
 	}
 
+	if (!mem_count_sample()) {
+		if (0 == posix_memalign(&p, VALLOC_SZ, sz)) {
+			count_unsampled(malloc_usable_size(p));
+			return(p);
+		} else {
+			return(0);
+		}
+	}
+
 	pthread_mutex_lock(&mem_count_lock);
 	cf_atomic64_incr(&mem_count_vallocs);
 
 	if (0 == posix_memalign(&p, VALLOC_SZ, sz)) {
+		sz = sampled_size(p, sz);
 		if (SHASH_OK == shash_put_unique(mem_count_shash, &p, &sz)) {
 			update_alloc_at_location(p, sz, CF_ALLOC_TYPE_VALLOC, file, line);
 		} else {
@@ -38,6 +38,8 @@
 #include <string.h>
 #include <sys/types.h>
 
+#include "citrusleaf/alloc.h"
+
 #include "fault.h"
 
 
@@ -56,9 +58,60 @@ const char* ARENAX_ERR_STRINGS[] = {
 	"error creating stage",
 	"error attaching stage",
 	"error detaching stage",
+	"error reading or writing checkpoint",
 	"unknown error"
 };
 
+// Per-thread magazines (CF_ARENAX_MAGAZINES) - handles per magazine, and
+// arenas a thread can keep a magazine for.
+#define MAG_CAPACITY 64
+#define MAX_THREAD_MAGS 8
+
+
+//==========================================================
+// Typedefs
+//
+
+typedef struct arenax_mag_s {
+	cf_arenax*			arena;
+	uint32_t			n_handles;
+	cf_arenax_handle	handles[MAG_CAPACITY];
+} arenax_mag;
+
+typedef struct arenax_thread_mags_s {
+	struct arenax_thread_mags_s* next; // in the registry of all threads' mags
+	struct arenax_thread_mags_s* prev;
+	arenax_mag			mags[MAX_THREAD_MAGS];
+} arenax_thread_mags;
+
+
+//==========================================================
+// Globals
+//
+
+static pthread_key_t g_mags_key;
+static pthread_once_t g_mags_once = PTHREAD_ONCE_INIT;
+
+// Registry of all threads' magazines, so cf_arenax_drain_mags() can reach
+// them. Lock order is registry lock, then arena lock.
+static pthread_mutex_t g_mags_lock = PTHREAD_MUTEX_INITIALIZER;
+static arenax_thread_mags* g_mags_head = NULL;
+
+
+//==========================================================
+// Forward Declarations
+//
+
+static cf_arenax_err create(cf_arenax* this, key_t key_base,
+		const char* file_base, uint32_t element_size, uint32_t stage_capacity,
+		uint32_t max_stages, uint32_t flags);
+static cf_arenax_handle alloc_element(cf_arenax* this);
+static arenax_mag* get_mag(cf_arenax* this);
+static bool mag_refill(cf_arenax* this, arenax_mag* mag);
+static void mag_flush(cf_arenax* this, arenax_mag* mag, uint32_t n);
+static bool has_free_element(cf_arenax* this);
+static void push_free_element(cf_arenax* this, cf_arenax_handle h);
+
 
 //==========================================================
 // Public API
@@ -95,6 +148,325 @@ cf_arenax_errstr(cf_arenax_err err)
 cf_arenax_err
 cf_arenax_create(cf_arenax* this, key_t key_base, uint32_t element_size,
 		uint32_t stage_capacity, uint32_t max_stages, uint32_t flags)
+{
+	return create(this, key_base, NULL, element_size, stage_capacity,
+			max_stages, flags);
+}
+
+//------------------------------------------------
+// Create a cf_arenax object whose stages are files
+// mapped from file_base, e.g. on a local NVMe or
+// pmem filesystem. (file_base must outlive the
+// arena.) Stages can then be checkpointed by
+// cf_arenax_checkpoint() and re-attached after a
+// restart by cf_arenax_resume_mapped().
+//
+cf_arenax_err
+cf_arenax_create_mapped(cf_arenax* this, const char* file_base,
+		uint32_t element_size, uint32_t stage_capacity, uint32_t max_stages,
+		uint32_t flags)
+{
+	return create(this, 0, file_base, element_size, stage_capacity,
+			max_stages, flags);
+}
+
+//------------------------------------------------
+// Allocate an element within the arena.
+//
+cf_arenax_handle
+cf_arenax_alloc(cf_arenax* this)
+{
+	arenax_mag* mag = (this->flags & CF_ARENAX_MAGAZINES) != 0 ?
+			get_mag(this) : NULL;
+
+	cf_arenax_handle h;
+
+	if (mag) {
+		if (mag->n_handles == 0 && ! mag_refill(this, mag)) {
+			return 0;
+		}
+
+		h = mag->handles[--mag->n_handles];
+	}
+	else {
+		if ((this->flags & CF_ARENAX_BIGLOCK) &&
+				pthread_mutex_lock(&this->lock) != 0) {
+			return 0;
+		}
+
+		h = alloc_element(this);
+
+		if (this->flags & CF_ARENAX_BIGLOCK) {
+			pthread_mutex_unlock(&this->lock);
+		}
+
+		if (h == 0) {
+			return 0;
+		}
+	}
+
+	if (this->flags & CF_ARENAX_CALLOC) {
+		memset(cf_arenax_resolve(this, h), 0, this->element_size);
+	}
+
+	return h;
+}
+
+//------------------------------------------------
+// Free an element.
+//
+void
+cf_arenax_free(cf_arenax* this, cf_arenax_handle h)
+{
+	arenax_mag* mag = (this->flags & CF_ARENAX_MAGAZINES) != 0 ?
+			get_mag(this) : NULL;
+
+	if (mag) {
+		if (mag->n_handles == MAG_CAPACITY) {
+			mag_flush(this, mag, MAG_CAPACITY / 2);
+		}
+
+		((free_element*)cf_arenax_resolve(this, h))->magic = FREE_MAGIC;
+		mag->handles[mag->n_handles++] = h;
+		return;
+	}
+
+	if ((this->flags & CF_ARENAX_BIGLOCK) &&
+			pthread_mutex_lock(&this->lock) != 0) {
+		// TODO - function doesn't return failure - just press on?
+		return;
+	}
+
+	push_free_element(this, h);
+
+	if (this->flags & CF_ARENAX_BIGLOCK) {
+		pthread_mutex_unlock(&this->lock);
+	}
+}
+
+//------------------------------------------------
+// End-allocate a run of up to *p_n contiguous
+// elements, for callers that want related elements
+// on the same pages. The run never spans stages -
+// *p_n is set to the number actually allocated.
+// Returns 0 if there are free elements (reuse them
+// first - caller should allocate singly) or if a
+// stage can't be added.
+//
+cf_arenax_handle
+cf_arenax_alloc_run(cf_arenax* this, uint32_t* p_n)
+{
+	if ((this->flags & CF_ARENAX_BIGLOCK) &&
+			pthread_mutex_lock(&this->lock) != 0) {
+		return 0;
+	}
+
+	cf_arenax_handle h = 0;
+	uint32_t n = 0;
+
+	if (! has_free_element(this) && (this->at_element_id < this->stage_capacity ||
+			cf_arenax_add_stage(this) == CF_ARENAX_OK)) {
+		if (this->at_element_id >= this->stage_capacity) {
+			this->at_stage_id++;
+			this->at_element_id = 0;
+		}
+
+		n = this->stage_capacity - this->at_element_id;
+
+		if (n > *p_n) {
+			n = *p_n;
+		}
+
+		cf_arenax_set_handle(&h, this->at_stage_id, this->at_element_id);
+
+		this->at_element_id += n;
+	}
+
+	if (this->flags & CF_ARENAX_BIGLOCK) {
+		pthread_mutex_unlock(&this->lock);
+	}
+
+	if (h == 0) {
+		return 0;
+	}
+
+	if (this->flags & CF_ARENAX_CALLOC) {
+		memset(cf_arenax_resolve(this, h), 0, n * this->element_size);
+	}
+
+	*p_n = n;
+
+	return h;
+}
+
+//------------------------------------------------
+// Free a run of n contiguous elements, e.g. the
+// unused part of a cf_arenax_alloc_run() run. Goes
+// straight to its stage's free list, bypassing
+// magazines.
+//
+void
+cf_arenax_free_run(cf_arenax* this, cf_arenax_handle h, uint32_t n)
+{
+	if (n == 0) {
+		return;
+	}
+
+	// Chain the run before taking the lock, so the lock only covers the
+	// splice.
+	for (uint32_t i = 0; i < n; i++) {
+		free_element* p_free_element = cf_arenax_resolve(this, h + i);
+
+		p_free_element->magic = FREE_MAGIC;
+		p_free_element->next_h = h + i + 1;
+	}
+
+	free_element* p_last = cf_arenax_resolve(this, h + n - 1);
+
+	if ((this->flags & CF_ARENAX_BIGLOCK) &&
+			pthread_mutex_lock(&this->lock) != 0) {
+		return;
+	}
+
+	uint32_t stage_id = (uint32_t)(h >> ELEMENT_ID_NUM_BITS);
+
+	p_last->next_h = this->free_h[stage_id];
+	this->free_h[stage_id] = h;
+	this->n_free[stage_id] += n;
+
+	if (stage_id < this->free_stage_id) {
+		this->free_stage_id = stage_id;
+	}
+
+	if (this->flags & CF_ARENAX_BIGLOCK) {
+		pthread_mutex_unlock(&this->lock);
+	}
+}
+
+//------------------------------------------------
+// Convert cf_arenax_handle to memory address.
+//
+void*
+cf_arenax_resolve(cf_arenax* this, cf_arenax_handle h)
+{
+	return this->stages[h >> ELEMENT_ID_NUM_BITS] +
+			((h & ELEMENT_ID_MASK) * this->element_size);
+}
+
+//------------------------------------------------
+// Release stages at the end of the arena that have
+// nothing allocated. Each stage keeps its own free
+// list and free count, so this is a check of the
+// trailing stages' counts under the lock - nothing
+// is walked or moved. Returns the number of stages
+// released.
+//
+// Only an all-free tail is released. A stage with
+// a single live element is kept, as is everything
+// below it, so this does not give back memory after
+// scattered deletes - allocating from the lowest
+// stage with free elements only makes a free tail
+// more likely over time.
+//
+// Elements cached in other threads' magazines count
+// as allocated, so their stages are kept.
+//
+uint32_t
+cf_arenax_trim(cf_arenax* this)
+{
+	// Return this thread's cached handles first.
+	if ((this->flags & CF_ARENAX_MAGAZINES) != 0) {
+		arenax_mag* mag = get_mag(this);
+
+		if (mag && mag->n_handles != 0) {
+			mag_flush(this, mag, mag->n_handles);
+		}
+	}
+
+	if ((this->flags & CF_ARENAX_BIGLOCK) &&
+			pthread_mutex_lock(&this->lock) != 0) {
+		return 0;
+	}
+
+	uint32_t n_stages = this->stage_count;
+
+	// Never release stage 0. Stages before the one being end-allocated are
+	// full.
+	while (this->stage_count > 1) {
+		uint32_t stage_id = this->stage_count - 1;
+		uint32_t n_used = stage_id == this->at_stage_id ?
+				this->at_element_id : this->stage_capacity;
+
+		if (this->n_free[stage_id] != n_used) {
+			break;
+		}
+
+		this->free_h[stage_id] = 0;
+		this->n_free[stage_id] = 0;
+
+		cf_arenax_remove_stage(this);
+
+		// The new last stage was fully end-allocated - the next end-allocation
+		// adds a stage.
+		this->at_stage_id = this->stage_count - 1;
+		this->at_element_id = this->stage_capacity;
+	}
+
+	uint32_t n_released = n_stages - this->stage_count;
+
+	if (this->flags & CF_ARENAX_BIGLOCK) {
+		pthread_mutex_unlock(&this->lock);
+	}
+
+	return n_released;
+}
+
+
+//==========================================================
+// Private API - for enterprise separation only
+//
+
+//------------------------------------------------
+// Return the handles all threads' magazines hold
+// for this arena to its free lists. Caller must
+// make sure nothing allocates or frees meanwhile,
+// e.g. before a checkpoint at shutdown.
+//
+void
+cf_arenax_drain_mags(cf_arenax* this)
+{
+	if ((this->flags & CF_ARENAX_MAGAZINES) == 0) {
+		return;
+	}
+
+	pthread_mutex_lock(&g_mags_lock);
+
+	for (arenax_thread_mags* tm = g_mags_head; tm; tm = tm->next) {
+		for (uint32_t i = 0; i < MAX_THREAD_MAGS; i++) {
+			arenax_mag* mag = &tm->mags[i];
+
+			if (mag->arena == this && mag->n_handles != 0) {
+				mag_flush(this, mag, mag->n_handles);
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&g_mags_lock);
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+//------------------------------------------------
+// Shared by the constructors - initialize and add
+// the first stage.
+//
+static cf_arenax_err
+create(cf_arenax* this, key_t key_base, const char* file_base,
+		uint32_t element_size, uint32_t stage_capacity, uint32_t max_stages,
+		uint32_t flags)
 {
 	if (stage_capacity == 0) {
 		stage_capacity = MAX_STAGE_CAPACITY;
@@ -120,6 +492,7 @@ cf_arenax_create(cf_arenax* this, key_t key_base, uint32_t element_size,
 	}
 
 	this->key_base = key_base;
+	this->file_base = file_base;
 	this->element_size = element_size;
 	this->stage_capacity = stage_capacity;
 	this->max_stages = max_stages;
@@ -127,7 +500,9 @@ cf_arenax_create(cf_arenax* this, key_t key_base, uint32_t element_size,
 
 	this->stage_size = (size_t)stage_size;
 
-	this->free_h = 0;
+	memset(this->free_h, 0, sizeof(this->free_h));
+	memset(this->n_free, 0, sizeof(this->n_free));
+	this->free_stage_id = 0;
 
 	// Skip 0:0 so null handle is never used.
 	this->at_stage_id = 0;
@@ -157,34 +532,67 @@ cf_arenax_create(cf_arenax* this, key_t key_base, uint32_t element_size,
 }
 
 //------------------------------------------------
-// Allocate an element within the arena.
+// Free lists. Caller holds the lock (if any).
 //
-cf_arenax_handle
-cf_arenax_alloc(cf_arenax* this)
+// Each stage has its own free list and free count.
+// Elements are taken from the lowest stage with a
+// free element, so higher stages drain first.
+//
+
+// Also moves the lowest-free-stage hint up past empty lists.
+static bool
+has_free_element(cf_arenax* this)
 {
-	if ((this->flags & CF_ARENAX_BIGLOCK) &&
-			pthread_mutex_lock(&this->lock) != 0) {
-		return 0;
+	while (this->free_stage_id < this->stage_count &&
+			this->free_h[this->free_stage_id] == 0) {
+		this->free_stage_id++;
 	}
 
+	return this->free_stage_id < this->stage_count;
+}
+
+static void
+push_free_element(cf_arenax* this, cf_arenax_handle h)
+{
+	uint32_t stage_id = (uint32_t)(h >> ELEMENT_ID_NUM_BITS);
+	free_element* p_free_element = cf_arenax_resolve(this, h);
+
+	p_free_element->magic = FREE_MAGIC;
+	p_free_element->next_h = this->free_h[stage_id];
+	this->free_h[stage_id] = h;
+	this->n_free[stage_id]++;
+
+	if (stage_id < this->free_stage_id) {
+		this->free_stage_id = stage_id;
+	}
+}
+
+//------------------------------------------------
+// Take an element from the free lists, or failing
+// that, end-allocate. Caller holds the lock (if
+// any). Returns 0 if a new stage is needed and
+// can't be added.
+//
+static cf_arenax_handle
+alloc_element(cf_arenax* this)
+{
 	cf_arenax_handle h;
 
-	// Check free list first.
-	if (this->free_h != 0) {
-		h = this->free_h;
+	// Check free lists first.
+	if (has_free_element(this)) {
+		uint32_t stage_id = this->free_stage_id;
+
+		h = this->free_h[stage_id];
 
 		free_element* p_free_element = cf_arenax_resolve(this, h);
 
-		this->free_h = p_free_element->next_h;
+		this->free_h[stage_id] = p_free_element->next_h;
+		this->n_free[stage_id]--;
 	}
 	// Otherwise keep end-allocating.
 	else {
 		if (this->at_element_id >= this->stage_capacity) {
 			if (cf_arenax_add_stage(this) != CF_ARENAX_OK) {
-				if (this->flags & CF_ARENAX_BIGLOCK) {
-					pthread_mutex_unlock(&this->lock);
-				}
-
 				return 0;
 			}
 
@@ -197,46 +605,153 @@ cf_arenax_alloc(cf_arenax* this)
 		this->at_element_id++;
 	}
 
-	if (this->flags & CF_ARENAX_BIGLOCK) {
-		pthread_mutex_unlock(&this->lock);
+	return h;
+}
+
+//------------------------------------------------
+// Per-thread magazines.
+//
+// With CF_ARENAX_MAGAZINES, each thread keeps a
+// small stack of free handles per arena. Allocs
+// and frees work on it without the arena lock,
+// which is only taken to refill an empty magazine
+// or to return half of a full one - once per
+// MAG_CAPACITY / 2 operations at worst.
+//
+// A thread's magazines go back to their arenas'
+// free lists when the thread exits. (Arenas must
+// therefore outlive all threads that use them.)
+//
+
+static void
+mags_destroy(void* udata)
+{
+	arenax_thread_mags* tm = (arenax_thread_mags*)udata;
+
+	// Hold the registry lock throughout, so a concurrent drain can't flush
+	// these magazines too.
+	pthread_mutex_lock(&g_mags_lock);
+
+	for (uint32_t i = 0; i < MAX_THREAD_MAGS; i++) {
+		arenax_mag* mag = &tm->mags[i];
+
+		if (mag->arena && mag->n_handles != 0) {
+			mag_flush(mag->arena, mag, mag->n_handles);
+		}
 	}
 
-	if (this->flags & CF_ARENAX_CALLOC) {
-		memset(cf_arenax_resolve(this, h), 0, this->element_size);
+	if (tm->prev) {
+		tm->prev->next = tm->next;
+	}
+	else {
+		g_mags_head = tm->next;
 	}
 
-	return h;
+	if (tm->next) {
+		tm->next->prev = tm->prev;
+	}
+
+	pthread_mutex_unlock(&g_mags_lock);
+
+	cf_free(tm);
 }
 
-//------------------------------------------------
-// Free an element.
-//
-void
-cf_arenax_free(cf_arenax* this, cf_arenax_handle h)
+static void
+mags_key_init()
 {
-	free_element* p_free_element = cf_arenax_resolve(this, h);
+	pthread_key_create(&g_mags_key, mags_destroy);
+}
+
+// Returns NULL if this thread already has magazines for too many arenas -
+// caller then goes straight to the arena.
+static arenax_mag*
+get_mag(cf_arenax* this)
+{
+	pthread_once(&g_mags_once, mags_key_init);
+
+	arenax_thread_mags* tm =
+			(arenax_thread_mags*)pthread_getspecific(g_mags_key);
+
+	if (! tm) {
+		if (! (tm = cf_calloc(1, sizeof(arenax_thread_mags)))) {
+			return NULL;
+		}
+
+		pthread_mutex_lock(&g_mags_lock);
+
+		tm->next = g_mags_head;
+
+		if (g_mags_head) {
+			g_mags_head->prev = tm;
+		}
 
+		g_mags_head = tm;
+
+		pthread_mutex_unlock(&g_mags_lock);
+
+		pthread_setspecific(g_mags_key, tm);
+	}
+
+	for (uint32_t i = 0; i < MAX_THREAD_MAGS; i++) {
+		arenax_mag* mag = &tm->mags[i];
+
+		if (mag->arena == this) {
+			return mag;
+		}
+
+		if (! mag->arena) {
+			mag->arena = this;
+			return mag;
+		}
+	}
+
+	return NULL;
+}
+
+static bool
+mag_refill(cf_arenax* this, arenax_mag* mag)
+{
 	if ((this->flags & CF_ARENAX_BIGLOCK) &&
 			pthread_mutex_lock(&this->lock) != 0) {
-		// TODO - function doesn't return failure - just press on?
-		return;
+		return false;
 	}
 
-	p_free_element->magic = FREE_MAGIC;
-	p_free_element->next_h = this->free_h;
-	this->free_h = h;
+	while (mag->n_handles < MAG_CAPACITY / 2) {
+		cf_arenax_handle h = alloc_element(this);
+
+		if (h == 0) {
+			break;
+		}
+
+		mag->handles[mag->n_handles++] = h;
+	}
 
 	if (this->flags & CF_ARENAX_BIGLOCK) {
 		pthread_mutex_unlock(&this->lock);
 	}
+
+	return mag->n_handles != 0;
 }
 
-//------------------------------------------------
-// Convert cf_arenax_handle to memory address.
-//
-void*
-cf_arenax_resolve(cf_arenax* this, cf_arenax_handle h)
+// Return the oldest n handles to their stages' free lists.
+static void
+mag_flush(cf_arenax* this, arenax_mag* mag, uint32_t n)
 {
-	return this->stages[h >> ELEMENT_ID_NUM_BITS] +
-			((h & ELEMENT_ID_MASK) * this->element_size);
+	// Callers rely on the handles leaving the magazine - can't bail out.
+	if ((this->flags & CF_ARENAX_BIGLOCK) &&
+			pthread_mutex_lock(&this->lock) != 0) {
+		cf_crash(CF_ARENAX, "failed arena lock");
+	}
+
+	for (uint32_t i = 0; i < n; i++) {
+		push_free_element(this, mag->handles[i]);
+	}
+
+	if (this->flags & CF_ARENAX_BIGLOCK) {
+		pthread_mutex_unlock(&this->lock);
+	}
+
+	mag->n_handles -= n;
+	memmove(mag->handles, mag->handles + n,
+			mag->n_handles * sizeof(cf_arenax_handle));
 }
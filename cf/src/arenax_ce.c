@@ -22,11 +22,233 @@
 
 #include "arenax.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include "citrusleaf/alloc.h"
 #include "fault.h"
 
 
+//==========================================================
+// Typedefs & constants.
+//
+
+#define CHECKPOINT_MAGIC	0xA4E7C4E7
+#define CHECKPOINT_VERSION	2
+
+// Written (atomically) to "<file_base>-arena" by cf_arenax_checkpoint().
+typedef struct arenax_checkpoint_s {
+	uint32_t			magic;
+	uint32_t			version;
+	uint64_t			token;
+	uint32_t			element_size;
+	uint32_t			stage_capacity;
+	uint32_t			max_stages;
+	uint32_t			stage_count;
+	uint32_t			at_stage_id;
+	uint32_t			at_element_id;
+	cf_arenax_handle	free_h[CF_ARENAX_MAX_STAGES];
+	uint32_t			n_free[CF_ARENAX_MAX_STAGES];
+} arenax_checkpoint;
+
+
+//==========================================================
+// Forward declarations.
+//
+
+static uint8_t* map_stage(cf_arenax* this, uint32_t stage_id, bool create);
+static void unmap_stages(cf_arenax* this);
+static void stage_path(const char* file_base, uint32_t stage_id, char* path);
+static void checkpoint_path(const char* file_base, const char* suffix,
+		char* path);
+
+
+//==========================================================
+// Public API.
+//
+
+//------------------------------------------------
+// Write a checkpoint from which a file-backed
+// arena can be resumed after a restart. Caller
+// must make sure nothing allocates, frees, or
+// writes elements meanwhile. Stages are synced
+// before the checkpoint file is (atomically)
+// written, so a crash at any point leaves either
+// no checkpoint or a complete one.
+//
+// Handles cached in thread magazines are returned
+// to the free lists first, so a resumed arena
+// doesn't lose them.
+//
+cf_arenax_err
+cf_arenax_checkpoint(cf_arenax* this, uint64_t token)
+{
+	if (! this->file_base) {
+		cf_warning(CF_ARENAX, "can't checkpoint arena that isn't file-backed");
+		return CF_ARENAX_ERR_BAD_PARAM;
+	}
+
+	cf_arenax_drain_mags(this);
+
+	for (uint32_t i = 0; i < this->stage_count; i++) {
+		if (msync(this->stages[i], this->stage_size, MS_SYNC) != 0) {
+			cf_warning(CF_ARENAX, "failed sync of arena stage %u: %s", i,
+					cf_strerror(errno));
+			return CF_ARENAX_ERR_CHECKPOINT;
+		}
+	}
+
+	arenax_checkpoint ckpt = {
+			.magic = CHECKPOINT_MAGIC,
+			.version = CHECKPOINT_VERSION,
+			.token = token,
+			.element_size = this->element_size,
+			.stage_capacity = this->stage_capacity,
+			.max_stages = this->max_stages,
+			.stage_count = this->stage_count,
+			.at_stage_id = this->at_stage_id,
+			.at_element_id = this->at_element_id
+	};
+
+	memcpy(ckpt.free_h, this->free_h, sizeof(ckpt.free_h));
+	memcpy(ckpt.n_free, this->n_free, sizeof(ckpt.n_free));
+
+	char tmp_path[PATH_MAX];
+	char path[PATH_MAX];
+
+	checkpoint_path(this->file_base, ".tmp", tmp_path);
+	checkpoint_path(this->file_base, "", path);
+
+	int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+
+	if (fd == -1) {
+		cf_warning(CF_ARENAX, "can't open %s: %s", tmp_path,
+				cf_strerror(errno));
+		return CF_ARENAX_ERR_CHECKPOINT;
+	}
+
+	if (write(fd, &ckpt, sizeof(ckpt)) != (ssize_t)sizeof(ckpt) ||
+			fsync(fd) != 0) {
+		cf_warning(CF_ARENAX, "failed write of %s: %s", tmp_path,
+				cf_strerror(errno));
+		close(fd);
+		unlink(tmp_path);
+		return CF_ARENAX_ERR_CHECKPOINT;
+	}
+
+	close(fd);
+
+	if (rename(tmp_path, path) != 0) {
+		cf_warning(CF_ARENAX, "can't rename %s: %s", tmp_path,
+				cf_strerror(errno));
+		unlink(tmp_path);
+		return CF_ARENAX_ERR_CHECKPOINT;
+	}
+
+	return CF_ARENAX_OK;
+}
+
+//------------------------------------------------
+// Re-attach the stages of a file-backed arena as
+// of its last checkpoint. The checkpoint must have
+// been written with the same token. It is consumed
+// (removed) whether or not resuming succeeds - the
+// stages are about to change, and a crash from
+// here on must not leave a stale checkpoint.
+//
+cf_arenax_err
+cf_arenax_resume_mapped(cf_arenax* this, const char* file_base,
+		uint32_t element_size, uint32_t flags, uint64_t token)
+{
+	char path[PATH_MAX];
+
+	checkpoint_path(file_base, "", path);
+
+	int fd = open(path, O_RDONLY);
+
+	if (fd == -1) {
+		cf_info(CF_ARENAX, "no arena checkpoint %s", path);
+		return CF_ARENAX_ERR_CHECKPOINT;
+	}
+
+	arenax_checkpoint ckpt;
+	ssize_t n_read = read(fd, &ckpt, sizeof(ckpt));
+
+	close(fd);
+	unlink(path);
+
+	if (n_read != (ssize_t)sizeof(ckpt) || ckpt.magic != CHECKPOINT_MAGIC ||
+			ckpt.version != CHECKPOINT_VERSION) {
+		cf_warning(CF_ARENAX, "bad arena checkpoint %s", path);
+		return CF_ARENAX_ERR_CHECKPOINT;
+	}
+
+	if (ckpt.token != token || ckpt.element_size != element_size) {
+		cf_warning(CF_ARENAX, "arena checkpoint %s doesn't match", path);
+		return CF_ARENAX_ERR_CHECKPOINT;
+	}
+
+	if (ckpt.stage_capacity == 0 || ckpt.stage_capacity > MAX_STAGE_CAPACITY ||
+			ckpt.max_stages > CF_ARENAX_MAX_STAGES ||
+			ckpt.stage_count == 0 || ckpt.stage_count > ckpt.max_stages ||
+			ckpt.at_stage_id >= ckpt.stage_count) {
+		cf_warning(CF_ARENAX, "arena checkpoint %s has bad geometry", path);
+		return CF_ARENAX_ERR_CHECKPOINT;
+	}
+
+	this->key_base = 0;
+	this->file_base = file_base;
+	this->element_size = element_size;
+	this->stage_capacity = ckpt.stage_capacity;
+	this->max_stages = ckpt.max_stages;
+	this->flags = flags;
+
+	this->stage_size = (size_t)ckpt.stage_capacity * element_size;
+
+	memcpy(this->free_h, ckpt.free_h, sizeof(this->free_h));
+	memcpy(this->n_free, ckpt.n_free, sizeof(this->n_free));
+	this->free_stage_id = 0;
+
+	this->at_stage_id = ckpt.at_stage_id;
+	this->at_element_id = ckpt.at_element_id;
+
+	this->stage_count = 0;
+	memset(this->stages, 0, sizeof(this->stages));
+
+	for (uint32_t i = 0; i < ckpt.stage_count; i++) {
+		uint8_t* p_stage = map_stage(this, i, false);
+
+		if (! p_stage) {
+			unmap_stages(this);
+			return CF_ARENAX_ERR_STAGE_ATTACH;
+		}
+
+		this->stages[this->stage_count++] = p_stage;
+	}
+
+	if ((flags & CF_ARENAX_BIGLOCK) &&
+			pthread_mutex_init(&this->lock, 0) != 0) {
+		unmap_stages(this);
+		return CF_ARENAX_ERR_UNKNOWN;
+	}
+
+	return CF_ARENAX_OK;
+}
+
+
+//==========================================================
+// Private API - for enterprise separation only.
+//
+
 //------------------------------------------------
 // Create and attach a persistent memory block,
 // and store its pointer in the stages array.
@@ -40,7 +262,9 @@ cf_arenax_add_stage(cf_arenax* this)
 		return CF_ARENAX_ERR_STAGE_CREATE;
 	}
 
-	uint8_t* p_stage = (uint8_t*)cf_malloc(this->stage_size);
+	uint8_t* p_stage = this->file_base ?
+			map_stage(this, this->stage_count, true) :
+			(uint8_t*)cf_malloc(this->stage_size);
 
 	if (! p_stage) {
 		cf_warning(CF_ARENAX, "could not allocate %lu-byte arena stage %u",
@@ -52,3 +276,116 @@ cf_arenax_add_stage(cf_arenax* this)
 
 	return CF_ARENAX_OK;
 }
+
+//------------------------------------------------
+// Free the last stage and remove it from the
+// stages array.
+//
+void
+cf_arenax_remove_stage(cf_arenax* this)
+{
+	uint8_t* p_stage = this->stages[--this->stage_count];
+
+	this->stages[this->stage_count] = NULL;
+
+	if (this->file_base) {
+		char path[PATH_MAX];
+
+		stage_path(this->file_base, this->stage_count, path);
+		munmap(p_stage, this->stage_size);
+		unlink(path);
+	}
+	else {
+		cf_free(p_stage);
+	}
+}
+
+
+//==========================================================
+// Local helpers.
+//
+
+//------------------------------------------------
+// Map a stage file - a new (zeroed) one if create
+// is set, else an existing one of the right size.
+//
+static uint8_t*
+map_stage(cf_arenax* this, uint32_t stage_id, bool create)
+{
+	char path[PATH_MAX];
+
+	stage_path(this->file_base, stage_id, path);
+
+	int fd = open(path, create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR,
+			S_IRUSR | S_IWUSR);
+
+	if (fd == -1) {
+		cf_warning(CF_ARENAX, "can't open arena stage file %s: %s", path,
+				cf_strerror(errno));
+		return NULL;
+	}
+
+	if (create) {
+		if (ftruncate(fd, (off_t)this->stage_size) != 0) {
+			cf_warning(CF_ARENAX, "can't size arena stage file %s: %s", path,
+					cf_strerror(errno));
+			close(fd);
+			return NULL;
+		}
+	}
+	else {
+		struct stat st;
+
+		if (fstat(fd, &st) != 0 || (size_t)st.st_size != this->stage_size) {
+			cf_warning(CF_ARENAX, "arena stage file %s has wrong size", path);
+			close(fd);
+			return NULL;
+		}
+	}
+
+	void* p_stage = mmap(NULL, this->stage_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED, fd, 0);
+
+	close(fd);
+
+	if (p_stage == MAP_FAILED) {
+		cf_warning(CF_ARENAX, "can't map arena stage file %s: %s", path,
+				cf_strerror(errno));
+		return NULL;
+	}
+
+	// A device-resident stage is much bigger than the memory meant to cache
+	// it - index lookups are random, so don't waste page cache on readahead.
+	if ((this->flags & CF_ARENAX_DEVICE) != 0 &&
+			madvise(p_stage, this->stage_size, MADV_RANDOM) != 0) {
+		cf_warning(CF_ARENAX, "can't advise arena stage file %s: %s", path,
+				cf_strerror(errno));
+	}
+
+	return (uint8_t*)p_stage;
+}
+
+//------------------------------------------------
+// Unmap the stages mapped so far, leaving the
+// stage files in place.
+//
+static void
+unmap_stages(cf_arenax* this)
+{
+	while (this->stage_count != 0) {
+		munmap(this->stages[--this->stage_count], this->stage_size);
+		this->stages[this->stage_count] = NULL;
+	}
+}
+
+static void
+stage_path(const char* file_base, uint32_t stage_id, char* path)
+{
+	snprintf(path, PATH_MAX, "%s-stage-%03u", file_base, stage_id);
+}
+
+static void
+checkpoint_path(const char* file_base, const char* suffix, char* path)
+{
+	snprintf(path, PATH_MAX, "%s-arena%s", file_base, suffix);
+}
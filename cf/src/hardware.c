@@ -36,6 +36,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 
+#include <linux/mempolicy.h>
+
 #include "fault.h"
 #include "util.h"
 
@@ -234,6 +236,25 @@ read_list(const char *path, cpu_set_t *mask)
 	return CF_READ_FILE_OK;
 }
 
+// Make the calling thread - and threads it creates later - allocate memory
+// from the given NUMA node when possible. Preferred rather than bound, so a
+// full node spills to others rather than failing allocations.
+static void
+prefer_os_numa_node(cf_topo_os_numa_node_index i_os_numa_node)
+{
+	uint64_t mask[CPU_SETSIZE / 64] = { 0 };
+
+	mask[i_os_numa_node / 64] |= 1UL << (i_os_numa_node % 64);
+
+	if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask, CPU_SETSIZE) < 0) {
+		cf_warning(CF_MISC, "error while preferring OS NUMA node %hu for memory: %d (%s)",
+				i_os_numa_node, errno, cf_strerror(errno));
+		return;
+	}
+
+	cf_detail(CF_MISC, "preferring OS NUMA node %hu for memory", i_os_numa_node);
+}
+
 bool
 cf_topo_init(cf_topo_numa_node_index a_numa_node, bool pin)
 {
@@ -271,6 +292,7 @@ cf_topo_init(cf_topo_numa_node_index a_numa_node, bool pin)
 	}
 
 	uint16_t n_numa_nodes = 0;
+	cf_topo_os_numa_node_index pin_os_numa_node = 0;
 	g_n_cores = 0;
 	g_n_os_cpus = 0;
 	g_n_cpus = 0;
@@ -416,6 +438,8 @@ cf_topo_init(cf_topo_numa_node_index a_numa_node, bool pin)
 			continue;
 		}
 
+		pin_os_numa_node = i_os_numa_node;
+
 		// If the CPU is a new core, then map a new core index to the OS CPU index.
 
 		if (new_core) {
@@ -473,6 +497,10 @@ cf_topo_init(cf_topo_numa_node_index a_numa_node, bool pin)
 				a_numa_node, errno, cf_strerror(errno));
 	}
 
+	// Memory too - namespace index arenas, data-in-memory bins, and the rest
+	// are all allocated after this, so they'll be local to the pinned CPUs.
+	prefer_os_numa_node(pin_os_numa_node);
+
 	return true;
 }
 
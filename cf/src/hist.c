@@ -40,12 +40,21 @@
 // Histogram with logarithmic buckets.
 //
 
+// Each thread increments counts in its own shard of a sharded histogram
+// (shared only once there are more threads than shards).
+static __thread int g_shard_ix = -1;
+static cf_atomic32 g_next_shard_ix = 0;
+
 //------------------------------------------------
-// Create a histogram. There's no destroy(), but
-// you can just cf_free() the histogram.
+// Allocate and set up a histogram, or an object of
+// size sz that starts with one (cf_hist_track). The
+// shards follow in the same allocation - sharded
+// histograms are page-aligned, so shards start on
+// a cache line.
 //
 histogram*
-histogram_create(const char *name, histogram_scale scale)
+histogram_alloc(size_t sz, const char *name, histogram_scale scale,
+		bool sharded)
 {
 	if (! (name && strlen(name) < HISTOGRAM_NAME_SIZE)) {
 		return NULL;
@@ -55,14 +64,22 @@ histogram_create(const char *name, histogram_scale scale)
 		return NULL;
 	}
 
-	histogram *h = cf_malloc(sizeof(histogram));
+	uint32_t n_shards = sharded ? N_HIST_SHARDS : 1;
+	size_t shards_offset = (sz + 63) & ~(size_t)63;
+	size_t shards_sz = sizeof(histogram_shard) * n_shards;
+
+	histogram *h = sharded ?
+			cf_valloc(shards_offset + shards_sz) :
+			cf_malloc(shards_offset + shards_sz);
 
 	if (! h) {
 		return NULL;
 	}
 
 	strcpy(h->name, name);
-	memset((void *)&h->counts, 0, sizeof(h->counts));
+	h->n_shards = n_shards;
+	h->shards = (histogram_shard *)((uint8_t *)h + shards_offset);
+	memset((void *)h->shards, 0, shards_sz);
 
 	// If histogram_insert_data_point() is called for a size or count histogram,
 	// the divide by 0 will crash - consider that a high-performance assert.
@@ -92,15 +109,177 @@ histogram_create(const char *name, histogram_scale scale)
 	return h;
 }
 
+//------------------------------------------------
+// Create a histogram. There's no destroy(), but
+// you can just cf_free() the histogram.
+//
+histogram*
+histogram_create(const char *name, histogram_scale scale)
+{
+	return histogram_alloc(sizeof(histogram), name, scale, false);
+}
+
+//------------------------------------------------
+// Create a histogram with a shard of counts per
+// group of threads, for histograms inserted into
+// by many threads on the transaction path. Costs
+// N_HIST_SHARDS times the memory.
+//
+histogram*
+histogram_create_sharded(const char *name, histogram_scale scale)
+{
+	return histogram_alloc(sizeof(histogram), name, scale, true);
+}
+
 //------------------------------------------------
 // Clear a histogram.
 //
 void
 histogram_clear(histogram *h)
 {
+	for (uint32_t n = 0; n < h->n_shards; n++) {
+		for (int i = 0; i < N_BUCKETS; i++) {
+			for (int s = 0; s < N_SUB_BUCKETS; s++) {
+				cf_atomic64_set(&h->shards[n].counts[i][s], 0);
+			}
+		}
+	}
+}
+
+//------------------------------------------------
+// Sum the shards into sub-bucket counts. Returns
+// the total count.
+//
+static uint64_t
+get_sub_counts(histogram *h, uint64_t counts[N_BUCKETS][N_SUB_BUCKETS])
+{
+	memset(counts, 0, sizeof(uint64_t) * N_BUCKETS * N_SUB_BUCKETS);
+
+	uint64_t total_count = 0;
+
+	for (uint32_t n = 0; n < h->n_shards; n++) {
+		for (int i = 0; i < N_BUCKETS; i++) {
+			for (int s = 0; s < N_SUB_BUCKETS; s++) {
+				uint64_t count = cf_atomic64_get(h->shards[n].counts[i][s]);
+
+				counts[i][s] += count;
+				total_count += count;
+			}
+		}
+	}
+
+	return total_count;
+}
+
+//------------------------------------------------
+// Get the (logarithmic) bucket counts, summed over
+// shards and sub-buckets. The counts array must
+// have N_BUCKETS elements.
+//
+void
+histogram_get_counts(histogram *h, uint64_t counts[])
+{
+	uint64_t sub_counts[N_BUCKETS][N_SUB_BUCKETS];
+
+	get_sub_counts(h, sub_counts);
+
+	for (int i = 0; i < N_BUCKETS; i++) {
+		counts[i] = 0;
+
+		for (int s = 0; s < N_SUB_BUCKETS; s++) {
+			counts[i] += sub_counts[i][s];
+		}
+	}
+}
+
+//------------------------------------------------
+// Sub-bucket of a value in bucket b = msb(value).
+// In small buckets each value has its own sub-
+// bucket, in bigger ones it's the bits just below
+// the most significant bit.
+//
+static inline uint32_t
+sub_bucket(uint64_t value, int b)
+{
+	if (b == 0) {
+		return 0;
+	}
+
+	int shift = b - 1 - N_SUB_BUCKET_BITS;
+
+	if (shift < 0) {
+		return (uint32_t)(value - (1UL << (b - 1)));
+	}
+
+	return (uint32_t)((value >> shift) & (N_SUB_BUCKETS - 1));
+}
+
+//------------------------------------------------
+// Exclusive upper limit of the values counted in
+// sub-bucket s of bucket b.
+//
+static uint64_t
+sub_bucket_limit(int b, uint32_t s)
+{
+	if (b == 0) {
+		return 1;
+	}
+
+	int shift = b - 1 - N_SUB_BUCKET_BITS;
+
+	if (shift < 0) {
+		return (1UL << (b - 1)) + s + 1;
+	}
+
+	if (b == N_BUCKETS - 1 && s == N_SUB_BUCKETS - 1) {
+		return UINT64_MAX;
+	}
+
+	return ((uint64_t)N_SUB_BUCKETS + s + 1) << shift;
+}
+
+static uint64_t
+percentile(uint64_t counts[N_BUCKETS][N_SUB_BUCKETS], uint64_t total_count,
+		double pct)
+{
+	if (total_count == 0) {
+		return 0;
+	}
+
+	uint64_t rank = (uint64_t)((double)total_count * pct / 100.0);
+
+	if (rank == 0) {
+		rank = 1;
+	}
+
+	uint64_t subtotal = 0;
+
 	for (int i = 0; i < N_BUCKETS; i++) {
-		cf_atomic64_set(&h->counts[i], 0);
+		for (uint32_t s = 0; s < N_SUB_BUCKETS; s++) {
+			subtotal += counts[i][s];
+
+			if (subtotal >= rank) {
+				return sub_bucket_limit(i, s);
+			}
+		}
 	}
+
+	return UINT64_MAX;
+}
+
+//------------------------------------------------
+// Get the value (in the histogram's units) below
+// which pct percent of data points fall. Accurate
+// to the sub-bucket - the limit returned is the
+// sub-bucket's exclusive upper limit.
+//
+uint64_t
+histogram_get_percentile(histogram *h, double pct)
+{
+	uint64_t counts[N_BUCKETS][N_SUB_BUCKETS];
+	uint64_t total_count = get_sub_counts(h, counts);
+
+	return percentile(counts, total_count, pct);
 }
 
 //------------------------------------------------
@@ -116,9 +295,7 @@ histogram_dump(histogram *h)
 	int b;
 	uint64_t counts[N_BUCKETS];
 
-	for (b = 0; b < N_BUCKETS; b++) {
-		counts[b] = cf_atomic64_get(h->counts[b]);
-	}
+	histogram_get_counts(h, counts);
 
 	int i = N_BUCKETS;
 	int j = 0;
@@ -172,6 +349,27 @@ histogram_dump(histogram *h)
 	}
 }
 
+//------------------------------------------------
+// Log percentiles - kept apart from the dump so
+// its format doesn't change.
+//
+void
+histogram_dump_percentiles(histogram *h)
+{
+	uint64_t counts[N_BUCKETS][N_SUB_BUCKETS];
+	uint64_t total_count = get_sub_counts(h, counts);
+
+	if (total_count == 0) {
+		return;
+	}
+
+	cf_info(AS_INFO, "histogram percentiles: %s p50 %lu p90 %lu p99 %lu p99.9 %lu %s",
+			h->name, percentile(counts, total_count, 50.0),
+			percentile(counts, total_count, 90.0),
+			percentile(counts, total_count, 99.0),
+			percentile(counts, total_count, 99.9), h->scale_tag);
+}
+
 //------------------------------------------------
 // BYTE_MSB[n] returns the position of the most
 // significant bit. If no bits are set (n = 0) it
@@ -238,6 +436,17 @@ msb(uint64_t n)
 	return -1;
 }
 
+static inline void
+insert(histogram *h, uint64_t value, int bucket)
+{
+	if (g_shard_ix < 0) {
+		g_shard_ix = (int)(cf_atomic32_incr(&g_next_shard_ix) % N_HIST_SHARDS);
+	}
+
+	// n_shards is 1 or N_HIST_SHARDS, both powers of 2.
+	cf_atomic64_incr(&h->shards[g_shard_ix & (h->n_shards - 1)].counts[bucket][sub_bucket(value, bucket)]);
+}
+
 //------------------------------------------------
 // Insert a time interval data point. The interval
 // is time elapsed since start_ns, converted to
@@ -283,10 +492,11 @@ histogram_insert_data_point(histogram *h, uint64_t start_ns)
 			cf_warning(AS_INFO, "%s - clock went backwards: start %lu end %lu",
 					h->name, start_ns, end_ns);
 			bucket = 0;
+			delta_t = 0;
 		}
 	}
 
-	cf_atomic64_incr(&h->counts[bucket]);
+	insert(h, delta_t, bucket);
 
 	return end_ns;
 }
@@ -307,5 +517,5 @@ histogram_insert_data_point(histogram *h, uint64_t start_ns)
 void
 histogram_insert_raw(histogram *h, uint64_t value)
 {
-	cf_atomic64_incr(&h->counts[msb(value)]);
+	insert(h, value, msb(value));
 }
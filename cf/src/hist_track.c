@@ -130,15 +130,10 @@ static int thresholds_to_buckets(const char* thresholds, uint32_t buckets[]);
 cf_hist_track*
 cf_hist_track_create(const char* name, histogram_scale scale)
 {
-	if (! (name && strlen(name) < HISTOGRAM_NAME_SIZE)) {
-		return NULL;
-	}
-
-	if (! (scale >= 0 && scale < HIST_SCALE_MAX_PLUS_1)) {
-		return NULL;
-	}
-
-	cf_hist_track* this = (cf_hist_track*)cf_malloc(sizeof(cf_hist_track));
+	// Base histogram setup - tracked histograms are on the transaction path,
+	// so they're sharded.
+	cf_hist_track* this = (cf_hist_track*)histogram_alloc(sizeof(cf_hist_track),
+			name, scale, true);
 
 	if (! this) {
 		return NULL;
@@ -149,36 +144,10 @@ cf_hist_track_create(const char* name, histogram_scale scale)
 		return NULL;
 	}
 
-	// Base histogram setup, same as in histogram_create():
-	strcpy(this->hist.name, name);
-	memset((void*)this->hist.counts, 0, sizeof(this->hist.counts));
-
 	// If cf_hist_track_insert_data_point() is called for a size or count
 	// histogram, the divide by 0 will crash - consider that a high-performance
 	// assert.
 
-	switch (scale) {
-	case HIST_MILLISECONDS:
-		this->hist.scale_tag = HIST_TAG_MILLISECONDS;
-		this->hist.time_div = 1000 * 1000;
-		break;
-	case HIST_MICROSECONDS:
-		this->hist.scale_tag = HIST_TAG_MICROSECONDS;
-		this->hist.time_div = 1000;
-		break;
-	case HIST_SIZE:
-		this->hist.scale_tag = HIST_TAG_SIZE;
-		this->hist.time_div = 0;
-		break;
-	case HIST_COUNT:
-		this->hist.scale_tag = HIST_TAG_COUNT;
-		this->hist.time_div = 0;
-		break;
-	default:
-		cf_crash(AS_INFO, "%s: unrecognized histogram scale %d", name, scale);
-		break;
-	}
-
 	// Start with tracking off.
 	this->rows = NULL;
 
@@ -302,6 +271,7 @@ cf_hist_track_dump(cf_hist_track* this)
 {
 	// Always print the histogram.
 	histogram_dump((histogram*)this);
+	histogram_dump_percentiles((histogram*)this);
 
 	// If tracking is enabled, save a row in the cache.
 	pthread_mutex_lock(&this->rows_lock);
@@ -327,8 +297,9 @@ cf_hist_track_dump(cf_hist_track* this)
 	uint64_t counts[N_BUCKETS];
 	uint64_t total_count = 0;
 
+	histogram_get_counts(&this->hist, counts);
+
 	for (int j = 0; j < N_BUCKETS; j++) {
-		counts[j] = cf_atomic64_get(this->hist.counts[j]);
 		total_count += counts[j];
 	}
 
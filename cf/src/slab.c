@@ -0,0 +1,316 @@
+/*
+ * slab.c
+ *
+ * Copyright (C) 2016 Aerospike, Inc.
+ *
+ * Portions may be licensed to Aerospike, Inc. under one or more contributor
+ * license agreements.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Affero General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option) any
+ * later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses/
+ */
+
+//==========================================================
+// Includes
+//
+
+#include "slab.h"
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "citrusleaf/alloc.h"
+#include "citrusleaf/cf_atomic.h"
+
+#include "fault.h"
+
+
+//==========================================================
+// Typedefs & Constants
+//
+
+// Free slots a thread caches per size class.
+#define CACHE_CAPACITY 32
+
+// Each thread has a cache per slab. Allocs and frees work on it without the
+// class lock, which is only taken to refill an empty stack or to return half
+// of a full one - once per CACHE_CAPACITY / 2 operations at worst.
+typedef struct slab_cache_s {
+	cf_slab*			slab;
+	uint32_t			n_slots[CF_SLAB_N_CLASSES];
+	void*				slots[CF_SLAB_N_CLASSES][CACHE_CAPACITY];
+} slab_cache;
+
+
+//==========================================================
+// Forward Declarations
+//
+
+static inline uint32_t size_class(size_t size);
+static inline size_t slot_size(uint32_t c);
+static slab_cache* get_cache(cf_slab* slab);
+static void cache_destroy(void* udata);
+static uint32_t class_alloc(cf_slab* slab, uint32_t c, void** slots, uint32_t n);
+static void class_free(cf_slab* slab, uint32_t c, void** slots, uint32_t n);
+
+
+//==========================================================
+// Public API
+//
+
+cf_slab*
+cf_slab_create()
+{
+	cf_slab* slab = cf_malloc(sizeof(cf_slab));
+
+	cf_assert(slab, CF_ALLOC, "alloc cf_slab");
+
+	memset(slab, 0, sizeof(cf_slab));
+
+	for (uint32_t c = 0; c < CF_SLAB_N_CLASSES; c++) {
+		pthread_mutex_init(&slab->classes[c].lock, NULL);
+	}
+
+	// A thread's caches go back to the slab when the thread exits. (Slabs
+	// must therefore outlive all threads that use them.)
+	cf_assert(pthread_key_create(&slab->cache_key, cache_destroy) == 0,
+			CF_ALLOC, "create slab cache key");
+
+	return slab;
+}
+
+void*
+cf_slab_malloc(cf_slab* slab, size_t size)
+{
+	if (size > CF_SLAB_MAX_SIZE) {
+		void* p = cf_malloc_ns(size);
+
+		if (p) {
+			cf_atomic64_add(&slab->heap_bytes, size);
+		}
+
+		return p;
+	}
+
+	uint32_t c = size_class(size);
+	slab_cache* cache = get_cache(slab);
+	void* p;
+
+	if (! cache) {
+		return class_alloc(slab, c, &p, 1) == 1 ? p : NULL;
+	}
+
+	if (cache->n_slots[c] == 0) {
+		cache->n_slots[c] = class_alloc(slab, c, cache->slots[c],
+				CACHE_CAPACITY / 2);
+
+		if (cache->n_slots[c] == 0) {
+			return NULL;
+		}
+	}
+
+	return cache->slots[c][--cache->n_slots[c]];
+}
+
+void*
+cf_slab_realloc(cf_slab* slab, void* p, size_t old_size, size_t size)
+{
+	if (! p) {
+		return cf_slab_malloc(slab, size);
+	}
+
+	// Same size class - the slot already fits.
+	if (old_size <= CF_SLAB_MAX_SIZE && size <= CF_SLAB_MAX_SIZE &&
+			size != 0 && size_class(old_size) == size_class(size)) {
+		return p;
+	}
+
+	void* new_p = cf_slab_malloc(slab, size);
+
+	if (! new_p) {
+		return NULL;
+	}
+
+	memcpy(new_p, p, old_size < size ? old_size : size);
+	cf_slab_free(slab, p, old_size);
+
+	return new_p;
+}
+
+void
+cf_slab_free(cf_slab* slab, void* p, size_t size)
+{
+	if (! p) {
+		return;
+	}
+
+	if (size > CF_SLAB_MAX_SIZE) {
+		cf_free(p);
+		cf_atomic64_sub(&slab->heap_bytes, size);
+		return;
+	}
+
+	uint32_t c = size_class(size);
+	slab_cache* cache = get_cache(slab);
+
+	if (! cache) {
+		class_free(slab, c, &p, 1);
+		return;
+	}
+
+	if (cache->n_slots[c] == CACHE_CAPACITY) {
+		// Return the oldest half.
+		class_free(slab, c, cache->slots[c], CACHE_CAPACITY / 2);
+
+		cache->n_slots[c] -= CACHE_CAPACITY / 2;
+		memmove(cache->slots[c], cache->slots[c] + (CACHE_CAPACITY / 2),
+				cache->n_slots[c] * sizeof(void*));
+	}
+
+	cache->slots[c][cache->n_slots[c]++] = p;
+}
+
+uint64_t
+cf_slab_page_bytes(const cf_slab* slab)
+{
+	return cf_atomic64_get(slab->page_bytes);
+}
+
+uint64_t
+cf_slab_used_bytes(const cf_slab* slab)
+{
+	return cf_atomic64_get(slab->used_bytes);
+}
+
+uint64_t
+cf_slab_heap_bytes(const cf_slab* slab)
+{
+	return cf_atomic64_get(slab->heap_bytes);
+}
+
+
+//==========================================================
+// Local Helpers
+//
+
+static inline uint32_t
+size_class(size_t size)
+{
+	// Size 0 shares the smallest class - a slot must hold a free-list link.
+	return size == 0 ? 0 : (uint32_t)((size - 1) / CF_SLAB_GRANULE);
+}
+
+static inline size_t
+slot_size(uint32_t c)
+{
+	return (size_t)(c + 1) * CF_SLAB_GRANULE;
+}
+
+// Returns NULL if the cache can't be allocated - caller then goes straight
+// to the size class.
+static slab_cache*
+get_cache(cf_slab* slab)
+{
+	slab_cache* cache = (slab_cache*)pthread_getspecific(slab->cache_key);
+
+	if (! cache) {
+		if (! (cache = cf_calloc(1, sizeof(slab_cache)))) {
+			return NULL;
+		}
+
+		cache->slab = slab;
+		pthread_setspecific(slab->cache_key, cache);
+	}
+
+	return cache;
+}
+
+static void
+cache_destroy(void* udata)
+{
+	slab_cache* cache = (slab_cache*)udata;
+
+	for (uint32_t c = 0; c < CF_SLAB_N_CLASSES; c++) {
+		if (cache->n_slots[c] != 0) {
+			class_free(cache->slab, c, cache->slots[c], cache->n_slots[c]);
+		}
+	}
+
+	cf_free(cache);
+}
+
+// Take up to n slots from the size class, reusing freed slots first, then
+// carving new ones. Returns the number taken. Slots in thread caches count as
+// used.
+static uint32_t
+class_alloc(cf_slab* slab, uint32_t c, void** slots, uint32_t n)
+{
+	cf_slab_class* cls = &slab->classes[c];
+	size_t size = slot_size(c);
+	uint32_t n_got = 0;
+
+	pthread_mutex_lock(&cls->lock);
+
+	while (n_got < n && cls->free_head) {
+		slots[n_got++] = cls->free_head;
+		cls->free_head = *(void**)cls->free_head;
+	}
+
+	while (n_got < n) {
+		if (cls->page_at + size > cls->page_end) {
+			// Any tail of the old page too small for a slot is abandoned.
+			uint8_t* page = cf_malloc_ns(CF_SLAB_PAGE_SIZE);
+
+			if (! page) {
+				break;
+			}
+
+			cf_atomic64_add(&slab->page_bytes, CF_SLAB_PAGE_SIZE);
+
+			cls->page_at = page;
+			cls->page_end = page + CF_SLAB_PAGE_SIZE;
+		}
+
+		slots[n_got++] = cls->page_at;
+		cls->page_at += size;
+	}
+
+	pthread_mutex_unlock(&cls->lock);
+
+	cf_atomic64_add(&slab->used_bytes, n_got * size);
+
+	return n_got;
+}
+
+// Return n slots to the size class. They're chained before taking the lock,
+// so the lock only covers the splice.
+static void
+class_free(cf_slab* slab, uint32_t c, void** slots, uint32_t n)
+{
+	cf_slab_class* cls = &slab->classes[c];
+
+	for (uint32_t i = 0; i + 1 < n; i++) {
+		*(void**)slots[i] = slots[i + 1];
+	}
+
+	pthread_mutex_lock(&cls->lock);
+
+	*(void**)slots[n - 1] = cls->free_head;
+	cls->free_head = slots[0];
+
+	pthread_mutex_unlock(&cls->lock);
+
+	cf_atomic64_sub(&slab->used_bytes, n * slot_size(c));
+}
@@ -614,8 +614,8 @@ cf_socket_exists(cf_socket *sock)
 	return sock->fd >= 0;
 }
 
-int32_t
-cf_socket_init_server(cf_serv_cfg *cfg, cf_sockets *socks)
+static int32_t
+init_server(cf_serv_cfg *cfg, cf_sockets *socks, bool reuse_port)
 {
 	int32_t res = -1;
 
@@ -665,6 +665,10 @@ cf_socket_init_server(cf_serv_cfg *cfg, cf_sockets *socks)
 		static const int32_t flag = 1;
 		safe_setsockopt(sock->fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
 
+		if (reuse_port) {
+			safe_setsockopt(sock->fd, SOL_SOCKET, SO_REUSEPORT, &flag, sizeof(flag));
+		}
+
 		while (bind(sock->fd, (struct sockaddr *)&sas,
 				cf_socket_addr_len((struct sockaddr *)&sas)) < 0) {
 			if (errno != EADDRINUSE) {
@@ -706,6 +710,21 @@ cleanup0:
 	return res;
 }
 
+int32_t
+cf_socket_init_server(cf_serv_cfg *cfg, cf_sockets *socks)
+{
+	return init_server(cfg, socks, false);
+}
+
+// Like cf_socket_init_server(), but with SO_REUSEPORT - call it repeatedly on
+// the same configuration to get several independent listening sockets per
+// address, between which the kernel spreads incoming connections.
+int32_t
+cf_socket_init_server_reuse_port(cf_serv_cfg *cfg, cf_sockets *socks)
+{
+	return init_server(cfg, socks, true);
+}
+
 void
 cf_socket_show_server(cf_fault_context cont, const char *tag, const cf_sockets *socks)
 {
@@ -1120,6 +1139,72 @@ cf_socket_send_all(cf_socket *sock, const void *buff, size_t size, int32_t flags
 	}
 }
 
+// Gathering version of cf_socket_send_all(). Note - advances through (and
+// so modifies) the caller's iovec array.
+int32_t
+cf_socket_send_iov_all(cf_socket *sock, struct iovec *iov, int32_t n_iov,
+		int32_t flags, int32_t timeout)
+{
+	if (sock->ssl) {
+		for (int32_t i = 0; i < n_iov; ++i) {
+			if (tls_socket_send(sock, iov[i].iov_base, iov[i].iov_len, flags,
+					timeout) < 0) {
+				return -1;
+			}
+		}
+
+		return 0;
+	}
+
+	cf_detail(CF_SOCKET, "Blocking gathering send on FD %d, %d iovecs",
+			sock->fd, n_iov);
+
+	struct msghdr msg = { .msg_iov = iov, .msg_iovlen = n_iov };
+
+	while (msg.msg_iovlen != 0) {
+		ssize_t count = sendmsg(sock->fd, &msg, flags | MSG_NOSIGNAL);
+
+		if (count < 0) {
+			if (errno == EAGAIN) {
+				cf_debug(CF_SOCKET, "FD %d is blocking", sock->fd);
+
+				if (socket_wait(sock, POLLOUT, timeout)) {
+					continue;
+				}
+
+				cf_debug(CF_SOCKET, "Timeout during blocking send on FD %d", sock->fd);
+				errno = ETIMEDOUT;
+				return -1;
+			}
+
+			cf_debug(CF_SOCKET, "Error while sending on FD %d: %d (%s)",
+					sock->fd, errno, cf_strerror(errno));
+			return -1;
+		}
+
+		if (count == 0) {
+			cf_warning(CF_SOCKET, "Sent 0 bytes on FD %d", sock->fd);
+			errno = ENOTCONN;
+			return -1;
+		}
+
+		// Skip what went out, possibly ending part way into an iovec.
+		while (msg.msg_iovlen != 0 && (size_t)count >= msg.msg_iov->iov_len) {
+			count -= msg.msg_iov->iov_len;
+			msg.msg_iov++;
+			msg.msg_iovlen--;
+		}
+
+		if (count != 0) {
+			msg.msg_iov->iov_base = (uint8_t *)msg.msg_iov->iov_base + count;
+			msg.msg_iov->iov_len -= count;
+		}
+	}
+
+	cf_detail(CF_SOCKET, "Blocking gathering send on FD %d complete", sock->fd);
+	return 0;
+}
+
 int32_t
 cf_socket_recv_from_all(cf_socket *sock, void *buffp, size_t size, int32_t flags,
 		cf_sock_addr *addr, int32_t timeout)